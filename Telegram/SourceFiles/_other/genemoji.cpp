@@ -2231,52 +2231,111 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org\n\
 			tcpp << "}\n\n";
 
 			// emoji autoreplace
-			tcpp << "void emojiFind(const QChar *ch, const QChar *e, const QChar *&newEmojiEnd, uint32 &emojiCode) {\n";
-			tcpp << "\tswitch (ch->unicode()) {\n";
-
-			QString tab("\t");
 			for (uint32 i = 0; i < replacesCount; ++i) {
 				QString key = QString::fromUtf8(replaces[i].replace);
 				replaceMap[key] = replaces[i].code;
 			}
-			QString chars;
-			for (ReplaceMap::const_iterator i = replaceMap.cend(), e = replaceMap.cbegin(); i != e;) {
-				--i;
-				QString key = i.key();
-				if (key == chars) {
-					tcpp << tab.repeated(1 + chars.size()) << "}\n";
-				}
-				bool needSwitch = chars.size();
-				while (chars.size() && key.midRef(0, chars.size()) != chars) {
-					needSwitch = false;
-					chars.resize(chars.size() - 1);
-					tcpp << tab.repeated(1 + chars.size()) << "break;\n";
-					if (chars.size() && (key.midRef(0, chars.size()) != chars || key == chars)) {
-						tcpp << tab.repeated(1 + chars.size()) << "}\n";
+
+			// build a trie and write it breadth first, so children of each node go one after another
+			struct ReplaceNode {
+				ushort ch;
+				uint32 code;
+				QMap<ushort, int> children;
+			};
+			QVector<ReplaceNode> nodes(1);
+			nodes[0].ch = 0;
+			nodes[0].code = 0;
+			for (ReplaceMap::const_iterator i = replaceMap.cbegin(), e = replaceMap.cend(); i != e; ++i) {
+				int node = 0;
+				for (int j = 0, l = i.key().size(); j < l; ++j) {
+					ushort ch = i.key().at(j).unicode();
+					if (!nodes[node].children.contains(ch)) {
+						ReplaceNode child;
+						child.ch = ch;
+						child.code = 0;
+						nodes.push_back(child);
+						nodes[node].children.insert(ch, nodes.size() - 1);
 					}
+					node = nodes[node].children.value(ch);
 				}
-				for (int j = chars.size(); j < key.size(); ++j) {
-					if (needSwitch) {
-						tcpp << tab.repeated(1 + chars.size()) << "if (ch + " << chars.size() << " != e) switch ((ch + " << chars.size() << ")->unicode()) {\n";
-					}
-					tcpp << tab.repeated(1 + chars.size()) << "case '" << ((key.at(j) == '\\' || key.at(j) == '\'') ? "\\" : "") << key.at(j) << "':\n";
-					chars.push_back(key.at(j));
-					needSwitch = true;
+				nodes[node].code = i.value();
+			}
+			QVector<int> order(1, 0);
+			QMap<int, int> indices;
+			for (int i = 0; i < order.size(); ++i) {
+				indices.insert(order.at(i), i);
+				for (QMap<ushort, int>::const_iterator j = nodes[order.at(i)].children.cbegin(), e = nodes[order.at(i)].children.cend(); j != e; ++j) {
+					order.push_back(j.value());
 				}
-				tcpp << tab.repeated(1 + chars.size()) << "newEmojiEnd = ch + " << chars.size() << ";\n";
-				tcpp << tab.repeated(1 + chars.size()) << "if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {\n";
-                tcpp << tab.repeated(1 + chars.size()) << "\temojiCode = 0x" << QString("%1").arg(i.value(), 0, 16).toUpper().toUtf8().constData() << "U;\n";
-				tcpp << tab.repeated(1 + chars.size()) << "\treturn;\n";
-				tcpp << tab.repeated(1 + chars.size()) << "}\n";
 			}
-			while (chars.size()) {
-				chars.resize(chars.size() - 1);
-				tcpp << tab.repeated(1 + chars.size()) << "break;\n";
-				if (chars.size()) {
-					tcpp << tab.repeated(1 + chars.size()) << "}\n";
+			uint32 leads[4] = { 0 };
+			for (QMap<ushort, int>::const_iterator i = nodes[0].children.cbegin(), e = nodes[0].children.cend(); i != e; ++i) {
+				if (i.key() >= 0x80) throw Exception("Emoji replace should start with a char below 0x80!");
+				leads[i.key() >> 5] |= (1U << (i.key() & 0x1F));
+			}
+
+			tcpp << "namespace {\n\n";
+			tcpp << "struct EmojiReplaceNode {\n";
+			tcpp << "\tushort ch;\n";
+			tcpp << "\tushort childrenFrom, childrenTill;\n";
+			tcpp << "\tuint32 code;\n";
+			tcpp << "};\n\n";
+			tcpp << "// Trie of the emoji text replaces, children of each node go one after another sorted by ch.\n";
+			tcpp << "const EmojiReplaceNode emojiReplaceNodes[] = {\n";
+			for (int i = 0; i < order.size(); ++i) {
+				const ReplaceNode &node(nodes[order.at(i)]);
+				int childrenFrom = 0, childrenTill = 0;
+				if (!node.children.isEmpty()) {
+					childrenFrom = indices.value(node.children.cbegin().value());
+					childrenTill = childrenFrom + node.children.size();
 				}
+				tcpp << "\t{ 0x" << QString("%1").arg(node.ch, 4, 16, QChar('0')).toUpper().toUtf8().constData() << ", " << childrenFrom << ", " << childrenTill << ", 0x" << QString("%1").arg(node.code, 0, 16).toUpper().toUtf8().constData() << "U },\n";
+			}
+			tcpp << "};\n\n";
+			tcpp << "// Bit mask of the characters below 0x80 that can start an emoji text replace.\n";
+			tcpp << "const uint32 emojiReplaceLeads[4] = { ";
+			for (int i = 0; i < 4; ++i) {
+				tcpp << (i ? ", " : "") << "0x" << QString("%1").arg(leads[i], 0, 16).toUpper().toUtf8().constData() << "U";
 			}
-					
+			tcpp << " };\n\n";
+			tcpp << "inline bool emojiReplaceLead(ushort ch) {\n";
+			tcpp << "\treturn (ch < 0x80) && (emojiReplaceLeads[ch >> 5] & (1U << (ch & 0x1F)));\n";
+			tcpp << "}\n\n";
+			tcpp << "} // namespace\n\n";
+
+			tcpp << "const QChar *emojiFindReplaceStart(const QChar *ch, const QChar *e) {\n";
+			tcpp << "\twhile (e - ch >= 4) {\n";
+			tcpp << "\t\tif (emojiReplaceLead(ch[0].unicode())) return ch;\n";
+			tcpp << "\t\tif (emojiReplaceLead(ch[1].unicode())) return ch + 1;\n";
+			tcpp << "\t\tif (emojiReplaceLead(ch[2].unicode())) return ch + 2;\n";
+			tcpp << "\t\tif (emojiReplaceLead(ch[3].unicode())) return ch + 3;\n";
+			tcpp << "\t\tch += 4;\n";
+			tcpp << "\t}\n";
+			tcpp << "\tfor (; ch != e; ++ch) {\n";
+			tcpp << "\t\tif (emojiReplaceLead(ch->unicode())) return ch;\n";
+			tcpp << "\t}\n";
+			tcpp << "\treturn e;\n";
+			tcpp << "}\n\n";
+
+			tcpp << "void emojiFind(const QChar *ch, const QChar *e, const QChar *&newEmojiEnd, uint32 &emojiCode) {\n";
+			tcpp << "\tif (!emojiReplaceLead(ch->unicode())) return;\n\n";
+			tcpp << "\tauto node = emojiReplaceNodes;\n";
+			tcpp << "\tfor (auto i = ch; i != e; ++i) {\n";
+			tcpp << "\t\tauto child = emojiReplaceNodes + node->childrenFrom, till = emojiReplaceNodes + node->childrenTill;\n";
+			tcpp << "\t\twhile (child != till && child->ch < i->unicode()) {\n";
+			tcpp << "\t\t\t++child;\n";
+			tcpp << "\t\t}\n";
+			tcpp << "\t\tif (child == till || child->ch != i->unicode()) {\n";
+			tcpp << "\t\t\tbreak;\n";
+			tcpp << "\t\t}\n";
+			tcpp << "\t\tnode = child;\n";
+			tcpp << "\t\tif (node->code) {\n";
+			tcpp << "\t\t\tauto end = i + 1;\n";
+			tcpp << "\t\t\tif (end == e || emojiEdge(end) || end->unicode() == ' ') {\n";
+			tcpp << "\t\t\t\tnewEmojiEnd = end;\n";
+			tcpp << "\t\t\t\temojiCode = node->code;\n";
+			tcpp << "\t\t\t}\n";
+			tcpp << "\t\t}\n";
 			tcpp << "\t}\n";
 			tcpp << "}\n\n";
 
@@ -0,0 +1,183 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop version of Telegram messaging app, see https://telegram.org
+
+Telegram Desktop is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+In addition, as a special exception, the copyright holders give permission
+to link the code of portions of this program with the OpenSSL library.
+
+Full license: https://github.com/telegramdesktop/tdesktop/blob/master/LICENSE
+Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
+*/
+#include "tracestat.h"
+
+// Reads network trace files written with the "debugtrace" settings code
+// and prints request latency and throughput histograms for each dc.
+//
+// Usage: TraceStat DebugLogs/trace_20161018_120000.bin [more traces]
+
+namespace {
+
+enum Kind {
+	KindMtp,
+	KindDownload,
+	KindUpload,
+
+	KindCount
+};
+
+const char *KindNames[KindCount] = { "requests", "download", "upload" };
+
+struct Stats {
+	vector<double> latencies; // ms
+	uint64_t bytes = 0;
+	uint64_t firstTime = 0;
+	uint64_t lastTime = 0;
+	int unanswered = 0;
+};
+
+struct Pending {
+	uint64_t time;
+	int32_t dc;
+	int kind;
+};
+
+bool readTrace(const char *path, vector<TraceRecord> &records) {
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		cerr << "Could not open '" << path << "'.\n";
+		return false;
+	}
+	int32_t header[4] = { 0 };
+	if (fread(header, sizeof(header), 1, f) != 1 || memcmp(header, "TDTR", 4) != 0 || header[1] != TraceVersion || header[2] != int32_t(sizeof(TraceRecord))) {
+		cerr << "Bad trace file '" << path << "'.\n";
+		fclose(f);
+		return false;
+	}
+	TraceRecord record;
+	while (fread(&record, sizeof(record), 1, f) == 1) {
+		records.push_back(record);
+	}
+	fclose(f);
+	return true;
+}
+
+int startKind(uint16_t event) {
+	switch (event) {
+	case TraceMtpRequestSent: return KindMtp;
+	case TraceFilePartRequested: return KindDownload;
+	case TraceFileUploadPartSent: return KindUpload;
+	}
+	return -1;
+}
+
+int finishKind(uint16_t event) {
+	switch (event) {
+	case TraceMtpResponseReceived: return KindMtp;
+	case TraceFilePartLoaded: return KindDownload;
+	case TraceFileUploadPartDone: return KindUpload;
+	}
+	return -1;
+}
+
+double percentile(const vector<double> &sorted, double part) {
+	if (sorted.empty()) return 0.;
+	auto index = size_t(part * (sorted.size() - 1) + 0.5);
+	return sorted[std::min(index, sorted.size() - 1)];
+}
+
+void printStats(int32_t dc, int kind, Stats &stats) {
+	auto &l = stats.latencies;
+	std::sort(l.begin(), l.end());
+
+	auto seconds = (stats.lastTime - stats.firstTime) / 1000000.;
+	auto speed = (seconds > 0.) ? (stats.bytes / 1024. / seconds) : 0.;
+	printf("dc %d (%d:%d) %s: %d done, %d unanswered, %.1f KB in %.2f s, %.1f KB/s\n", dc, dc % 10000, dc / 10000, KindNames[kind], int(l.size()), stats.unanswered, stats.bytes / 1024., seconds, speed);
+	if (l.empty()) return;
+
+	printf("  latency ms: min %.1f, median %.1f, p90 %.1f, p99 %.1f, max %.1f\n", l.front(), percentile(l, 0.5), percentile(l, 0.9), percentile(l, 0.99), l.back());
+
+	// Power of two buckets: < 1ms, < 2ms, < 4ms, ...
+	const int kBuckets = 16;
+	int counts[kBuckets] = { 0 }, most = 0;
+	for (auto latency : l) {
+		auto bucket = 0;
+		while (bucket + 1 < kBuckets && latency >= (1 << bucket)) {
+			++bucket;
+		}
+		most = std::max(most, ++counts[bucket]);
+	}
+	for (auto bucket = 0; bucket != kBuckets; ++bucket) {
+		if (!counts[bucket]) continue;
+		string bar(size_t((counts[bucket] * 40 + most - 1) / most), '#');
+		printf("  < %5d ms %7d %s\n", 1 << bucket, counts[bucket], bar.c_str());
+	}
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		cerr << "Usage: TraceStat <trace file> [<trace file> ...]\n";
+		return -1;
+	}
+
+	for (int i = 1; i < argc; ++i) {
+		vector<TraceRecord> records;
+		if (!readTrace(argv[i], records)) {
+			return -1;
+		}
+		cout << argv[i] << ": " << records.size() << " records\n";
+
+		// Request ids are unique only in a launch, so each trace is handled separately.
+		// Mtp and file requests are counted apart, so the pending ones are keyed by (kind, id).
+		map<pair<int, uint64_t>, Pending> pending;
+		map<int32_t, Stats> stats[KindCount];
+		map<int32_t, uint64_t> packets;
+		for (auto &record : records) {
+			if (record.event == TraceMtpPacketSent) {
+				packets[record.dc] += record.size;
+				continue;
+			}
+			auto kind = startKind(record.event);
+			if (kind >= 0) {
+				auto &s = stats[kind][record.dc];
+				if (!s.firstTime) s.firstTime = record.time;
+				pending[make_pair(kind, record.id)] = { record.time, record.dc, kind };
+				continue;
+			}
+			kind = finishKind(record.event);
+			if (kind < 0) continue;
+
+			auto j = pending.find(make_pair(kind, record.id));
+			if (j == pending.end()) continue;
+
+			auto &s = stats[kind][j->second.dc];
+			s.latencies.push_back((record.time - j->second.time) / 1000.);
+			s.lastTime = std::max(s.lastTime, record.time);
+			s.bytes += record.size;
+			pending.erase(j);
+		}
+		for (auto &j : pending) {
+			++stats[j.second.kind][j.second.dc].unanswered;
+		}
+		for (auto kind = 0; kind != KindCount; ++kind) {
+			for (auto &s : stats[kind]) {
+				printStats(s.first, kind, s.second);
+			}
+		}
+		for (auto &p : packets) {
+			printf("dc %d (%d:%d) packets: %.1f KB sent\n", p.first, p.first % 10000, p.first / 10000, p.second / 1024.);
+		}
+	}
+	return 0;
+}
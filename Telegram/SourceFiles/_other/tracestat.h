@@ -0,0 +1,64 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop version of Telegram messaging app, see https://telegram.org
+
+Telegram Desktop is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+In addition, as a special exception, the copyright holders give permission
+to link the code of portions of this program with the OpenSSL library.
+
+Full license: https://github.com/telegramdesktop/tdesktop/blob/master/LICENSE
+Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <iostream>
+
+using std::string;
+using std::vector;
+using std::map;
+using std::pair;
+using std::make_pair;
+using std::cout;
+using std::cerr;
+
+// Must be in sync with Logs::TraceEvent and TraceRecord in logs.cpp.
+enum TraceEvent {
+	TraceMtpPacketSent = 1,
+	TraceMtpRequestSent = 2,
+	TraceMtpResponseReceived = 3,
+	TraceFilePartRequested = 4,
+	TraceFilePartLoaded = 5,
+	TraceFileUploadPartSent = 6,
+	TraceFileUploadPartDone = 7,
+};
+
+struct TraceRecord {
+	uint64_t time;
+	uint64_t id;
+	int32_t dc;
+	int32_t offset;
+	int32_t size;
+	uint16_t event;
+	uint16_t reserved;
+};
+static_assert(sizeof(TraceRecord) == 32, "Bad TraceRecord size.");
+
+const int32_t TraceVersion = 1;
@@ -31,10 +31,11 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 #include "localstorage.h"
 #include "boxes/confirmbox.h"
 
-ApiWrap::ApiWrap(QObject *parent) : QObject(parent)
-, _messageDataResolveDelayed(new SingleDelayedCall(this, "resolveMessageDatas")) {
+ApiWrap::ApiWrap(QObject *parent) : QObject(parent) {
 	App::initBackground();
 
+	connect(&_messageDataResolveTimer, SIGNAL(timeout()), this, SLOT(resolveMessageDatas()));
+	connect(&_peersResolveTimer, SIGNAL(timeout()), this, SLOT(resolvePeers()));
 	connect(&_webPagesTimer, SIGNAL(timeout()), this, SLOT(resolveWebPages()));
 	connect(&_draftsSaveTimer, SIGNAL(timeout()), this, SLOT(saveDraftsToCloud()));
 }
@@ -47,19 +48,28 @@ void ApiWrap::requestMessageData(ChannelData *channel, MsgId msgId, RequestMessa
 	if (callback) {
 		req.callbacks.append(std_::move(callback));
 	}
-	if (!req.req) _messageDataResolveDelayed->call();
+	if (!req.req && !_messageDataResolveTimer.isActive()) {
+		_messageDataResolveTimer.start(ResolveMessageDatasDelay);
+	}
 }
 
 ApiWrap::MessageIds ApiWrap::collectMessageIds(const MessageDataRequests &requests) {
 	MessageIds result;
-	result.reserve(requests.size());
+	result.reserve(qMin(requests.size(), int(ResolveIdsLimit)));
 	for (auto i = requests.cbegin(), e = requests.cend(); i != e; ++i) {
 		if (i.value().req > 0) continue;
 		result.push_back(MTP_int(i.key()));
+		if (result.size() == ResolveIdsLimit) break;
 	}
 	return result;
 }
 
+void ApiWrap::setMessageDataRequestId(MessageDataRequests &requests, const MessageIds &ids, mtpRequestId req) {
+	for_const (auto &id, ids) {
+		requests[id.v].req = req;
+	}
+}
+
 ApiWrap::MessageDataRequests *ApiWrap::messageDataRequests(ChannelData *channel, bool onlyExisting) {
 	if (channel) {
 		auto i = _channelMessageDataRequests.find(channel);
@@ -75,26 +85,18 @@ ApiWrap::MessageDataRequests *ApiWrap::messageDataRequests(ChannelData *channel,
 void ApiWrap::resolveMessageDatas() {
 	if (_messageDataRequests.isEmpty() && _channelMessageDataRequests.isEmpty()) return;
 
-	MessageIds ids = collectMessageIds(_messageDataRequests);
-	if (!ids.isEmpty()) {
+	for (auto ids = collectMessageIds(_messageDataRequests); !ids.isEmpty(); ids = collectMessageIds(_messageDataRequests)) {
 		mtpRequestId req = MTP::send(MTPmessages_GetMessages(MTP_vector<MTPint>(ids)), rpcDone(&ApiWrap::gotMessageDatas, (ChannelData*)nullptr), RPCFailHandlerPtr(), 0, 5);
-		for (auto &request : _messageDataRequests) {
-			if (request.req > 0) continue;
-			request.req = req;
-		}
+		setMessageDataRequestId(_messageDataRequests, ids, req);
 	}
 	for (auto j = _channelMessageDataRequests.begin(); j != _channelMessageDataRequests.cend();) {
 		if (j->isEmpty()) {
 			j = _channelMessageDataRequests.erase(j);
 			continue;
 		}
-		MessageIds ids = collectMessageIds(j.value());
-		if (!ids.isEmpty()) {
+		for (auto ids = collectMessageIds(j.value()); !ids.isEmpty(); ids = collectMessageIds(j.value())) {
 			mtpRequestId req = MTP::send(MTPchannels_GetMessages(j.key()->inputChannel, MTP_vector<MTPint>(ids)), rpcDone(&ApiWrap::gotMessageDatas, j.key()), RPCFailHandlerPtr(), 0, 5);
-			for (auto &request : *j) {
-				if (request.req > 0) continue;
-				request.req = req;
-			}
+			setMessageDataRequestId(j.value(), ids, req);
 		}
 		++j;
 	}
@@ -362,37 +364,56 @@ bool ApiWrap::gotPeerFullFailed(PeerData *peer, const RPCError &error) {
 void ApiWrap::requestPeer(PeerData *peer) {
 	if (!peer || _fullPeerRequests.contains(peer) || _peerRequests.contains(peer)) return;
 
-	mtpRequestId req = 0;
-	if (peer->isUser()) {
-		req = MTP::send(MTPusers_GetUsers(MTP_vector<MTPInputUser>(1, peer->asUser()->inputUser)), rpcDone(&ApiWrap::gotUser, peer), rpcFail(&ApiWrap::gotPeerFailed, peer));
-	} else if (peer->isChat()) {
-		req = MTP::send(MTPmessages_GetChats(MTP_vector<MTPint>(1, peer->asChat()->inputChat)), rpcDone(&ApiWrap::gotChat, peer), rpcFail(&ApiWrap::gotPeerFailed, peer));
-	} else if (peer->isChannel()) {
-		req = MTP::send(MTPchannels_GetChannels(MTP_vector<MTPInputChannel>(1, peer->asChannel()->inputChannel)), rpcDone(&ApiWrap::gotChat, peer), rpcFail(&ApiWrap::gotPeerFailed, peer));
+	_peerRequests.insert(peer, 0);
+	_peersToResolve.push_back(peer);
+	if (!_peersResolveTimer.isActive()) {
+		_peersResolveTimer.start(ResolvePeersDelay);
 	}
-	if (req) _peerRequests.insert(peer, req);
 }
 
 void ApiWrap::requestPeers(const QList<PeerData*> &peers) {
-	QVector<MTPint> chats;
-	QVector<MTPInputChannel> channels;
-	QVector<MTPInputUser> users;
-	chats.reserve(peers.size());
-	channels.reserve(peers.size());
-	users.reserve(peers.size());
-	for (QList<PeerData*>::const_iterator i = peers.cbegin(), e = peers.cend(); i != e; ++i) {
-		if (!*i || _fullPeerRequests.contains(*i) || _peerRequests.contains(*i)) continue;
-		if ((*i)->isUser()) {
-			users.push_back((*i)->asUser()->inputUser);
-		} else if ((*i)->isChat()) {
-			chats.push_back((*i)->asChat()->inputChat);
-		} else if ((*i)->isChannel()) {
-			channels.push_back((*i)->asChannel()->inputChannel);
+	for_const (auto peer, peers) {
+		requestPeer(peer);
+	}
+}
+
+void ApiWrap::resolvePeers() {
+	QVector<PeerData*> users, chats, channels;
+	auto toResolve = base::take(_peersToResolve);
+	for_const (auto peer, toResolve) {
+		if (peer->isUser()) {
+			users.push_back(peer);
+		} else if (peer->isChat()) {
+			chats.push_back(peer);
+		} else if (peer->isChannel()) {
+			channels.push_back(peer);
 		}
 	}
-	if (!chats.isEmpty()) MTP::send(MTPmessages_GetChats(MTP_vector<MTPint>(chats)), rpcDone(&ApiWrap::gotChats));
-	if (!channels.isEmpty()) MTP::send(MTPchannels_GetChannels(MTP_vector<MTPInputChannel>(channels)), rpcDone(&ApiWrap::gotChats));
-	if (!users.isEmpty()) MTP::send(MTPusers_GetUsers(MTP_vector<MTPInputUser>(users)), rpcDone(&ApiWrap::gotUsers));
+
+	// Sends the peers by chunks of ResolveIdsLimit ids.
+	auto send = [this](const QVector<PeerData*> &peers, auto inputId, auto request) {
+		for (int from = 0, count = peers.size(); from < count; from += ResolveIdsLimit) {
+			auto till = qMin(from + int(ResolveIdsLimit), count);
+			QVector<decltype(inputId(peers[from]))> ids;
+			ids.reserve(till - from);
+			for (auto i = from; i != till; ++i) {
+				ids.push_back(inputId(peers[i]));
+			}
+			auto req = request(ids);
+			for (auto i = from; i != till; ++i) {
+				_peerRequests[peers[i]] = req;
+			}
+		}
+	};
+	send(users, [](PeerData *peer) { return peer->asUser()->inputUser; }, [this](const QVector<MTPInputUser> &ids) {
+		return MTP::send(MTPusers_GetUsers(MTP_vector<MTPInputUser>(ids)), rpcDone(&ApiWrap::gotUsers), rpcFail(&ApiWrap::gotPeersFailed));
+	});
+	send(chats, [](PeerData *peer) { return peer->asChat()->inputChat; }, [this](const QVector<MTPint> &ids) {
+		return MTP::send(MTPmessages_GetChats(MTP_vector<MTPint>(ids)), rpcDone(&ApiWrap::gotChats), rpcFail(&ApiWrap::gotPeersFailed));
+	});
+	send(channels, [](PeerData *peer) { return peer->asChannel()->inputChannel; }, [this](const QVector<MTPInputChannel> &ids) {
+		return MTP::send(MTPchannels_GetChannels(MTP_vector<MTPInputChannel>(ids)), rpcDone(&ApiWrap::gotChats), rpcFail(&ApiWrap::gotPeersFailed));
+	});
 }
 
 void ApiWrap::requestLastParticipants(ChannelData *peer, bool fromStart) {
@@ -418,57 +439,71 @@ void ApiWrap::requestBots(ChannelData *peer) {
 	_botsRequests.insert(peer, MTP::send(MTPchannels_GetParticipants(peer->inputChannel, MTP_channelParticipantsBots(), MTP_int(0), MTP_int(Global::ChatSizeMax())), rpcDone(&ApiWrap::lastParticipantsDone, peer), rpcFail(&ApiWrap::lastParticipantsFail, peer)));
 }
 
-void ApiWrap::gotChat(PeerData *peer, const MTPmessages_Chats &result) {
-	_peerRequests.remove(peer);
+void ApiWrap::gotChats(const MTPmessages_Chats &result, mtpRequestId req) {
+	if (result.type() != mtpc_messages_chats) {
+		peersRequestFinished(req);
+		return;
+	}
 
-	if (result.type() == mtpc_messages_chats) {
-		const auto &v(result.c_messages_chats().vchats.c_vector().v);
-		bool badVersion = false;
-		if (peer->isChat()) {
-			badVersion = (!v.isEmpty() && v.at(0).type() == mtpc_chat && v.at(0).c_chat().vversion.v < peer->asChat()->version);
-		} else if (peer->isChannel()) {
-			badVersion = (!v.isEmpty() && v.at(0).type() == mtpc_channel && v.at(0).c_chat().vversion.v < peer->asChannel()->version);
+	// The requested chats we have a newer version of are requested again.
+	QList<QPair<PeerData*, int>> badVersions;
+	auto &v = result.c_messages_chats().vchats.c_vector().v;
+	for_const (auto &chat, v) {
+		PeerData *peer = nullptr;
+		auto version = 0;
+		if (chat.type() == mtpc_chat) {
+			auto &d = chat.c_chat();
+			peer = App::chat(peerFromChat(d.vid.v));
+			version = d.vversion.v;
+			if (version >= peer->asChat()->version) continue;
+		} else if (chat.type() == mtpc_channel) {
+			auto &d = chat.c_channel();
+			peer = App::channel(peerFromChannel(d.vid.v));
+			version = d.vversion.v;
+			if (version >= peer->asChannel()->version) continue;
+		} else {
+			continue;
 		}
-		PeerData *chat = App::feedChats(result.c_messages_chats().vchats);
-		if (chat == peer) {
-			if (badVersion) {
-				if (peer->isChat()) {
-					peer->asChat()->version = v.at(0).c_chat().vversion.v;
-				} else if (peer->isChannel()) {
-					peer->asChannel()->version = v.at(0).c_channel().vversion.v;
-				}
-				requestPeer(peer);
-			}
+		if (_peerRequests.value(peer) == req) {
+			badVersions.push_back(qMakePair(peer, version));
 		}
 	}
-}
+	App::feedChats(result.c_messages_chats().vchats);
+	peersRequestFinished(req);
 
-void ApiWrap::gotUser(PeerData *peer, const MTPVector<MTPUser> &result) {
-	_peerRequests.remove(peer);
-
-	UserData *user = App::feedUsers(result);
-	if (user == peer) {
-	}
-}
-
-void ApiWrap::gotChats(const MTPmessages_Chats &result) {
-	if (result.type() == mtpc_messages_chats) {
-		auto &d = result.c_messages_chats();
-		App::feedChats(d.vchats);
+	for_const (auto &badVersion, badVersions) {
+		auto peer = badVersion.first;
+		if (peer->isChat()) {
+			peer->asChat()->version = badVersion.second;
+		} else if (peer->isChannel()) {
+			peer->asChannel()->version = badVersion.second;
+		}
+		requestPeer(peer);
 	}
 }
 
-void ApiWrap::gotUsers(const MTPVector<MTPUser> &result) {
+void ApiWrap::gotUsers(const MTPVector<MTPUser> &result, mtpRequestId req) {
 	App::feedUsers(result);
+	peersRequestFinished(req);
 }
 
-bool ApiWrap::gotPeerFailed(PeerData *peer, const RPCError &error) {
+bool ApiWrap::gotPeersFailed(const RPCError &error, mtpRequestId req) {
 	if (MTP::isDefaultHandledError(error)) return false;
 
-	_peerRequests.remove(peer);
+	peersRequestFinished(req);
 	return true;
 }
 
+void ApiWrap::peersRequestFinished(mtpRequestId req) {
+	for (auto i = _peerRequests.begin(); i != _peerRequests.cend();) {
+		if (i.value() == req) {
+			i = _peerRequests.erase(i);
+		} else {
+			++i;
+		}
+	}
+}
+
 void ApiWrap::lastParticipantsDone(ChannelData *peer, const MTPchannels_ChannelParticipants &result, mtpRequestId req) {
 	bool bots = (_botsRequests.value(peer) == req), fromStart = false;
 	if (bots) {
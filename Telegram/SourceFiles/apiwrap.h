@@ -73,6 +73,7 @@ signals:
 public slots:
 
 	void resolveMessageDatas();
+	void resolvePeers();
 	void resolveWebPages();
 
 	void delayedRequestParticipantsCount();
@@ -92,9 +93,10 @@ private:
 	MessageDataRequests _messageDataRequests;
 	typedef QMap<ChannelData*, MessageDataRequests> ChannelMessageDataRequests;
 	ChannelMessageDataRequests _channelMessageDataRequests;
-	SingleDelayedCall *_messageDataResolveDelayed;
+	SingleTimer _messageDataResolveTimer;
 	typedef QVector<MTPint> MessageIds;
 	MessageIds collectMessageIds(const MessageDataRequests &requests);
+	void setMessageDataRequestId(MessageDataRequests &requests, const MessageIds &ids, mtpRequestId req);
 	MessageDataRequests *messageDataRequests(ChannelData *channel, bool onlyExisting = false);
 
 	void gotChatFull(PeerData *peer, const MTPmessages_ChatFull &result, mtpRequestId req);
@@ -103,12 +105,15 @@ private:
 	typedef QMap<PeerData*, mtpRequestId> PeerRequests;
 	PeerRequests _fullPeerRequests;
 
-	void gotChat(PeerData *peer, const MTPmessages_Chats &result);
-	void gotUser(PeerData *peer, const MTPVector<MTPUser> &result);
-	void gotChats(const MTPmessages_Chats &result);
-	void gotUsers(const MTPVector<MTPUser> &result);
-	bool gotPeerFailed(PeerData *peer, const RPCError &err);
+	// Requested peers are collected for ResolvePeersDelay and requested together,
+	// a peer is in _peerRequests with zero request id until it is sent.
+	void gotChats(const MTPmessages_Chats &result, mtpRequestId req);
+	void gotUsers(const MTPVector<MTPUser> &result, mtpRequestId req);
+	bool gotPeersFailed(const RPCError &error, mtpRequestId req);
+	void peersRequestFinished(mtpRequestId req);
 	PeerRequests _peerRequests;
+	QList<PeerData*> _peersToResolve;
+	SingleTimer _peersResolveTimer;
 
 	void lastParticipantsDone(ChannelData *peer, const MTPchannels_ChannelParticipants &result, mtpRequestId req);
 	bool lastParticipantsFail(ChannelData *peer, const RPCError &error, mtpRequestId req);
@@ -110,6 +110,10 @@ namespace {
 			memset(p, 0, sizeof(p));
 		}
 		QPixmap *p[4];
+
+		// All four corners in one pixmap, painted by a single drawPixmapFragments() call.
+		QPixmap *atlas = nullptr;
+		QPainter::PixmapFragment fragments[4];
 	};
 	CornersPixmaps corners[RoundCornersCount];
 	using CornersMap = QMap<uint32, CornersPixmaps>;
@@ -1578,6 +1582,58 @@ namespace {
 		return nullptr;
 	}
 
+	QString peersMemoryReport() {
+		auto users = 0, nameTexts = 0;
+		auto objects = int64(0), strings = int64(0), stringsInterned = int64(0), indices = int64(0);
+		QSet<const QChar*> counted;
+		auto countString = [&strings, &stringsInterned, &counted](const QString &value) {
+			if (value.isEmpty()) return;
+
+			auto size = int64(sizeof(QArrayData) + (value.size() + 1) * sizeof(QChar));
+			strings += size;
+			if (!counted.contains(value.constData())) {
+				counted.insert(value.constData());
+				stringsInterned += size;
+			}
+		};
+		for_const (auto peer, ::peersData) {
+			auto user = peer->asUser();
+			if (!user) continue;
+
+			++users;
+			objects += sizeof(UserData);
+			if (user->hasNameText()) ++nameTexts;
+			if (user->hasPhoneText()) ++nameTexts;
+			countString(user->name);
+			countString(user->firstName);
+			countString(user->lastName);
+			countString(user->username);
+			countString(user->nameOrPhone);
+			countString(user->phone());
+			for_const (auto &part, user->names) {
+				countString(part);
+			}
+			indices += 2 * sizeof(QArrayData) + user->names.capacity() * sizeof(QString) + user->chars.capacity() * sizeof(QChar);
+		}
+		if (!users) {
+			return qsl("No users are loaded.");
+		}
+		auto table = peerStringsSize();
+		stringsInterned += table;
+
+		auto perUser = [users](int64 value) {
+			return QString::number(double(value) / users, 'f', 1);
+		};
+		return qsl("Users: %1, with %2 name texts built.\n\n"
+			"Objects: %3 bytes per user.\n"
+			"Strings: %4 bytes per user (%5 of them in the intern table), %6 without interning.\n"
+			"Names index: %7 bytes per user.")
+			.arg(users).arg(nameTexts)
+			.arg(perUser(objects))
+			.arg(perUser(stringsInterned)).arg(perUser(table)).arg(perUser(strings))
+			.arg(perUser(indices));
+	}
+
 	void updateImage(ImagePtr &old, ImagePtr now) {
 		if (now->isNull()) return;
 		if (old->isNull()) {
@@ -2075,6 +2131,7 @@ namespace {
 			delete peer;
 		}
 		::peersData.clear();
+		clearPeerStrings();
 		for_const (auto game, ::gamesData) {
 			delete game;
 		}
@@ -2134,6 +2191,10 @@ namespace {
 		}
 	}
 
+	bool historyItemHasDependents(HistoryItem *item) {
+		return ::dependentItems.contains(item);
+	}
+
 	void historyRegRandom(uint64 randomId, const FullMsgId &itemId) {
 		randomData.insert(randomId, itemId);
 	}
@@ -2187,11 +2248,28 @@ namespace {
 		cors[2] = rect.copy(0, r * 2, r, r + (shadow ? s : 0));
 		cors[3] = rect.copy(r * 2, r * 2, r, r + (shadow ? s : 0));
 		if (index != SmallMaskCorners && index != LargeMaskCorners) {
+			auto &c = ::corners[index];
 			for (int i = 0; i < 4; ++i) {
-				::corners[index].p[i] = new QPixmap(pixmapFromImageInPlace(std_::move(cors[i])));
-				::corners[index].p[i]->setDevicePixelRatio(cRetinaFactor());
+				c.p[i] = new QPixmap(pixmapFromImageInPlace(std_::move(cors[i])));
+				c.p[i]->setDevicePixelRatio(cRetinaFactor());
 			}
+
+			// Source rects are in atlas pixels, scale maps them back to the painter coords.
+			auto scale = 1. / cIntRetinaFactor();
+			c.fragments[0] = QPainter::PixmapFragment::create(QPointF(), QRectF(0, 0, r, r), scale, scale);
+			c.fragments[1] = QPainter::PixmapFragment::create(QPointF(), QRectF(r * 2, 0, r, r), scale, scale);
+			c.fragments[2] = QPainter::PixmapFragment::create(QPointF(), QRectF(0, r * 2, r, r + (shadow ? s : 0)), scale, scale);
+			c.fragments[3] = QPainter::PixmapFragment::create(QPointF(), QRectF(r * 2, r * 2, r, r + (shadow ? s : 0)), scale, scale);
+			c.atlas = new QPixmap(pixmapFromImageInPlace(std_::move(rect)));
+		}
+	}
+
+	void clearCorners(RoundCorners index) {
+		auto &c = ::corners[index];
+		for (int i = 0; i < 4; ++i) {
+			delete c.p[i]; c.p[i] = nullptr;
 		}
+		delete c.atlas; c.atlas = nullptr;
 	}
 
 	void tryFontFamily(QString &family, const QString &tryFamily) {
@@ -2287,10 +2365,10 @@ namespace {
 		::emoji = 0;
 		delete ::emojiLarge;
 		::emojiLarge = 0;
+		for (int i = 0; i < RoundCornersCount; ++i) {
+			clearCorners(RoundCorners(i));
+		}
 		for (int j = 0; j < 4; ++j) {
-			for (int i = 0; i < RoundCornersCount; ++i) {
-				delete ::corners[i].p[j]; ::corners[i].p[j] = nullptr;
-			}
 			delete ::cornersMaskSmall[j]; ::cornersMaskSmall[j] = nullptr;
 			delete ::cornersMaskLarge[j]; ::cornersMaskLarge[j] = nullptr;
 		}
@@ -2709,7 +2787,7 @@ namespace {
 		}
 		return ::cornersMaskSmall;
 	}
-	void roundRect(Painter &p, int32 x, int32 y, int32 w, int32 h, const style::color &bg, const CornersPixmaps &c, const style::color *sh) {
+	void roundRect(Painter &p, int32 x, int32 y, int32 w, int32 h, const style::color &bg, const CornersPixmaps &c, const style::color *sh, bool useAtlas = true) {
 		int32 cw = c.p[0]->width() / cIntRetinaFactor(), ch = c.p[0]->height() / cIntRetinaFactor();
 		if (w < 2 * cw || h < 2 * ch) return;
 		if (w > 2 * cw) {
@@ -2720,10 +2798,23 @@ namespace {
 		if (h > 2 * ch) {
 			p.fillRect(QRect(x, y + ch, w, h - 2 * ch), bg->b);
 		}
-		p.drawPixmap(QPoint(x, y), *c.p[0]);
-		p.drawPixmap(QPoint(x + w - cw, y), *c.p[1]);
-		p.drawPixmap(QPoint(x, y + h - ch), *c.p[2]);
-		p.drawPixmap(QPoint(x + w - cw, y + h - ch), *c.p[3]);
+		if (c.atlas && useAtlas) {
+			QPainter::PixmapFragment fragments[4] = { c.fragments[0], c.fragments[1], c.fragments[2], c.fragments[3] };
+			auto place = [](QPainter::PixmapFragment &fragment, int32 left, int32 top) {
+				fragment.x = left + fragment.width * fragment.scaleX / 2.;
+				fragment.y = top + fragment.height * fragment.scaleY / 2.;
+			};
+			place(fragments[0], x, y);
+			place(fragments[1], x + w - cw, y);
+			place(fragments[2], x, y + h - ch);
+			place(fragments[3], x + w - cw, y + h - ch);
+			p.drawPixmapFragments(fragments, 4, *c.atlas);
+		} else {
+			p.drawPixmap(QPoint(x, y), *c.p[0]);
+			p.drawPixmap(QPoint(x + w - cw, y), *c.p[1]);
+			p.drawPixmap(QPoint(x, y + h - ch), *c.p[2]);
+			p.drawPixmap(QPoint(x + w - cw, y + h - ch), *c.p[3]);
+		}
 	}
 
 	void roundRect(Painter &p, int32 x, int32 y, int32 w, int32 h, const style::color &bg, RoundCorners index, const style::color *sh) {
@@ -2761,7 +2852,47 @@ namespace {
 		roundRect(p, x, y, w, h, bg, i.value(), 0);
 	}
 
-	void initBackground(int32 id, const QImage &p, bool nowrite) {
+	QString roundRectsBenchmark() {
+		constexpr auto kBubbles = 500;
+		constexpr auto kFrames = 20;
+
+		// Synthetic chat: in / out, some selected, different sizes, wrapped in a tall window.
+		auto width = 640, height = 2048, top = 0;
+		QVector<QRect> rects;
+		rects.reserve(kBubbles);
+		for (auto i = 0; i != kBubbles; ++i) {
+			auto w = 2 * msgRadius() + ((i * 37) % 400), h = 2 * msgRadius() + ((i * 53) % 120);
+			if (top + h + st::msgShadow > height) {
+				top = 0;
+			}
+			rects.push_back(QRect((i % 2) ? (width - w) : 0, top, w, h));
+			top += h + st::msgMargin.bottom();
+		}
+		QImage canvas(width * cIntRetinaFactor(), height * cIntRetinaFactor(), QImage::Format_ARGB32_Premultiplied);
+		canvas.setDevicePixelRatio(cRetinaFactor());
+
+		auto paint = [&rects, &canvas](bool useAtlas) {
+			auto ms = getms();
+			for (auto frame = 0; frame != kFrames; ++frame) {
+				canvas.fill(Qt::transparent);
+				Painter p(&canvas);
+				for (auto i = 0, count = rects.size(); i != count; ++i) {
+					auto out = (i % 2), selected = !(i % 7);
+					auto index = out ? (selected ? MessageOutSelectedCorners : MessageOutCorners) : (selected ? MessageInSelectedCorners : MessageInCorners);
+					auto &bg = out ? (selected ? st::msgOutBgSelected : st::msgOutBg) : (selected ? st::msgInBgSelected : st::msgInBg);
+					auto &sh = out ? (selected ? st::msgOutShadowSelected : st::msgOutShadow) : (selected ? st::msgInShadowSelected : st::msgInShadow);
+					auto &r = rects[i];
+					roundRect(p, r.x(), r.y(), r.width(), r.height(), bg, ::corners[index], &sh, useAtlas);
+				}
+			}
+			return (getms() - ms) / float64(kFrames);
+		};
+		paint(true); // warm up
+		auto separate = paint(false), atlas = paint(true);
+		return qsl("%1 bubbles, ms per frame: %2 with separate corners, %3 with the corners atlas").arg(kBubbles).arg(separate, 0, 'f', 2).arg(atlas, 0, 'f', 2);
+	}
+
+	void initBackground(int32 id, const QImage &p, bool nowrite, const QVector<QImage> &mips) {
 		if (Local::readBackground()) return;
 
 		uint64 components[3] = { 0 }, componentsScroll[3] = { 0 }, componentsPoint[3] = { 0 };
@@ -2788,8 +2919,9 @@ namespace {
 		}
 		img.setDevicePixelRatio(cRetinaFactor());
 
+		auto levels = Window::ChatBackground::checkMips(img, mips) ? mips : Window::ChatBackground::prepareMips(img);
 		if (!nowrite) {
-			Local::writeBackground(id, remove ? QImage() : img);
+			Local::writeBackground(id, remove ? QImage() : img, remove ? QVector<QImage>() : levels);
 		}
 
 		int w = img.width(), h = img.height();
@@ -2819,7 +2951,13 @@ namespace {
 
 		uint64 max = qMax(1ULL, components[maxtomin[0]]), mid = qMax(1ULL, components[maxtomin[1]]), min = qMax(1ULL, components[maxtomin[2]]);
 
-		Window::chatBackground()->init(id, pixmapFromImageInPlace(std_::move(img)));
+		QVector<QPixmap> levelPixmaps;
+		levelPixmaps.reserve(levels.size());
+		for (auto &level : levels) {
+			levelPixmaps.push_back(pixmapFromImageInPlace(std_::move(level)));
+			levelPixmaps.back().setDevicePixelRatio(cRetinaFactor());
+		}
+		Window::chatBackground()->init(id, pixmapFromImageInPlace(std_::move(img)), std_::move(levelPixmaps));
 
 		memcpy(componentsScroll, components, sizeof(components));
 		memcpy(componentsPoint, components, sizeof(components));
@@ -2876,10 +3014,8 @@ namespace {
 		uchar bsel = snap(qRound(((1. - alphaSel) * b + addSel) / alphaSel), 0, 0xFF);
 		_msgServiceSelectBg = style::color(r, g, b, qRound(alphaSel * 0xFF));
 
-		for (int i = 0; i < 4; ++i) {
-			delete ::corners[StickerCorners].p[i]; ::corners[StickerCorners].p[i] = nullptr;
-			delete ::corners[StickerSelectedCorners].p[i]; ::corners[StickerSelectedCorners].p[i] = nullptr;
-		}
+		clearCorners(StickerCorners);
+		clearCorners(StickerSelectedCorners);
 		prepareCorners(StickerCorners, st::dateRadius, _msgServiceBg);
 		prepareCorners(StickerSelectedCorners, st::dateRadius, _msgServiceSelectBg);
 
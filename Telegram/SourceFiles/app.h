@@ -149,6 +149,7 @@ namespace App {
 
 	UserData *self();
 	PeerData *peerByName(const QString &username);
+	QString peersMemoryReport(); // estimated memory taken by the loaded users
 	QString peerName(const PeerData *peer, bool forDialogs = false);
 	PhotoData *photo(const PhotoId &photo);
 	PhotoData *photoSet(const PhotoId &photo, PhotoData *convert, const uint64 &access, int32 date, const ImagePtr &thumb, const ImagePtr &medium, const ImagePtr &full);
@@ -189,6 +190,7 @@ namespace App {
 	void historyClearItems();
 	void historyRegDependency(HistoryItem *dependent, HistoryItem *dependency);
 	void historyUnregDependency(HistoryItem *dependent, HistoryItem *dependency);
+	bool historyItemHasDependents(HistoryItem *item);
 
 	void historyRegRandom(uint64 randomId, const FullMsgId &itemId);
 	void historyUnregRandom(uint64 randomId);
@@ -292,8 +294,9 @@ namespace App {
 	inline void roundRect(Painter &p, const QRect &rect, const style::color &bg, ImageRoundRadius radius) {
 		return roundRect(p, rect.x(), rect.y(), rect.width(), rect.height(), bg, radius);
 	}
+	QString roundRectsBenchmark(); // for the "bubblebench" settings code
 
-	void initBackground(int32 id = DefaultChatBackground, const QImage &p = QImage(), bool nowrite = false);
+	void initBackground(int32 id = DefaultChatBackground, const QImage &p = QImage(), bool nowrite = false, const QVector<QImage> &mips = QVector<QImage>());
 
 	const style::color &msgServiceBg();
 	const style::color &msgServiceSelectBg();
@@ -32,6 +32,7 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 #include "langloaderplain.h"
 #include "localstorage.h"
 #include "autoupdater.h"
+#include "core/startup_profiler.h"
 #include "core/observer.h"
 #include "observer_peer.h"
 #include "window/chat_background.h"
@@ -687,7 +688,10 @@ AppClass::AppClass() : QObject()
 
 	ThirdParty::start();
 	Global::start();
-	Local::start();
+	{
+		StartupProfiler::Phase phase("Local::start");
+		Local::start();
+	}
 	if (Local::oldSettingsVersion() < AppVersion) {
 		psNewVersion();
 	}
@@ -750,9 +754,12 @@ AppClass::AppClass() : QObject()
 	// Create mime database, so it won't be slow later.
 	QMimeDatabase().mimeTypeForName(qsl("text/plain"));
 
-	_window = new MainWindow();
-	_window->createWinId();
-	_window->init();
+	{
+		StartupProfiler::Phase phase("MainWindow::init");
+		_window = new MainWindow();
+		_window->createWinId();
+		_window->init();
+	}
 
 	Sandbox::connect(SIGNAL(applicationStateChanged(Qt::ApplicationState)), this, SLOT(onAppStateChanged(Qt::ApplicationState)));
 
@@ -761,7 +768,10 @@ AppClass::AppClass() : QObject()
 	Shortcuts::start();
 
 	initLocationManager();
-	App::initMedia();
+	{
+		StartupProfiler::Phase phase("App::initMedia");
+		App::initMedia();
+	}
 
 	Local::ReadMapState state = Local::readMap(QByteArray());
 	if (state == Local::ReadMapPassNeeded) {
@@ -779,16 +789,22 @@ AppClass::AppClass() : QObject()
 	DEBUG_LOG(("Application Info: MTP started..."));
 
 	DEBUG_LOG(("Application Info: showing."));
-	if (state == Local::ReadMapPassNeeded) {
-		_window->setupPasscode(false);
-	} else {
-		if (MTP::authedId()) {
-			_window->setupMain(false);
+	{
+		StartupProfiler::Phase phase("MainWindow::setup");
+		if (state == Local::ReadMapPassNeeded) {
+			_window->setupPasscode(false);
 		} else {
-			_window->setupIntro(false);
+			if (MTP::authedId()) {
+				_window->setupMain(false);
+			} else {
+				_window->setupIntro(false);
+			}
 		}
+		_window->firstShow();
+	}
+	if (state == Local::ReadMapPassNeeded || !MTP::authedId()) {
+		StartupProfiler::finish(); // no dialogs list will be painted soon
 	}
-	_window->firstShow();
 
 	if (cStartToSettings()) {
 		_window->showSettings();
@@ -27,14 +27,34 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 #include "styles/style_boxes.h"
 #include "mainwindow.h"
 
+namespace {
+
+constexpr auto kClearOldAge = 7 * 86400;
+
+int64 LocalStorageLimits[] = {
+	0,
+	256 * 1024 * 1024,
+	512 * 1024 * 1024,
+	1024 * 1024 * 1024,
+	2 * int64(1024 * 1024 * 1024),
+	4 * int64(1024 * 1024 * 1024),
+};
+
+} // namespace
+
 LocalStorageBox::LocalStorageBox() : AbstractBox()
 , _clear(this, lang(lng_local_storage_clear), st::defaultBoxLinkButton)
+, _clearOld(this, lang(lng_local_storage_clear_old), st::defaultBoxLinkButton)
+, _limit(this, limitText(), st::defaultBoxLinkButton)
 , _close(this, lang(lng_box_ok), st::defaultBoxButton) {
 	connect(_clear, SIGNAL(clicked()), this, SLOT(onClear()));
+	connect(_clearOld, SIGNAL(clicked()), this, SLOT(onClearOld()));
+	connect(_limit, SIGNAL(clicked()), this, SLOT(onLimit()));
 	connect(_close, SIGNAL(clicked()), this, SLOT(onClose()));
 
 	connect(App::wnd(), SIGNAL(tempDirCleared(int)), this, SLOT(onTempDirCleared(int)));
 	connect(App::wnd(), SIGNAL(tempDirClearFailed(int)), this, SLOT(onTempDirClearFailed(int)));
+	connect(App::wnd(), SIGNAL(tempDirClearProgress(int,int,int,qint64,qint64)), this, SLOT(onTempDirClearProgress(int,int,int,qint64,qint64)));
 
 	subscribe(FileDownload::ImageLoaded(), [this] { update(); });
 
@@ -49,16 +69,30 @@ void LocalStorageBox::updateControls() {
 	} else {
 		rowsHeight = st::linkFont->height + st::localStorageBoxSkip;
 	}
-	_clear->setVisible(_imagesCount > 0 || _audiosCount > 0);
-	setMaxHeight(st::boxTitleHeight + st::localStorageBoxSkip + rowsHeight + _clear->height() + st::boxButtonPadding.top() + _close->height() + st::boxButtonPadding.bottom());
-	_clear->moveToLeft(st::boxPadding.left(), st::boxTitleHeight + st::localStorageBoxSkip + rowsHeight);
+	auto clearVisible = (_imagesCount > 0 || _audiosCount > 0) && (_state != State::Clearing);
+	_clear->setVisible(clearVisible);
+	_clearOld->setVisible(clearVisible);
+
+	auto top = st::boxTitleHeight + st::localStorageBoxSkip + rowsHeight;
+	_clear->moveToLeft(st::boxPadding.left(), top);
+	top += _clear->height() + st::localStorageBoxSkip;
+	if (clearVisible) {
+		_clearOld->moveToLeft(st::boxPadding.left(), top);
+		top += _clearOld->height() + st::localStorageBoxSkip;
+	}
+	_limit->moveToLeft(st::boxPadding.left(), top);
+	top += _limit->height();
+
+	setMaxHeight(top + st::boxButtonPadding.top() + _close->height() + st::boxButtonPadding.bottom());
 	_close->moveToRight(st::boxButtonPadding.right(), height() - st::boxButtonPadding.bottom() - _close->height());
 	update();
 }
 
 void LocalStorageBox::showAll() {
 	showChildren();
-	_clear->setVisible(_imagesCount > 0 || _audiosCount > 0);
+	auto clearVisible = (_imagesCount > 0 || _audiosCount > 0) && (_state != State::Clearing);
+	_clear->setVisible(clearVisible);
+	_clearOld->setVisible(clearVisible);
 }
 
 void LocalStorageBox::checkLocalStoredCounts() {
@@ -67,13 +101,18 @@ void LocalStorageBox::checkLocalStoredCounts() {
 	if (imagesCount != _imagesCount || audiosCount != _audiosCount) {
 		_imagesCount = imagesCount;
 		_audiosCount = audiosCount;
-		if (_imagesCount > 0 || _audiosCount > 0) {
+		if ((_imagesCount > 0 || _audiosCount > 0) && _state != State::Clearing) {
 			_state = State::Normal;
 		}
 		updateControls();
 	}
 }
 
+QString LocalStorageBox::limitText() const {
+	auto limit = Global::LocalStorageLimit();
+	return (limit > 0) ? lng_local_storage_limit(lt_size, formatSizeText(limit)) : lang(lng_local_storage_no_limit);
+}
+
 void LocalStorageBox::paintEvent(QPaintEvent *e) {
 	Painter p(this);
 	if (paint(p)) return;
@@ -99,7 +138,9 @@ void LocalStorageBox::paintEvent(QPaintEvent *e) {
 	}
 	auto text = ([this]() -> QString {
 		switch (_state) {
-		case State::Clearing: return lang(lng_local_storage_clearing);
+		case State::Clearing: return (_clearBytesCount > 0)
+			? lng_local_storage_clearing_progress(lt_ready, formatSizeText(_clearBytesDone), lt_total, formatSizeText(_clearBytesCount), lt_count, _clearFilesDone)
+			: lang(lng_local_storage_clearing);
 		case State::Cleared: return lang(lng_local_storage_cleared);
 		case State::ClearFailed: return lang(lng_local_storage_clear_failed);
 		}
@@ -111,9 +152,36 @@ void LocalStorageBox::paintEvent(QPaintEvent *e) {
 	}
 }
 
-void LocalStorageBox::onClear() {
-	App::wnd()->tempDirDelete(Local::ClearManagerStorage);
+void LocalStorageBox::startClearing(int task, TimeId age) {
+	_clearFilesDone = 0;
+	_clearBytesDone = _clearBytesCount = 0;
 	_state = State::Clearing;
+	App::wnd()->tempDirDelete(task, age);
+	updateControls();
+}
+
+void LocalStorageBox::onClear() {
+	startClearing(Local::ClearManagerStorage);
+}
+
+void LocalStorageBox::onClearOld() {
+	startClearing(Local::ClearManagerStorage | Local::ClearManagerOld, kClearOldAge);
+}
+
+void LocalStorageBox::onLimit() {
+	auto current = Global::LocalStorageLimit();
+	auto limit = LocalStorageLimits[0];
+	for (auto i = 0, count = int(base::array_size(LocalStorageLimits)); i != count; ++i) {
+		if (LocalStorageLimits[i] > current) {
+			limit = LocalStorageLimits[i];
+			break;
+		}
+	}
+	Global::SetLocalStorageLimit(limit);
+	Local::writeUserSettings();
+	Local::checkStorageLimit();
+
+	_limit->setText(limitText());
 	updateControls();
 }
 
@@ -130,3 +198,13 @@ void LocalStorageBox::onTempDirClearFailed(int task) {
 	}
 	updateControls();
 }
+
+void LocalStorageBox::onTempDirClearProgress(int task, int filesDone, int filesCount, qint64 bytesDone, qint64 bytesCount) {
+	if (_state != State::Clearing || !(task & Local::ClearManagerStorage)) {
+		return;
+	}
+	_clearFilesDone = filesDone;
+	_clearBytesDone = bytesDone;
+	_clearBytesCount = bytesCount;
+	update();
+}
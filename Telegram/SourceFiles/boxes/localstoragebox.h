@@ -33,8 +33,11 @@ public:
 
 private slots:
 	void onClear();
+	void onClearOld();
+	void onLimit();
 	void onTempDirCleared(int task);
 	void onTempDirClearFailed(int task);
+	void onTempDirClearProgress(int task, int filesDone, int filesCount, qint64 bytesDone, qint64 bytesCount);
 
 protected:
 	void paintEvent(QPaintEvent *e) override;
@@ -44,6 +47,8 @@ protected:
 private:
 	void updateControls();
 	void checkLocalStoredCounts();
+	void startClearing(int task, TimeId age = 0);
+	QString limitText() const;
 
 	enum class State {
 		Normal,
@@ -54,9 +59,15 @@ private:
 	State _state = State::Normal;
 
 	ChildWidget<LinkButton> _clear;
+	ChildWidget<LinkButton> _clearOld;
+	ChildWidget<LinkButton> _limit;
 	ChildWidget<BoxButton> _close;
 
 	int _imagesCount = -1;
 	int _audiosCount = -1;
 
+	int _clearFilesDone = 0;
+	qint64 _clearBytesDone = 0;
+	qint64 _clearBytesCount = 0;
+
 };
@@ -79,11 +79,14 @@ enum {
 	LocalEncryptKeySize = 256, // 2048 bit
 
 	AnimationTimerDelta = 7,
+	TypingDotsFrameInterval = 50, // typing dots change each 150ms, no need to step them each display frame
 	ClipThreadsCount = 8,
 	AverageGifSize = 320 * 240,
 	WaitBeforeGifPause = 200, // wait 200ms for gif draw before pausing it
 	InlineBotRequestDelay = 400, // wait 400ms before context bot realtime request
 	RecentInlineBotsLimit = 10,
+	InlineBotResultsCacheLimit = 64, // remember results of 64 recent inline bot queries
+	InlineBotResultsCacheTimeout = 300, // forget inline bot results after 5 minutes
 
 	AVBlockSize = 4096, // 4Kb for ffmpeg blocksize
 
@@ -96,6 +99,9 @@ enum {
 	LinksOverviewPerPage = 12,
 	MediaOverviewStartPerPage = 5,
 	MediaOverviewPreloadCount = 4,
+	MediaOverviewPreloadMaxCount = 16, // when the user flips through the media fast
+	MediaViewPreloadMemoryLimit = 256 * 1024 * 1024, // 256 Mb of decoded photos preloaded ahead
+	MediaViewPrepareQueueStopTimeout = 5000, // 5 secs
 
 	AudioSimultaneousLimit = 4,
 	AudioCheckPositionTimeout = 100, // 100ms per check audio pos
@@ -112,13 +118,28 @@ enum {
 	AudioVoiceMsgBufferSize = 256 * 1024, // 256 Kb buffers (1.3 - 3.0 secs)
 	AudioVoiceMsgInMemory = 2 * 1024 * 1024, // 2 Mb audio is hold in memory and auto loaded
 	AudioPauseDeviceTimeout = 3000, // pause in 3 secs after playing is over
+	AudioPrebufferMs = 10000, // decode up to 10 secs of voice / song ahead of the playback
+	AudioPrebufferChunksLimit = 32, // decoded chunks waiting to be queued to OpenAL
 
 	WaveformSamplesCount = 100,
+	WaveformCountThreadsLimit = 2, // voice waveforms are counted in parallel, but not more than that
+	LocalPrefetchThreadsLimit = 4, // files needed at startup are read and decrypted in parallel, but not more than that
+	LocalMapJournalSizeMin = 64 * 1024, // cache map changes are appended to a journal until it is larger than this and than half of the map
+	LocalClearBatchSize = 64, // cached files are deleted by batches of that many files
+	LocalClearBatchPause = 20, // with a 20 ms pause between the batches, so that the disk is not kept busy
+	LocalStorageLimitCheckTimeout = 10000, // check the cache size limit 10 secs after a new file was cached
+	MessagesMemoryCheckTimeout = 5000, // check the messages memory limit 5 secs after new messages were added
+	HistoryUnloadKeepItems = 200, // when unloading far history blocks keep that many messages around the scroll position
+	WaveformsCacheLimit = 4096, // remember counted waveforms of this many last voice messages
 
 	StickerInMemory = 2 * 1024 * 1024, // 2 Mb stickers hold in memory, auto loaded and displayed inline
 	StickerMaxSize = 2048, // 2048x2048 is a max image size for sticker
 
 	AnimationInMemory = 10 * 1024 * 1024, // 10 Mb gif and mp4 animations held in memory while playing
+	SharedClipFramesLimit = 64 * 1024 * 1024, // 64 Mb of decoded gif frames shared between readers of the same animation
+	SharedClipFramesEntryLimit = 16 * 1024 * 1024, // 16 Mb max for one loop of one animation in the shared frames cache
+	SharedClipUncacheableLimit = 64, // remember that many last animations that were too large for the shared frames cache
+	ClipSidecarKeyframesLimit = 1024, // max keyframes saved in the local clip sidecar for seeking
 
 	MediaViewImageSizeLimit = 100 * 1024 * 1024, // show up to 100mb jpg/png/gif docs in app
 	MaxZoomLevel = 7, // x8
@@ -145,6 +166,10 @@ enum {
 	MaxMessageSize = 4096,
 	MaxHttpRedirects = 5, // when getting external data/images
 
+	ResolvePeersDelay = 20, // requested peers are collected for 20 ms and requested together
+	ResolveMessageDatasDelay = 20, // the same for the requested messages, like reply or pinned ones
+	ResolveIdsLimit = 100, // not more than that many ids in users.getUsers, channels.getChannels or messages.getMessages
+
 	WriteMapTimeout = 1000,
 	SaveDraftTimeout = 1000, // save draft after 1 secs of not changing text
 	SaveDraftAnywayTimeout = 5000, // or save anyway each 5 secs
@@ -157,7 +182,8 @@ enum {
 	ServiceUserId = 777000,
 	WebPageUserId = 701000,
 
-	CacheBackgroundTimeout = 3000, // cache background scaled image after 3s
+	CacheBackgroundTimeout = 300, // cache background scaled image after 0.3s
+	CacheBackgroundQueueStopTimeout = 5000, // stop background scaling thread after 5s of inactivity
 	BackgroundsInRow = 3,
 
 	UpdateDelayConstPart = 8 * 3600, // 8 hour min time between update check requests
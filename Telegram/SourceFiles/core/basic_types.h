@@ -28,6 +28,7 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 
 #include "core/stl_subset.h"
 #include "core/ordered_set.h"
+#include "core/flat_set.h"
 
 //using uchar = unsigned char; // Qt has uchar
 using int16 = qint16;
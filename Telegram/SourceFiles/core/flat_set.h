@@ -0,0 +1,98 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop version of Telegram messaging app, see https://telegram.org
+
+Telegram Desktop is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+In addition, as a special exception, the copyright holders give permission
+to link the code of portions of this program with the OpenSSL library.
+
+Full license: https://github.com/telegramdesktop/tdesktop/blob/master/LICENSE
+Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
+*/
+#pragma once
+
+#include <algorithm>
+#include <QtCore/QVector>
+
+// ordered set template based on a sorted QVector
+// for small sets that are kept by tens of thousands of objects,
+// it takes a single allocation instead of one per value in OrderedSet
+template <typename T>
+class FlatSet {
+	using Self = FlatSet<T>;
+	using Impl = QVector<T>;
+	Impl impl_;
+
+public:
+	inline bool operator==(const Self &other) const { return impl_ == other.impl_; }
+	inline bool operator!=(const Self &other) const { return impl_ != other.impl_; }
+	inline int size() const { return impl_.size(); }
+	inline bool isEmpty() const { return impl_.isEmpty(); }
+	inline void clear() { return impl_.clear(); }
+	inline void reserve(int size) { return impl_.reserve(size); }
+	inline void squeeze() { return impl_.squeeze(); }
+	inline int capacity() const { return impl_.capacity(); }
+	inline const Impl &values() const { return impl_; }
+	inline const T &first() const { return impl_.first(); }
+	inline const T &last() const { return impl_.last(); }
+
+	// the values are never changed in place, so that they stay sorted
+	typedef typename Impl::const_iterator const_iterator;
+	typedef const_iterator iterator;
+
+	// STL style
+	inline const_iterator begin() const { return impl_.cbegin(); }
+	inline const_iterator constBegin() const { return impl_.cbegin(); }
+	inline const_iterator cbegin() const { return impl_.cbegin(); }
+	inline const_iterator end() const { return impl_.cend(); }
+	inline const_iterator constEnd() const { return impl_.cend(); }
+	inline const_iterator cend() const { return impl_.cend(); }
+
+	inline const_iterator lowerBound(const T &value) const { return std::lower_bound(impl_.cbegin(), impl_.cend(), value); }
+	inline const_iterator find(const T &value) const {
+		auto i = lowerBound(value);
+		return (i != impl_.cend() && !(value < *i)) ? i : impl_.cend();
+	}
+	inline const_iterator constFind(const T &value) const { return find(value); }
+	inline bool contains(const T &value) const { return find(value) != impl_.cend(); }
+
+	inline void insert(const T &value) {
+		auto i = lowerBound(value);
+		if (i == impl_.cend() || value < *i) {
+			impl_.insert(i - impl_.cbegin(), value);
+		}
+	}
+	inline const_iterator erase(const_iterator it) {
+		auto index = it - impl_.cbegin();
+		impl_.remove(index);
+		return impl_.cbegin() + index;
+	}
+	inline int remove(const T &value) {
+		auto i = find(value);
+		if (i == impl_.cend()) {
+			return 0;
+		}
+		impl_.remove(i - impl_.cbegin());
+		return 1;
+	}
+
+	// more Qt
+	typedef const_iterator ConstIterator;
+	typedef iterator Iterator;
+	inline int count() const { return impl_.count(); }
+
+	// STL compatibility
+	typedef typename Impl::difference_type difference_type;
+	typedef typename Impl::size_type size_type;
+	inline bool empty() const { return impl_.empty(); }
+
+};
@@ -0,0 +1,216 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop version of Telegram messaging app, see https://telegram.org
+
+Telegram Desktop is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+In addition, as a special exception, the copyright holders give permission
+to link the code of portions of this program with the OpenSSL library.
+
+Full license: https://github.com/telegramdesktop/tdesktop/blob/master/LICENSE
+Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
+*/
+#include "stdafx.h"
+#include "core/memory_pool.h"
+
+#include <map>
+#include <vector>
+#include <algorithm>
+
+namespace MemoryPool {
+namespace {
+
+constexpr auto kGranularity = std::size_t(16);
+constexpr auto kMaxPooledSize = std::size_t(1024); // larger blocks are taken from the heap
+constexpr auto kClassesCount = kMaxPooledSize / kGranularity;
+constexpr auto kSlabSize = std::size_t(64 * 1024);
+
+struct FreeBlock {
+	FreeBlock *next;
+};
+
+struct Slab {
+	char *data = nullptr;
+	FreeBlock *free = nullptr;
+	char *unusedFrom = nullptr; // not used yet part of the slab
+	char *unusedTill = nullptr;
+	int live = 0;
+	bool available = false; // is in the available list of its size class
+
+	bool full() const {
+		return !free && (unusedFrom == unusedTill);
+	}
+};
+
+struct SizeClass {
+	std::vector<Slab*> available; // slabs with free blocks, the last one is used first
+};
+SizeClass Classes[kClassesCount];
+std::map<const char*, Slab*> Slabs; // by slab data, to find the slab of a released block
+int64 SlabsSize = 0;
+int64 LargeCount = 0;
+int64 LargeSize = 0;
+
+struct KindStats {
+	int64 count = 0;
+	int64 requested = 0;
+	int64 heap = 0;
+};
+KindStats Stats[kKindsCount];
+
+// Estimate for the usual malloc: a header of one pointer,
+// rounded up to two pointers and not less than four pointers.
+int64 heapBlockSize(std::size_t size) {
+	constexpr auto kAlign = 2 * sizeof(void*);
+	return qMax(2 * kAlign, (size + sizeof(void*) + kAlign - 1) & ~(kAlign - 1));
+}
+
+bool pooled(std::size_t size) {
+	return (size > 0 && size <= kMaxPooledSize);
+}
+
+Slab *createSlab(std::size_t blockSize) {
+	auto slab = new Slab();
+	slab->data = static_cast<char*>(operator new(kSlabSize));
+	slab->unusedFrom = slab->data;
+	slab->unusedTill = slab->data + (kSlabSize / blockSize) * blockSize;
+	Slabs.emplace(slab->data, slab);
+	SlabsSize += kSlabSize;
+	return slab;
+}
+
+void destroySlab(SizeClass &sizeClass, Slab *slab) {
+	if (slab->available) {
+		auto i = std::find(sizeClass.available.begin(), sizeClass.available.end(), slab);
+		t_assert(i != sizeClass.available.end());
+		sizeClass.available.erase(i);
+	}
+	Slabs.erase(slab->data);
+	SlabsSize -= kSlabSize;
+	operator delete(slab->data);
+	delete slab;
+}
+
+} // namespace
+
+void *allocate(std::size_t size, Kind kind) {
+	auto &stats = Stats[static_cast<int>(kind)];
+	++stats.count;
+	stats.requested += size;
+	stats.heap += heapBlockSize(size);
+	if (!pooled(size)) {
+		++LargeCount;
+		LargeSize += heapBlockSize(size);
+		return operator new(size);
+	}
+
+	auto index = (size - 1) / kGranularity;
+	auto blockSize = (index + 1) * kGranularity;
+	auto &sizeClass = Classes[index];
+	if (sizeClass.available.empty()) {
+		auto slab = createSlab(blockSize);
+		slab->available = true;
+		sizeClass.available.push_back(slab);
+	}
+	auto slab = sizeClass.available.back();
+	++slab->live;
+
+	void *result = nullptr;
+	if (auto block = slab->free) {
+		slab->free = block->next;
+		result = block;
+	} else {
+		result = slab->unusedFrom;
+		slab->unusedFrom += blockSize;
+	}
+	if (slab->full()) {
+		slab->available = false;
+		sizeClass.available.pop_back();
+	}
+	return result;
+}
+
+void release(void *data, std::size_t size, Kind kind) {
+	if (!data) return;
+
+	auto &stats = Stats[static_cast<int>(kind)];
+	--stats.count;
+	stats.requested -= size;
+	stats.heap -= heapBlockSize(size);
+	if (!pooled(size)) {
+		--LargeCount;
+		LargeSize -= heapBlockSize(size);
+		operator delete(data);
+		return;
+	}
+
+	auto index = (size - 1) / kGranularity;
+	auto &sizeClass = Classes[index];
+
+	// The slab of the block is the last one starting not after it.
+	auto i = Slabs.upper_bound(static_cast<const char*>(data));
+	t_assert(i != Slabs.begin());
+	auto slab = (--i)->second;
+	t_assert(static_cast<char*>(data) < slab->data + kSlabSize);
+
+	if (!--slab->live) {
+		// Empty slabs are returned to the heap right away, so that the memory
+		// of the unloaded and deleted messages is given back to the system.
+		destroySlab(sizeClass, slab);
+		return;
+	}
+	auto block = static_cast<FreeBlock*>(data);
+	block->next = slab->free;
+	slab->free = block;
+	if (!slab->available) {
+		slab->available = true;
+		sizeClass.available.push_back(slab);
+	}
+}
+
+int64 liveSize() {
+	auto result = int64(0);
+	for_const (auto &stats, Stats) {
+		result += stats.requested;
+	}
+	return result;
+}
+
+QString report() {
+	auto messages = Stats[static_cast<int>(Kind::HistoryItem)].count;
+	if (!messages) {
+		return qsl("No messages are loaded.");
+	}
+
+	auto count = int64(0), requested = int64(0), heap = int64(0);
+	for_const (auto &stats, Stats) {
+		count += stats.count;
+		requested += stats.requested;
+		heap += stats.heap;
+	}
+	auto perMessage = [messages](int64 value) {
+		return QString::number(double(value) / messages, 'f', 1);
+	};
+	auto poolCount = SlabsSize / int64(kSlabSize) + LargeCount;
+	auto poolSize = SlabsSize + LargeSize;
+	auto components = Stats[static_cast<int>(Kind::Components)].count;
+	auto media = Stats[static_cast<int>(Kind::HistoryMedia)].count;
+	return qsl("Messages: %1, with %2 component blocks and %3 media.\n\n"
+		"Requested: %4 bytes per message.\n"
+		"Heap: %5 allocations, %6 bytes per message.\n"
+		"Pool: %7 allocations, %8 bytes per message.")
+		.arg(messages).arg(components).arg(media)
+		.arg(perMessage(requested))
+		.arg(perMessage(count)).arg(perMessage(heap))
+		.arg(perMessage(poolCount)).arg(perMessage(poolSize));
+}
+
+} // namespace MemoryPool
@@ -0,0 +1,46 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop version of Telegram messaging app, see https://telegram.org
+
+Telegram Desktop is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+In addition, as a special exception, the copyright holders give permission
+to link the code of portions of this program with the OpenSSL library.
+
+Full license: https://github.com/telegramdesktop/tdesktop/blob/master/LICENSE
+Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
+*/
+#pragma once
+
+namespace MemoryPool {
+
+// History items, their components and media are created by tens of thousands
+// in large chats, so they are allocated from slabs of same size blocks instead
+// of the heap. Each slab keeps a free list of its blocks and the count of the
+// live ones, it is returned to the heap as soon as all of its blocks are free.
+// Main thread only.
+enum class Kind {
+	HistoryItem,
+	Components,
+	HistoryMedia,
+};
+constexpr auto kKindsCount = 3;
+
+void *allocate(std::size_t size, Kind kind);
+void release(void *data, std::size_t size, Kind kind);
+
+// Bytes requested by the live blocks of all kinds.
+int64 liveSize();
+
+// Compares the memory taken by the live blocks to the heap allocations they replace.
+QString report();
+
+} // namespace MemoryPool
@@ -148,6 +148,7 @@ public:
 	inline int count() const { return impl_.count(); }
 	inline iterator find(const T &value) { return iterator(impl_.find(value)); }
 	inline const_iterator find(const T &value) const { return const_iterator(impl_.constFind(value)); }
+	inline const_iterator lowerBound(const T &value) const { return const_iterator(impl_.lowerBound(value)); }
 	inline const_iterator constFind(const T &value) const { return const_iterator(impl_.constFind(value)); }
 	inline Self &unite(const Self &other) { impl_.unite(other.impl_); return *this; }
 
@@ -20,6 +20,8 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 */
 #pragma once
 
+#include "core/memory_pool.h"
+
 class RuntimeComposer;
 typedef void(*RuntimeComponentConstruct)(void *location, RuntimeComposer *composer);
 typedef void(*RuntimeComponentDestruct)(void *location);
@@ -153,7 +155,7 @@ public:
 			const RuntimeComposerMetadata *meta = GetRuntimeComposerMetadata(mask);
 			int size = sizeof(meta) + meta->size;
 
-			auto data = operator new(size);
+			auto data = MemoryPool::allocate(size, MemoryPool::Kind::Components);
 			t_assert(data != nullptr);
 
 			_data = data;
@@ -192,7 +194,7 @@ public:
 					RuntimeComponentWraps[i].Destruct(_dataptrunsafe(offset));
 				}
 			}
-			operator delete(_data);
+			MemoryPool::release(_data, sizeof(meta) + meta->size, MemoryPool::Kind::Components);
 		}
 	}
 
@@ -0,0 +1,97 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop version of Telegram messaging app, see https://telegram.org
+
+Telegram Desktop is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+In addition, as a special exception, the copyright holders give permission
+to link the code of portions of this program with the OpenSSL library.
+
+Full license: https://github.com/telegramdesktop/tdesktop/blob/master/LICENSE
+Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
+*/
+#pragma once
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QVector>
+#include "core/stl_subset.h"
+
+namespace base {
+
+// Bounded lock-free queue for exactly one producer thread and exactly one
+// consumer thread. Only the producer may call push(), only the consumer may
+// call pop() and front(), size() may be called from any thread.
+template <typename T>
+class spsc_queue {
+public:
+	explicit spsc_queue(int capacity) : _data(capacity + 1), _slots(_data.data()) {
+	}
+	spsc_queue(const spsc_queue &other) = delete;
+	spsc_queue &operator=(const spsc_queue &other) = delete;
+
+	int capacity() const {
+		return _data.size() - 1;
+	}
+	int size() const {
+		auto head = _head.loadAcquire();
+		auto tail = _tail.loadAcquire();
+		return (tail >= head) ? (tail - head) : (tail + _data.size() - head);
+	}
+	bool empty() const {
+		return _head.loadAcquire() == _tail.loadAcquire();
+	}
+	bool full() const {
+		return next(_tail.loadAcquire()) == _head.loadAcquire();
+	}
+
+	bool push(T &&value) {
+		auto tail = _tail.load();
+		auto after = next(tail);
+		if (after == _head.loadAcquire()) {
+			return false;
+		}
+		_slots[tail] = std_::move(value);
+		_tail.storeRelease(after);
+		return true;
+	}
+
+	T *front() {
+		auto head = _head.load();
+		if (head == _tail.loadAcquire()) {
+			return nullptr;
+		}
+		return &_slots[head];
+	}
+	bool pop(T &value) {
+		auto head = _head.load();
+		if (head == _tail.loadAcquire()) {
+			return false;
+		}
+		value = std_::move(_slots[head]);
+		_slots[head] = T();
+		_head.storeRelease(next(head));
+		return true;
+	}
+
+private:
+	int next(int index) const {
+		return (index + 1 < _data.size()) ? (index + 1) : 0;
+	}
+
+	// Slots are never reallocated, so both threads access them through a raw pointer.
+	QVector<T> _data;
+	T *_slots;
+	QAtomicInt _head = 0;
+	QAtomicInt _tail = 0;
+
+};
+
+} // namespace base
@@ -0,0 +1,115 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop version of Telegram messaging app, see https://telegram.org
+
+Telegram Desktop is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+In addition, as a special exception, the copyright holders give permission
+to link the code of portions of this program with the OpenSSL library.
+
+Full license: https://github.com/telegramdesktop/tdesktop/blob/master/LICENSE
+Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
+*/
+#include "stdafx.h"
+#include "core/startup_profiler.h"
+
+namespace StartupProfiler {
+namespace {
+
+struct PhaseData {
+	const char *name;
+	int thread;
+	int64 started; // microseconds from start()
+	int64 duration;
+};
+
+QElapsedTimer Timer;
+QAtomicInt Running = 0;
+QMutex PhasesMutex;
+QVector<PhaseData> Phases;
+QVector<Qt::HANDLE> Threads; // index in this vector is the thread id in the report
+
+int64 now() {
+	return Timer.nsecsElapsed() / 1000;
+}
+
+void exportPhases(const QVector<PhaseData> &phases, int64 total) {
+	QDir().mkdir(cWorkingDir() + qstr("DebugLogs"));
+	QFile f(cWorkingDir() + qsl("DebugLogs/startup_%1.json").arg(QDateTime::currentDateTime().toString(qsl("yyyyMMdd_hhmmss"))));
+	if (!f.open(QIODevice::WriteOnly)) {
+		LOG(("Startup Error: could not open '%1' for writing").arg(f.fileName()));
+		return;
+	}
+	QByteArray result = "{\"traceEvents\":[\n";
+	for_const (auto &phase, phases) {
+		result += QString("{\"name\":\"%1\",\"ph\":\"X\",\"pid\":1,\"tid\":%2,\"ts\":%3,\"dur\":%4},\n").arg(phase.name).arg(phase.thread).arg(phase.started).arg(phase.duration).toUtf8();
+	}
+	result += QString("{\"name\":\"finish\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%1}\n]}\n").arg(total).toUtf8();
+	f.write(result);
+}
+
+} // namespace
+
+void start() {
+	Timer.start();
+	{
+		QMutexLocker lock(&PhasesMutex);
+		Threads.push_back(QThread::currentThreadId()); // main thread has id 0
+	}
+	Running.storeRelease(1);
+}
+
+void finish() {
+	if (!Running.testAndSetOrdered(1, 0)) return;
+
+	auto total = now();
+	QVector<PhaseData> phases;
+	{
+		QMutexLocker lock(&PhasesMutex);
+		phases = base::take(Phases);
+		Threads.clear();
+	}
+	std::sort(phases.begin(), phases.end(), [](const PhaseData &a, const PhaseData &b) {
+		return a.started < b.started;
+	});
+
+	LOG(("Startup: finished in %1 ms").arg(total / 1000.));
+	for_const (auto &phase, phases) {
+		LOG(("Startup: %1 at %2 ms took %3 ms, thread %4").arg(phase.name).arg(phase.started / 1000.).arg(phase.duration / 1000.).arg(phase.thread));
+	}
+	if (cDebug()) {
+		exportPhases(phases, total);
+	}
+}
+
+bool running() {
+	return Running.loadAcquire() != 0;
+}
+
+Phase::Phase(const char *name) : _name(name), _started(running() ? now() : -1) {
+}
+
+Phase::~Phase() {
+	if (_started < 0 || !running()) return;
+
+	auto duration = now() - _started;
+	auto handle = QThread::currentThreadId();
+
+	QMutexLocker lock(&PhasesMutex);
+	auto thread = Threads.indexOf(handle);
+	if (thread < 0) {
+		thread = Threads.size();
+		Threads.push_back(handle);
+	}
+	Phases.push_back({ _name, thread, _started, duration });
+}
+
+} // namespace StartupProfiler
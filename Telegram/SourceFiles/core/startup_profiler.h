@@ -0,0 +1,46 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop version of Telegram messaging app, see https://telegram.org
+
+Telegram Desktop is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+In addition, as a special exception, the copyright holders give permission
+to link the code of portions of this program with the OpenSSL library.
+
+Full license: https://github.com/telegramdesktop/tdesktop/blob/master/LICENSE
+Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
+*/
+#pragma once
+
+namespace StartupProfiler {
+
+// Startup phases are timed from start() to finish(), which is called
+// when the dialogs list is painted for the first time or when the intro
+// or the passcode is shown instead of it. On finish the
+// phases are written to the log and, in debug mode, exported to
+// DebugLogs/startup_*.json in the chrome://tracing format.
+void start();
+void finish();
+bool running();
+
+// Measures a phase in its lifetime, can be used from any thread.
+class Phase {
+public:
+	Phase(const char *name);
+	~Phase();
+
+private:
+	const char *_name;
+	int64 _started;
+
+};
+
+} // namespace StartupProfiler
@@ -0,0 +1,129 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop version of Telegram messaging app, see https://telegram.org
+
+Telegram Desktop is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+In addition, as a special exception, the copyright holders give permission
+to link the code of portions of this program with the OpenSSL library.
+
+Full license: https://github.com/telegramdesktop/tdesktop/blob/master/LICENSE
+Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
+*/
+#include "stdafx.h"
+#include "data/data_mention_index.h"
+
+namespace Data {
+namespace {
+
+// Name parts do not contain the username as a whole, "some_user" is split
+// in "some" and "user" there, so the lowercase username is indexed as well.
+PeerData::Names indexedNames(UserData *user) {
+	auto result = user->names;
+	if (!user->username.isEmpty()) {
+		result.insert(user->username.toLower());
+	}
+	return result;
+}
+
+} // namespace
+
+void MentionIndex::clear() {
+	_users.clear();
+	_byName.clear();
+	_byRank.clear();
+}
+
+void MentionIndex::add(UserData *user, int32 rank) {
+	if (_users.contains(user)) {
+		updateRank(user, rank);
+		return;
+	}
+	auto &entry = _users[user];
+	entry.rank = rank;
+	entry.names = indexedNames(user);
+	for_const (auto &name, entry.names) {
+		_byName.insert(NameKey(name, user));
+	}
+	_byRank.insert(RankKey(rank, user));
+}
+
+void MentionIndex::remove(UserData *user) {
+	auto i = _users.find(user);
+	if (i == _users.end()) {
+		return;
+	}
+	for_const (auto &name, i->names) {
+		_byName.remove(NameKey(name, user));
+	}
+	_byRank.remove(RankKey(i->rank, user));
+	_users.erase(i);
+}
+
+void MentionIndex::updateRank(UserData *user, int32 rank) {
+	auto i = _users.find(user);
+	if (i == _users.end() || i->rank == rank) {
+		return;
+	}
+	_byRank.remove(RankKey(i->rank, user));
+	i->rank = rank;
+	_byRank.insert(RankKey(rank, user));
+}
+
+void MentionIndex::updateNames(UserData *user) {
+	auto i = _users.find(user);
+	if (i == _users.end()) {
+		return;
+	}
+	auto names = indexedNames(user);
+	for_const (auto &name, i->names) {
+		if (!names.contains(name)) {
+			_byName.remove(NameKey(name, user));
+		}
+	}
+	for_const (auto &name, names) {
+		if (!i->names.contains(name)) {
+			_byName.insert(NameKey(name, user));
+		}
+	}
+	i->names = names;
+}
+
+QList<UserData*> MentionIndex::find(const QString &prefix) const {
+	QList<UserData*> result;
+	if (prefix.isEmpty()) {
+		result.reserve(_byRank.size());
+		for (auto i = _byRank.cend(), b = _byRank.cbegin(); i != b;) {
+			--i;
+			result.push_back(i->second);
+		}
+		return result;
+	}
+
+	// indexed names are lowercase, one user can be found by several of them
+	auto key = prefix.toLower();
+	QVector<RankKey> found;
+	for (auto i = _byName.lowerBound(NameKey(key, nullptr)), e = _byName.cend(); i != e && i->first.startsWith(key); ++i) {
+		found.push_back(RankKey(_users.constFind(i->second)->rank, i->second));
+	}
+	std::sort(found.begin(), found.end(), [](const RankKey &a, const RankKey &b) {
+		return b < a;
+	});
+	found.erase(std::unique(found.begin(), found.end()), found.end());
+
+	result.reserve(found.size());
+	for_const (auto &key, found) {
+		result.push_back(key.second);
+	}
+	return result;
+}
+
+} // namespace Data
@@ -0,0 +1,62 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop version of Telegram messaging app, see https://telegram.org
+
+Telegram Desktop is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+In addition, as a special exception, the copyright holders give permission
+to link the code of portions of this program with the OpenSSL library.
+
+Full license: https://github.com/telegramdesktop/tdesktop/blob/master/LICENSE
+Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
+*/
+#pragma once
+
+namespace Data {
+
+// Users indexed by the parts of their names and by their usernames for the mention autocomplete.
+// Each user has a rank, found users are ordered by it from the highest one.
+class MentionIndex {
+public:
+	bool contains(UserData *user) const {
+		return _users.contains(user);
+	}
+	int size() const {
+		return _users.size();
+	}
+	QList<UserData*> users() const {
+		return _users.keys();
+	}
+	void clear();
+
+	void add(UserData *user, int32 rank); // only updates the rank if already added
+	void remove(UserData *user);
+	void updateRank(UserData *user, int32 rank);
+	void updateNames(UserData *user); // call after user->names or user->username were changed
+
+	// All users for an empty prefix.
+	QList<UserData*> find(const QString &prefix) const;
+
+private:
+	struct Entry {
+		int32 rank = 0;
+		PeerData::Names names; // indexed names, user names can already be different
+	};
+	using NameKey = QPair<QString, UserData*>;
+	using RankKey = QPair<int32, UserData*>;
+
+	QMap<UserData*, Entry> _users;
+	OrderedSet<NameKey> _byName;
+	OrderedSet<RankKey> _byRank;
+
+};
+
+} // namespace Data
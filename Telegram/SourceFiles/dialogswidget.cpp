@@ -27,6 +27,7 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 #include "ui/buttons/round_button.h"
 #include "ui/popupmenu.h"
 #include "data/data_drafts.h"
+#include "core/startup_profiler.h"
 #include "lang.h"
 #include "application.h"
 #include "mainwindow.h"
@@ -102,6 +103,9 @@ void DialogsInner::paintRegion(Painter &p, const QRegion &region, bool paintingO
 		PeerData *active = App::main()->activePeer(), *selected = _menuPeer ? _menuPeer : (_sel ? _sel->history()->peer : 0);
 		if (otherStart) {
 			shownDialogs()->all().paint(p, fullWidth(), dialogsClip.top(), dialogsClip.top() + dialogsClip.height(), active, selected, paintingOther);
+			if (!paintingOther) {
+				StartupProfiler::finish();
+			}
 		}
 		if (!otherStart) {
 			p.fillRect(dialogsClip, st::white);
@@ -313,7 +317,7 @@ void DialogsInner::searchInPeerPaint(Painter &p, int32 w, bool onlyBackground) c
 	p.drawText(tr.left(), tr.top() + st::dialogsTextFont->ascent, st::dialogsTextFont->elided(lang((_searchInPeer->isChannel() && !_searchInPeer->isMegagroup()) ? lng_dlg_search_channel : lng_dlg_search_chat), tr.width()));
 
 	p.setPen(st::dialogsNameFg);
-	_searchInPeer->nameText.drawElided(p, rectForName.left(), rectForName.top(), rectForName.width());
+	_searchInPeer->nameText().drawElided(p, rectForName.left(), rectForName.top(), rectForName.width());
 }
 
 void DialogsInner::activate() {
@@ -1754,6 +1758,15 @@ DialogsInner::SearchResults &DialogsInner::searchList() {
 	return _searchResults;
 }
 
+bool DialogsInner::hasSearchResult(HistoryItem *item) const {
+	for_const (auto result, _searchResults) {
+		if (result->item() == item) {
+			return true;
+		}
+	}
+	return false;
+}
+
 int32 DialogsInner::lastSearchDate() const {
 	return _lastSearchDate;
 }
@@ -2390,6 +2403,10 @@ void DialogsWidget::onFilterUpdate(bool force) {
 	}
 }
 
+bool DialogsWidget::hasSearchResult(HistoryItem *item) const {
+	return _inner.hasSearchResult(item);
+}
+
 void DialogsWidget::searchInPeer(PeerData *peer) {
 	onCancelSearch();
 	_searchInPeer = peer ? (peer->migrateTo() ? peer->migrateTo() : peer) : 0;
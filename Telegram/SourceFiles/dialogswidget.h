@@ -98,6 +98,7 @@ public:
 	FilteredDialogs &filteredList();
 	PeopleResults &peopleList();
 	SearchResults &searchList();
+	bool hasSearchResult(HistoryItem *item) const;
 	int32 lastSearchDate() const;
 	PeerData *lastSearchPeer() const;
 	MsgId lastSearchId() const;
@@ -264,6 +265,8 @@ public:
 
 	void dialogsToUp();
 
+	bool hasSearchResult(HistoryItem *item) const;
+
 	bool hasTopBarShadow() const {
 		return true;
 	}
@@ -594,6 +594,7 @@ struct Data {
 	bool ScreenIsLocked = false;
 
 	int32 DebugLoggingFlags = 0;
+	bool HistoryTilesEnabled = false;
 
 	float64 RememberedSongVolume = kDefaultVolume;
 	float64 SongVolume = kDefaultVolume;
@@ -638,6 +639,9 @@ struct Data {
 
 	base::Observable<void> SelfChanged;
 
+	int64 LocalStorageLimit = 0;
+	int64 MessagesMemoryLimit = 64 * 1024 * 1024;
+
 	bool AskDownloadPath = false;
 	QString DownloadPath;
 	QByteArray DownloadPathBookmark;
@@ -709,6 +713,7 @@ DefineVar(Global, bool, ModerateModeEnabled);
 DefineVar(Global, bool, ScreenIsLocked);
 
 DefineVar(Global, int32, DebugLoggingFlags);
+DefineVar(Global, bool, HistoryTilesEnabled);
 
 DefineVar(Global, float64, RememberedSongVolume);
 DefineVar(Global, float64, SongVolume);
@@ -753,6 +758,9 @@ DefineRefVar(Global, CircleMasksMap, CircleMasks);
 
 DefineRefVar(Global, base::Observable<void>, SelfChanged);
 
+DefineVar(Global, int64, LocalStorageLimit);
+DefineVar(Global, int64, MessagesMemoryLimit);
+
 DefineVar(Global, bool, AskDownloadPath);
 DefineVar(Global, QString, DownloadPath);
 DefineVar(Global, QByteArray, DownloadPathBookmark);
@@ -212,6 +212,7 @@ enum Layout {
 namespace DebugLogging {
 enum Flags {
 	FileLoaderFlag = 0x00000001,
+	TraceFlag = 0x00000002,
 };
 } // namespace DebugLogging
 
@@ -278,6 +279,7 @@ DeclareVar(bool, ModerateModeEnabled);
 DeclareVar(bool, ScreenIsLocked);
 
 DeclareVar(int32, DebugLoggingFlags);
+DeclareVar(bool, HistoryTilesEnabled);
 
 constexpr float64 kDefaultVolume = 0.9;
 
@@ -327,6 +329,9 @@ DeclareRefVar(CircleMasksMap, CircleMasks);
 
 DeclareRefVar(base::Observable<void>, SelfChanged);
 
+DeclareVar(int64, LocalStorageLimit);
+DeclareVar(int64, MessagesMemoryLimit);
+
 DeclareVar(bool, AskDownloadPath);
 DeclareVar(QString, DownloadPath);
 DeclareVar(QByteArray, DownloadPathBookmark);
@@ -382,4 +387,9 @@ inline bool FileLoader() {
 	return (Global::DebugLoggingFlags() & FileLoaderFlag) != 0;
 }
 
+// Checked from the mtproto threads as well.
+inline bool Trace() {
+	return Global::started() && (Global::DebugLoggingFlags() & TraceFlag) != 0;
+}
+
 } // namespace DebugLogging
@@ -191,6 +191,7 @@ void FileUploader::sendNext() {
 		} else {
 			requestId = MTP::send(MTPupload_SaveFilePart(MTP_long(i->id()), MTP_int(i->docSentParts), MTP_bytes(toSend)), rpcDone(&FileUploader::partLoaded), rpcFail(&FileUploader::partFailed), MTP::uplDcId(todc));
 		}
+		TRACE_LOG(FileUploadPartSent, MTP::uplDcId(todc), requestId, i->docSentParts, toSend.size());
 		docRequestsSent.insert(requestId, i->docSentParts);
 		dcMap.insert(requestId, todc);
 		sentSize += i->docPartSize;
@@ -201,6 +202,7 @@ void FileUploader::sendNext() {
 		UploadFileParts::iterator part = parts.begin();
 
 		mtpRequestId requestId = MTP::send(MTPupload_SaveFilePart(MTP_long(partsOfId), MTP_int(part.key()), MTP_bytes(part.value())), rpcDone(&FileUploader::partLoaded), rpcFail(&FileUploader::partFailed), MTP::uplDcId(todc));
+		TRACE_LOG(FileUploadPartSent, MTP::uplDcId(todc), requestId, part.key(), part.value().size());
 		requestsSent.insert(requestId, part.value());
 		dcMap.insert(requestId, todc);
 		sentSize += part.value().size();
@@ -282,6 +284,7 @@ void FileUploader::partLoaded(const MTPBool &result, mtpRequestId requestId) {
 			}
 			sentSize -= sentPartSize;
 			sentSizes[dc] -= sentPartSize;
+			TRACE_LOG(FileUploadPartDone, MTP::uplDcId(dc), requestId, 0, sentPartSize);
 			if (k->type() == PreparePhoto) {
 				k->fileSentSize += sentPartSize;
 				PhotoData *photo = App::photo(k->id());
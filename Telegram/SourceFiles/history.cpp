@@ -1036,6 +1036,7 @@ HistoryItem *History::addNewItem(HistoryItem *adding, bool newMsg) {
 	setLastMessage(adding);
 	if (newMsg) {
 		newItemAdded(adding);
+		if (App::main()) App::main()->checkHistoryMemory();
 	}
 
 	adding->addToOverview(AddToOverviewNew);
@@ -1167,7 +1168,8 @@ HistoryBlock *History::prepareBlockForAddingItem() {
 		return result;
 	}
 
-	bool addNewBlock = blocks.isEmpty() || (blocks.back()->items.size() >= MessagesPerPage);
+	// The messages loaded again after the unloaded ones go to new blocks after the edge.
+	bool addNewBlock = blocks.isEmpty() || (blocks.back()->items.size() >= MessagesPerPage) || (blocks.back() == _unloadedBelow.edge);
 	if (!addNewBlock) {
 		return blocks.back();
 	}
@@ -1202,6 +1204,7 @@ void History::addOlderSlice(const QVector<MTPMessage> &slice) {
 			asChannelHistory()->checkJoinedMessage();
 			asChannelHistory()->checkMaxReadMessageDate();
 		}
+		checkUnloadedRanges();
 		return;
 	}
 
@@ -1301,6 +1304,8 @@ void History::addOlderSlice(const QVector<MTPMessage> &slice) {
 		asChannelHistory()->checkMaxReadMessageDate();
 	}
 	checkLastMsg();
+	checkUnloadedRanges();
+	if (App::main()) App::main()->checkHistoryMemory();
 }
 
 void History::addNewerSlice(const QVector<MTPMessage> &slice) {
@@ -1337,6 +1342,8 @@ void History::addNewerSlice(const QVector<MTPMessage> &slice) {
 
 	if (isChannel()) asChannelHistory()->checkJoinedMessage();
 	checkLastMsg();
+	checkUnloadedRanges();
+	if (App::main()) App::main()->checkHistoryMemory();
 }
 
 void History::checkLastMsg() {
@@ -1350,6 +1357,17 @@ void History::checkLastMsg() {
 	}
 }
 
+void History::checkUnloadedRanges() {
+	if (oldLoaded && _unloadedAbove.edge) {
+		_unloadedAbove = UnloadedRange();
+		setHasPendingResizedItems();
+	}
+	if (newLoaded && _unloadedBelow.edge) {
+		_unloadedBelow = UnloadedRange();
+		setHasPendingResizedItems();
+	}
+}
+
 void History::checkAddAllToOverview() {
 	if (!loadedAtBottom()) {
 		return;
@@ -1857,15 +1875,45 @@ int History::resizeGetHeight(int newWidth) {
 	_flags &= ~(Flag::f_pending_resize | Flag::f_has_pending_resized_items);
 
 	width = newWidth;
-	int y = 0;
+	for_const (HistoryBlock *block, blocks) {
+		block->resizeGetHeight(newWidth, resizeAllItems);
+	}
+
+	// The blocks loaded again around the kept ones fill the space left for them.
+	_unloadedAbove.height = _unloadedAbove.fullHeight;
+	if (_unloadedAbove.edge) {
+		for (int i = 0, l = blocks.size(); i < l && blocks.at(i) != _unloadedAbove.edge; ++i) {
+			_unloadedAbove.height -= blocks.at(i)->height;
+		}
+		accumulate_max(_unloadedAbove.height, 0);
+	}
+	_unloadedBelow.height = _unloadedBelow.fullHeight;
+	if (_unloadedBelow.edge) {
+		for (int i = blocks.size(); i > 0 && blocks.at(i - 1) != _unloadedBelow.edge; --i) {
+			_unloadedBelow.height -= blocks.at(i - 1)->height;
+		}
+		accumulate_max(_unloadedBelow.height, 0);
+	}
+
+	int y = _unloadedAbove.height;
 	for_const (HistoryBlock *block, blocks) {
 		block->y = y;
-		y += block->resizeGetHeight(newWidth, resizeAllItems);
+		y += block->height;
 	}
-	height = y;
+	height = y + _unloadedBelow.height;
 	return height;
 }
 
+int64 History::textMemorySize() const {
+	int64 result = 0;
+	for_const (HistoryBlock *block, blocks) {
+		for_const (HistoryItem *item, block->items) {
+			result += item->textMemorySize();
+		}
+	}
+	return result;
+}
+
 ChannelHistory *History::asChannelHistory() {
 	return isChannel() ? static_cast<ChannelHistory*>(this) : 0;
 }
@@ -1945,6 +1993,8 @@ void History::clear(bool leaveItems) {
 }
 
 void History::clearBlocks(bool leaveItems) {
+	_unloadedAbove = _unloadedBelow = UnloadedRange();
+
 	Blocks lst;
 	std::swap(lst, blocks);
 	for_const (HistoryBlock *block, lst) {
@@ -1955,6 +2005,121 @@ void History::clearBlocks(bool leaveItems) {
 	}
 }
 
+int History::unloadFarBlocks(int keepItems) {
+	if (blocks.size() < 2 || isBuildingFrontBlock()) {
+		return 0;
+	}
+
+	// Keep keepItems messages on both sides of the block with the
+	// remembered scroll position or of the last block.
+	int anchor = blocks.size() - 1;
+	if (scrollTopItem && !scrollTopItem->detached()) {
+		anchor = scrollTopItem->block()->indexInHistory();
+	}
+	int from = anchor, till = anchor + 1;
+	for (int kept = 0; from > 0 && kept < keepItems;) {
+		kept += blocks.at(--from)->items.size();
+	}
+	for (int kept = 0; till < blocks.size() && kept < keepItems;) {
+		kept += blocks.at(till++)->items.size();
+	}
+	if (from == 0 && till == blocks.size()) {
+		return 0;
+	}
+
+	auto unloading = [from, till](HistoryItem *item) {
+		if (!item || item->detached()) return false;
+		int index = item->block()->indexInHistory();
+		return (index < from || index >= till);
+	};
+	if (unloading(unreadBar)) {
+		destroyUnreadBar();
+	}
+	bool showFromUnloaded = unloading(showFrom);
+	if (showFromUnloaded) {
+		showFrom = nullptr;
+	}
+	if (unloading(lastSentMsg)) {
+		lastSentMsg = nullptr;
+	}
+
+	// Leave the space of the unloaded blocks so that the scroll position is kept.
+	if (from > 0) {
+		oldLoaded = false;
+		_unloadedAbove.edge = blocks.at(from);
+		_unloadedAbove.fullHeight = _unloadedAbove.height;
+		for (int i = 0; i < from; ++i) {
+			_unloadedAbove.fullHeight += blocks.at(i)->height;
+		}
+	}
+	if (till < blocks.size()) {
+		newLoaded = false;
+		_unloadedBelow.edge = blocks.at(till - 1);
+		_unloadedBelow.fullHeight = _unloadedBelow.height;
+		for (int i = till, l = blocks.size(); i < l; ++i) {
+			_unloadedBelow.fullHeight += blocks.at(i)->height;
+		}
+	}
+	Blocks unloaded = blocks.mid(0, from) + blocks.mid(till);
+	blocks = blocks.mid(from, till - from);
+	for (int i = 0, l = blocks.size(); i < l; ++i) {
+		blocks.at(i)->setIndexInHistory(i);
+	}
+
+	int result = 0;
+	auto &pending = Global::RefPendingRepaintItems();
+
+	// Destroy the newest messages first, so that the replies are destroyed
+	// before the messages they are replying to and do not hold them.
+	for (int i = unloaded.size(); i > 0;) {
+		HistoryBlock *block = unloaded.at(--i);
+		HistoryBlock::Items items;
+		std::swap(items, block->items);
+		for (int j = items.size(); j > 0;) {
+			HistoryItem *item = items.at(--j);
+			bool destroy = canUnloadItem(item);
+			if (isChannel()) {
+				asChannelHistory()->messageDetached(item);
+			}
+			item->detachFast();
+			if (!destroy) continue;
+
+			pending.remove(item);
+			delete item;
+			++result;
+		}
+		delete block;
+	}
+
+	if (showFromUnloaded) {
+		updateShowFrom();
+	}
+	blocks.front()->items.front()->previousItemChanged();
+	setHasPendingResizedItems();
+	return result;
+}
+
+bool History::canUnloadItem(HistoryItem *item) const {
+	if (item == lastMsg || notifies.contains(item)) {
+		return false;
+	}
+	if (item->id < 0) { // sending messages, the joined message is created again
+		return isChannel() && (asChannelHistory()->_joinedMessage == item);
+	}
+	if (!item->out() && item->id >= inboxReadBefore) { // unread, may be in a notification
+		return false;
+	}
+	if (App::historyItemHasDependents(item)) {
+		return false;
+	}
+	for (int32 t = 0; t < OverviewCount; ++t) { // shared media shows the overview items
+		if (overviewIds[t].contains(item->id)) {
+			return false;
+		}
+	}
+	return !App::main() || !App::main()->isItemReferenced(item);
+}
+
 void History::clearOnDestroy() {
 	clearBlocks(false);
 }
@@ -2109,6 +2274,20 @@ void History::removeBlock(HistoryBlock *block) {
 	for (int i = index, l = blocks.size(); i < l; ++i) {
 		blocks.at(i)->setIndexInHistory(i);
 	}
+	if (block == _unloadedAbove.edge) {
+		if (index < blocks.size()) {
+			_unloadedAbove.edge = blocks.at(index);
+		} else {
+			_unloadedAbove = UnloadedRange();
+		}
+	}
+	if (block == _unloadedBelow.edge) {
+		if (index > 0) {
+			_unloadedBelow.edge = blocks.at(index - 1);
+		} else {
+			_unloadedBelow = UnloadedRange();
+		}
+	}
 	if (index < blocks.size()) {
 		blocks.at(index)->items.front()->previousItemChanged();
 	}
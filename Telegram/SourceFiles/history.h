@@ -42,6 +42,7 @@ public:
 	Map map;
 
 	Histories() : _a_typings(animation(this, &Histories::step_typings)), _unreadFull(0), _unreadMuted(0) {
+		_a_typings.setFrameInterval(TypingDotsFrameInterval);
 	}
 
 	void regSendAction(History *history, UserData *user, const MTPSendMessageAction &action, TimeId when);
@@ -198,6 +199,23 @@ public:
 
 	void clear(bool leaveItems = false);
 
+	// Unloads the blocks that are farther than keepItems messages from the remembered
+	// scroll position, they are requested from the server again when scrolled to.
+	// Their height is kept as an empty space above / below the loaded blocks.
+	// Returns the count of destroyed messages.
+	int unloadFarBlocks(int keepItems);
+
+	// Heights of the empty space left for the unloaded messages, counted in resizeGetHeight().
+	int unloadedHeightAbove() const {
+		return _unloadedAbove.height;
+	}
+	int unloadedHeightBelow() const {
+		return _unloadedBelow.height;
+	}
+
+	// Estimated heap bytes held by the texts of the loaded messages.
+	int64 textMemorySize() const;
+
 	virtual ~History();
 
 	HistoryItem *addNewService(MsgId msgId, QDateTime date, const QString &text, MTPDmessage::Flags flags = 0, bool newMsg = true);
@@ -461,6 +479,9 @@ protected:
 
 	void clearBlocks(bool leaveItems);
 
+	// Referenced messages are only detached when their block is unloaded.
+	bool canUnloadItem(HistoryItem *item) const;
+
 	HistoryItem *createItem(const MTPMessage &msg, bool applyServiceAction, bool detachExistingItem);
 	HistoryItem *createItemForwarded(MsgId id, MTPDmessage::Flags flags, QDateTime date, int32 from, HistoryMessage *msg);
 	HistoryItem *createItemDocument(MsgId id, MTPDmessage::Flags flags, int32 viaBotId, MsgId replyTo, QDateTime date, int32 from, DocumentData *doc, const QString &caption, const MTPReplyMarkup &markup);
@@ -494,6 +515,9 @@ private:
 	// Add all items to the media overview if we were not loaded at bottom and now are.
 	void checkAddAllToOverview();
 
+	// Forget the unloaded ranges that were loaded back completely.
+	void checkUnloadedRanges();
+
 	enum class Flag {
 		f_has_pending_resized_items = (1 << 0),
 		f_pending_resize            = (1 << 1),
@@ -539,6 +563,16 @@ private:
 	};
 	std_::unique_ptr<BuildingBlock> _buildingFrontBlock;
 
+	// Space left for the messages unloaded by unloadFarBlocks(). The edge is the
+	// first (last) block that was kept, the blocks loaded again before (after) it
+	// take their height from the space until it is used up.
+	struct UnloadedRange {
+		HistoryBlock *edge = nullptr;
+		int fullHeight = 0;
+		int height = 0;
+	};
+	UnloadedRange _unloadedAbove, _unloadedBelow;
+
 	// Creates if necessary a new block for adding item.
 	// Depending on isBuildingFrontBlock() gets front or back block.
 	HistoryBlock *prepareBlockForAddingItem();
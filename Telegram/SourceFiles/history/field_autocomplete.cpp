@@ -24,6 +24,8 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 #include "mainwindow.h"
 #include "apiwrap.h"
 #include "localstorage.h"
+#include "observer_peer.h"
+#include "stickers/stickers.h"
 
 FieldAutocomplete::FieldAutocomplete(QWidget *parent) : TWidget(parent)
 , _scroll(this, st::mentionScroll)
@@ -51,6 +53,14 @@ FieldAutocomplete::FieldAutocomplete(QWidget *parent) : TWidget(parent)
 	_inner->show();
 
 	connect(_scroll, SIGNAL(geometryChanged()), _inner, SLOT(onParentGeometryChanged()));
+
+	auto observeEvents = Notify::PeerUpdate::Flag::MembersChanged
+		| Notify::PeerUpdate::Flag::NameChanged
+		| Notify::PeerUpdate::Flag::UsernameChanged
+		| Notify::PeerUpdate::Flag::UserOnlineChanged;
+	subscribe(Notify::PeerUpdated(), Notify::PeerUpdatedHandler(observeEvents, [this](const Notify::PeerUpdate &update) {
+		mentionIndexPeerUpdated(update);
+	}));
 }
 
 void FieldAutocomplete::paintEvent(QPaintEvent *e) {
@@ -126,16 +136,72 @@ bool FieldAutocomplete::clearFilteredBotCommands() {
 	return true;
 }
 
-namespace {
-template <typename T, typename U>
-inline int indexOfInFirstN(const T &v, const U &elem, int last) {
-	for (auto b = v.cbegin(), i = b, e = b + qMax(v.size(), last); i != e; ++i) {
-		if (*i == elem) {
-			return (i - b);
+void FieldAutocomplete::refreshMentionIndex(TimeId now) {
+	auto peer = _chat ? static_cast<PeerData*>(_chat) : static_cast<PeerData*>(_channel);
+	if (_mentionIndexPeer != peer) {
+		_mentionIndex.clear();
+		_mentionIndexPeer = peer;
+		_mentionIndexOutdated = true;
+	}
+
+	// ranks of the users that were online long ago depend on the current date
+	auto today = date(now).date();
+	if (_mentionIndexRanksDate != today) {
+		_mentionIndexRanksDate = today;
+		_mentionIndexOutdated = true;
+	}
+
+	if (_chat) {
+		if (!_mentionIndexOutdated && _mentionIndex.size() == _chat->participants.size()) {
+			return;
+		}
+		for_const (auto user, _mentionIndex.users()) {
+			if (!_chat->participants.contains(user)) {
+				_mentionIndex.remove(user);
+			}
+		}
+		for (auto i = _chat->participants.cbegin(), e = _chat->participants.cend(); i != e; ++i) {
+			_mentionIndex.add(i.key(), App::onlineForSort(i.key(), now));
+		}
+	} else if (_channel && _channel->isMegagroup()) {
+		auto &participants = _channel->mgInfo->lastParticipants;
+		if (!_mentionIndexOutdated && _mentionIndex.size() == participants.size()) {
+			return;
+		}
+		OrderedSet<UserData*> current;
+		for_const (auto user, participants) {
+			current.insert(user);
+		}
+		for_const (auto user, _mentionIndex.users()) {
+			if (!current.contains(user)) {
+				_mentionIndex.remove(user);
+			}
+		}
+
+		// recent participants are shown in the order they are received
+		int rank = 0;
+		for_const (auto user, participants) {
+			_mentionIndex.add(user, --rank);
 		}
 	}
-	return -1;
+	_mentionIndexOutdated = false;
 }
+
+void FieldAutocomplete::mentionIndexPeerUpdated(const Notify::PeerUpdate &update) {
+	if (update.peer == _mentionIndexPeer) {
+		if (update.flags & Notify::PeerUpdate::Flag::MembersChanged) {
+			_mentionIndexOutdated = true;
+		}
+	} else if (auto user = update.peer->asUser()) {
+		if (!_mentionIndex.contains(user)) return;
+
+		if (update.flags & (Notify::PeerUpdate::Flag::NameChanged | Notify::PeerUpdate::Flag::UsernameChanged)) {
+			_mentionIndex.updateNames(user);
+		}
+		if (_mentionIndexPeer && _mentionIndexPeer->isChat() && (update.flags & Notify::PeerUpdate::Flag::UserOnlineChanged)) {
+			_mentionIndex.updateRank(user, App::onlineForSort(user, unixtime()));
+		}
+	}
 }
 
 void FieldAutocomplete::updateFiltered(bool resetScroll) {
@@ -145,29 +211,7 @@ void FieldAutocomplete::updateFiltered(bool resetScroll) {
 	internal::BotCommandRows brows;
 	StickerPack srows;
 	if (_emoji) {
-		QMap<uint64, uint64> setsToRequest;
-		auto &sets = Global::RefStickerSets();
-		auto &order = Global::StickerSetsOrder();
-		for (int i = 0, l = order.size(); i < l; ++i) {
-			auto it = sets.find(order.at(i));
-			if (it != sets.cend()) {
-				if (it->emoji.isEmpty()) {
-					setsToRequest.insert(it->id, it->access);
-					it->flags |= MTPDstickerSet_ClientFlag::f_not_loaded;
-				} else if (!(it->flags & MTPDstickerSet::Flag::f_archived)) {
-					StickersByEmojiMap::const_iterator i = it->emoji.constFind(emojiGetNoColor(_emoji));
-					if (i != it->emoji.cend()) {
-						srows += *i;
-					}
-				}
-			}
-		}
-		if (!setsToRequest.isEmpty() && App::api()) {
-			for (QMap<uint64, uint64>::const_iterator i = setsToRequest.cbegin(), e = setsToRequest.cend(); i != e; ++i) {
-				App::api()->scheduleStickerSetRequest(i.key(), i.value());
-			}
-			App::api()->requestStickerSets();
-		}
+		srows = Stickers::getStickersByEmoji(_emoji);
 	} else if (_type == Type::Mentions) {
 		int maxListSize = _addInlineBots ? cRecentInlineBots().size() : 0;
 		if (_chat) {
@@ -199,52 +243,42 @@ void FieldAutocomplete::updateFiltered(bool resetScroll) {
 			return filterNotPassedByUsername(user);
 		};
 
+		// the index finds users both by their names and usernames, only skip the exact username match here
 		bool listAllSuggestions = _filter.isEmpty();
+		OrderedSet<UserData*> added;
+		auto addFromIndex = [this, listAllSuggestions, &mrows, &added] {
+			for_const (auto user, _mentionIndex.find(_filter)) {
+				if (!listAllSuggestions && user->username.compare(_filter, Qt::CaseInsensitive) == 0) continue;
+				if (added.contains(user)) continue;
+				mrows.push_back(user);
+			}
+		};
 		if (_addInlineBots) {
 			for_const (auto user, cRecentInlineBots()) {
 				if (!listAllSuggestions && filterNotPassedByUsername(user)) continue;
 				mrows.push_back(user);
+				added.insert(user);
 				++recentInlineBots;
 			}
 		}
 		if (_chat) {
-			QMultiMap<int32, UserData*> ordered;
-			mrows.reserve(mrows.size() + (_chat->participants.isEmpty() ? _chat->lastAuthors.size() : _chat->participants.size()));
 			if (_chat->noParticipantInfo()) {
 				if (App::api()) App::api()->requestFullPeer(_chat);
-			} else if (!_chat->participants.isEmpty()) {
-				for (auto i = _chat->participants.cbegin(), e = _chat->participants.cend(); i != e; ++i) {
-					UserData *user = i.key();
-					if (!listAllSuggestions && filterNotPassedByName(user)) continue;
-					if (indexOfInFirstN(mrows, user, recentInlineBots) >= 0) continue;
-					ordered.insertMulti(App::onlineForSort(user, now), user);
-				}
 			}
 			for_const (auto user, _chat->lastAuthors) {
 				if (!listAllSuggestions && filterNotPassedByName(user)) continue;
-				if (indexOfInFirstN(mrows, user, recentInlineBots) >= 0) continue;
+				if (added.contains(user)) continue;
 				mrows.push_back(user);
-				if (!ordered.isEmpty()) {
-					ordered.remove(App::onlineForSort(user, now), user);
-				}
-			}
-			if (!ordered.isEmpty()) {
-				for (QMultiMap<int32, UserData*>::const_iterator i = ordered.cend(), b = ordered.cbegin(); i != b;) {
-					--i;
-					mrows.push_back(i.value());
-				}
+				added.insert(user);
 			}
+			refreshMentionIndex(now);
+			addFromIndex();
 		} else if (_channel && _channel->isMegagroup()) {
-			QMultiMap<int32, UserData*> ordered;
 			if (_channel->mgInfo->lastParticipants.isEmpty() || _channel->lastParticipantsCountOutdated()) {
 				if (App::api()) App::api()->requestLastParticipants(_channel);
 			} else {
-				mrows.reserve(mrows.size() + _channel->mgInfo->lastParticipants.size());
-				for_const (auto user, _channel->mgInfo->lastParticipants) {
-					if (!listAllSuggestions && filterNotPassedByName(user)) continue;
-					if (indexOfInFirstN(mrows, user, recentInlineBots) >= 0) continue;
-					mrows.push_back(user);
-				}
+				refreshMentionIndex(now);
+				addFromIndex();
 			}
 		}
 	} else if (_type == Type::Hashtags) {
@@ -610,7 +644,7 @@ void FieldAutocompleteInner::paintEvent(QPaintEvent *e) {
 				UserData *user = _mrows->at(i);
 				QString first = (!filterIsEmpty && user->username.startsWith(filter, Qt::CaseInsensitive)) ? ('@' + user->username.mid(0, filterSize)) : QString();
 				QString second = first.isEmpty() ? (user->username.isEmpty() ? QString() : ('@' + user->username)) : user->username.mid(filterSize);
-				int32 firstwidth = st::mentionFont->width(first), secondwidth = st::mentionFont->width(second), unamewidth = firstwidth + secondwidth, namewidth = user->nameText.maxWidth();
+				int32 firstwidth = st::mentionFont->width(first), secondwidth = st::mentionFont->width(second), unamewidth = firstwidth + secondwidth, namewidth = user->nameText().maxWidth();
 				if (mentionwidth < unamewidth + namewidth) {
 					namewidth = (mentionwidth * namewidth) / (namewidth + unamewidth);
 					unamewidth = mentionwidth - namewidth;
@@ -627,7 +661,7 @@ void FieldAutocompleteInner::paintEvent(QPaintEvent *e) {
 				}
 				user->loadUserpic();
 				user->paintUserpicLeft(p, st::mentionPhotoSize, st::mentionPadding.left(), i * st::mentionHeight + st::mentionPadding.top(), width());
-				user->nameText.drawElided(p, 2 * st::mentionPadding.left() + st::mentionPhotoSize, i * st::mentionHeight + st::mentionTop, namewidth);
+				user->nameText().drawElided(p, 2 * st::mentionPadding.left() + st::mentionPhotoSize, i * st::mentionHeight + st::mentionTop, namewidth);
 
 				p.setFont(st::mentionFont->f);
 				p.setPen((selected ? st::mentionFgOverActive : st::mentionFgActive)->p);
@@ -22,6 +22,11 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 
 #include "ui/twidget.h"
 #include "ui/effects/rect_shadow.h"
+#include "data/data_mention_index.h"
+
+namespace Notify {
+struct PeerUpdate;
+} // namespace Notify
 
 namespace internal {
 
@@ -33,7 +38,7 @@ class FieldAutocompleteInner;
 
 } // namespace internal
 
-class FieldAutocomplete final : public TWidget {
+class FieldAutocomplete final : public TWidget, private base::Subscriber {
 	Q_OBJECT
 
 public:
@@ -98,6 +103,10 @@ private:
 	void updateFiltered(bool resetScroll = false);
 	void recount(bool resetScroll = false);
 
+	// indexes participants of the _chat or recent participants of the megagroup _channel
+	void refreshMentionIndex(TimeId now);
+	void mentionIndexPeerUpdated(const Notify::PeerUpdate &update);
+
 	QPixmap _cache;
 	internal::MentionRows _mrows;
 	internal::HashtagRows _hrows;
@@ -113,6 +122,12 @@ private:
 	UserData *_user = nullptr;
 	ChannelData *_channel = nullptr;
 	EmojiPtr _emoji;
+
+	Data::MentionIndex _mentionIndex;
+	PeerData *_mentionIndexPeer = nullptr;
+	bool _mentionIndexOutdated = false;
+	QDate _mentionIndexRanksDate;
+
 	enum class Type {
 		Mentions,
 		Hashtags,
@@ -664,6 +664,9 @@ public:
 	bool emptyText() const {
 		return _text.isEmpty();
 	}
+	int64 textMemorySize() const {
+		return _text.memorySize();
+	}
 
 	bool canDelete() const {
 		ChannelData *channel = _history->peer->asChannel();
@@ -840,6 +843,13 @@ public:
 
 	void clipCallback(Media::Clip::Notification notification);
 
+	static void *operator new(std::size_t size) {
+		return MemoryPool::allocate(size, MemoryPool::Kind::HistoryItem);
+	}
+	static void operator delete(void *data, std::size_t size) {
+		MemoryPool::release(data, size, MemoryPool::Kind::HistoryItem);
+	}
+
 	~HistoryItem();
 
 protected:
@@ -32,6 +32,13 @@ public:
 	HistoryMedia(HistoryItem *parent) : _parent(parent) {
 	}
 
+	static void *operator new(std::size_t size) {
+		return MemoryPool::allocate(size, MemoryPool::Kind::HistoryMedia);
+	}
+	static void operator delete(void *data, std::size_t size) {
+		MemoryPool::release(data, size, MemoryPool::Kind::HistoryMedia);
+	}
+
 	virtual HistoryMediaType type() const = 0;
 
 	virtual QString notificationText() const {
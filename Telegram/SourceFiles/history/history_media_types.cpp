@@ -1894,7 +1894,7 @@ bool HistoryGif::playInline(bool autoplay) {
 		if (!cAutoPlayGif()) {
 			App::stopGifItems();
 		}
-		_gif = Media::Clip::MakeReader(_data->location(), _data->data(), [this](Media::Clip::Notification notification) {
+		_gif = Media::Clip::MakeReader(_data, [this](Media::Clip::Notification notification) {
 			_parent->clipCallback(notification);
 		});
 		App::regGifItem(_gif.get(), _parent);
@@ -759,7 +759,7 @@ void HistoryMessage::initDimensions() {
 		} else {
 			_minh += st::msgPadding.top() + st::msgPadding.bottom();
 			if (displayFromName()) {
-				auto namew = st::msgPadding.left() + author()->nameText.maxWidth() + st::msgPadding.right();
+				auto namew = st::msgPadding.left() + author()->nameText().maxWidth() + st::msgPadding.right();
 				if (via && !fwd) {
 					namew += st::msgServiceFont->spacew + via->_maxWidth;
 				}
@@ -831,7 +831,7 @@ void HistoryMessage::fromNameUpdated(int32 width) const {
 	_authorNameVersion = author()->nameVersion;
 	if (!Has<HistoryMessageForwarded>()) {
 		if (auto via = Get<HistoryMessageVia>()) {
-			via->resize(width - st::msgPadding.left() - st::msgPadding.right() - author()->nameText.maxWidth() - st::msgServiceFont->spacew);
+			via->resize(width - st::msgPadding.left() - st::msgPadding.right() - author()->nameText().maxWidth() - st::msgServiceFont->spacew);
 		}
 	}
 }
@@ -1356,14 +1356,14 @@ void HistoryMessage::paintFromName(Painter &p, QRect &trect, bool selected) cons
 		} else {
 			p.setPen(author()->color);
 		}
-		author()->nameText.drawElided(p, trect.left(), trect.top(), trect.width());
+		author()->nameText().drawElided(p, trect.left(), trect.top(), trect.width());
 
 		auto fwd = Get<HistoryMessageForwarded>();
 		auto via = Get<HistoryMessageVia>();
-		if (via && !fwd && trect.width() > author()->nameText.maxWidth() + st::msgServiceFont->spacew) {
+		if (via && !fwd && trect.width() > author()->nameText().maxWidth() + st::msgServiceFont->spacew) {
 			bool outbg = out() && !isPost();
 			p.setPen(selected ? (outbg ? st::msgOutServiceFgSelected : st::msgInServiceFgSelected) : (outbg ? st::msgOutServiceFg : st::msgInServiceFg));
-			p.drawText(trect.left() + author()->nameText.maxWidth() + st::msgServiceFont->spacew, trect.top() + st::msgServiceFont->ascent, via->_text);
+			p.drawText(trect.left() + author()->nameText().maxWidth() + st::msgServiceFont->spacew, trect.top() + st::msgServiceFont->ascent, via->_text);
 		}
 		trect.setY(trect.y() + st::msgNameFont->height);
 	}
@@ -1645,13 +1645,13 @@ HistoryTextState HistoryMessage::getState(int x, int y, HistoryStateRequest requ
 bool HistoryMessage::getStateFromName(int x, int y, QRect &trect, HistoryTextState *outResult) const {
 	if (displayFromName()) {
 		if (y >= trect.top() && y < trect.top() + st::msgNameFont->height) {
-			if (x >= trect.left() && x < trect.left() + trect.width() && x < trect.left() + author()->nameText.maxWidth()) {
+			if (x >= trect.left() && x < trect.left() + trect.width() && x < trect.left() + author()->nameText().maxWidth()) {
 				outResult->link = author()->openLink();
 				return true;
 			}
 			auto fwd = Get<HistoryMessageForwarded>();
 			auto via = Get<HistoryMessageVia>();
-			if (via && !fwd && x >= trect.left() + author()->nameText.maxWidth() + st::msgServiceFont->spacew && x < trect.left() + author()->nameText.maxWidth() + st::msgServiceFont->spacew + via->_width) {
+			if (via && !fwd && x >= trect.left() + author()->nameText().maxWidth() + st::msgServiceFont->spacew && x < trect.left() + author()->nameText().maxWidth() + st::msgServiceFont->spacew + via->_width) {
 				outResult->link = via->_lnk;
 				return true;
 			}
@@ -37,6 +37,7 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 #include "profile/profile_members_widget.h"
 #include "core/click_handler_types.h"
 #include "stickers/emoji_pan.h"
+#include "stickers/stickers.h"
 #include "lang.h"
 #include "application.h"
 #include "dropdown.h"
@@ -100,6 +101,7 @@ public:
 };
 
 constexpr int ScrollDateHideTimeout = 1000;
+constexpr int kHistoryTileHeight = 256;
 
 ApiWrap::RequestMessageDataCallback replyEditMessageDataCallback() {
 	return [](ChannelData *channel, MsgId msgId) {
@@ -165,7 +167,9 @@ void HistoryInner::repaintItem(const HistoryItem *item) {
 	if (!item || item->detached() || !_history) return;
 	int32 msgy = itemTop(item);
 	if (msgy >= 0) {
-		update(0, msgy, width(), item->height());
+		auto rect = QRect(0, msgy, width(), item->height());
+		invalidateTiles(rect);
+		update(rect);
 	}
 }
 
@@ -344,6 +348,159 @@ void HistoryInner::enumerateDates(Method method) {
 	enumerateItems(dateCallback);
 }
 
+template <typename Method>
+void HistoryInner::enumerateItemsInRect(const QRect &r, Method method) {
+	adjustCurrent(r.top());
+
+	int32 drawToY = r.y() + r.height();
+	int32 mtop = migratedTop(), htop = historyTop(), hdrawtop = historyDrawTop();
+	if (mtop >= 0) {
+		int32 iBlock = (_curHistory == _migrated ? _curBlock : (_migrated->blocks.size() - 1));
+		HistoryBlock *block = _migrated->blocks[iBlock];
+		int32 iItem = (_curHistory == _migrated ? _curItem : (block->items.size() - 1));
+		HistoryItem *item = block->items[iItem];
+
+		int32 y = mtop + block->y + item->y;
+		if (r.y() < y + item->height()) while (y < drawToY) {
+			method(item, y, r);
+
+			y += item->height();
+
+			++iItem;
+			if (iItem == block->items.size()) {
+				iItem = 0;
+				++iBlock;
+				if (iBlock == _migrated->blocks.size()) {
+					break;
+				}
+				block = _migrated->blocks[iBlock];
+			}
+			item = block->items[iItem];
+		}
+	}
+	if (htop >= 0) {
+		int32 iBlock = (_curHistory == _history ? _curBlock : 0);
+		HistoryBlock *block = _history->blocks[iBlock];
+		int32 iItem = (_curHistory == _history ? _curItem : 0);
+		HistoryItem *item = block->items[iItem];
+
+		QRect historyRect = r.intersected(QRect(0, hdrawtop, width(), r.top() + r.height()));
+		int32 y = htop + block->y + item->y;
+		while (y < drawToY) {
+			int32 h = item->height();
+			if (historyRect.y() < y + h && hdrawtop < y + h) {
+				method(item, y, historyRect);
+			}
+			y += h;
+
+			++iItem;
+			if (iItem == block->items.size()) {
+				iItem = 0;
+				++iBlock;
+				if (iBlock == _history->blocks.size()) {
+					break;
+				}
+				block = _history->blocks[iBlock];
+			}
+			item = block->items[iItem];
+		}
+	}
+}
+
+void HistoryInner::paintItems(Painter &p, const QRect &r, uint64 ms) {
+	SelectedItems::const_iterator selEnd = _selected.cend();
+	bool hasSel = !_selected.isEmpty();
+
+	int32 selfromy = itemTop(_dragSelFrom), seltoy = itemTop(_dragSelTo);
+	if (selfromy < 0 || seltoy < 0) {
+		selfromy = seltoy = -1;
+	} else {
+		seltoy += _dragSelTo->height();
+	}
+
+	auto scheduleViews = !Global::HistoryTilesEnabled(); // with tiles it is done in paintEvent()
+	enumerateItemsInRect(r, [this, &p, ms, selfromy, seltoy, hasSel, selEnd, scheduleViews](HistoryItem *item, int y, const QRect &clip) {
+		TextSelection sel;
+		if (y >= selfromy && y < seltoy) {
+			if (_dragSelecting && !item->serviceMsg() && item->id > 0) {
+				sel = FullSelection;
+			}
+		} else if (hasSel) {
+			auto i = _selected.constFind(item);
+			if (i != selEnd) {
+				sel = i.value();
+			}
+		}
+		p.translate(0, y);
+		item->draw(p, clip.translated(0, -y), sel, ms);
+		p.translate(0, -y);
+
+		if (scheduleViews && item->hasViews()) {
+			App::main()->scheduleViewIncrement(item);
+		}
+	});
+}
+
+void HistoryInner::paintTiles(Painter &p, const QRect &r, uint64 ms) {
+	if (width() <= 0) return;
+
+	auto from = r.top() / kHistoryTileHeight, till = (r.top() + r.height() - 1) / kHistoryTileHeight;
+	for (auto index = from; index <= till; ++index) {
+		auto tileRect = QRect(0, index * kHistoryTileHeight, width(), kHistoryTileHeight);
+		auto i = _tiles.find(index);
+		if (i == _tiles.end()) {
+			i = _tiles.insert(index, HistoryTile());
+			i->pixmap = QPixmap(width() * cIntRetinaFactor(), kHistoryTileHeight * cIntRetinaFactor());
+			i->pixmap.setDevicePixelRatio(cRetinaFactor());
+			i->dirty = QRegion(tileRect);
+		}
+		if (!i->dirty.isEmpty()) {
+			Painter tile(&i->pixmap);
+			tile.translate(0, -tileRect.top());
+			tile.setClipRegion(i->dirty);
+			tile.setCompositionMode(QPainter::CompositionMode_Source);
+			for_const (auto &rect, i->dirty.rects()) {
+				tile.fillRect(rect, Qt::transparent);
+			}
+			tile.setCompositionMode(QPainter::CompositionMode_SourceOver);
+			paintItems(tile, i->dirty.boundingRect(), ms);
+			i->dirty = QRegion();
+		}
+		p.drawPixmap(tileRect.topLeft(), i->pixmap);
+	}
+}
+
+void HistoryInner::invalidateTiles() {
+	_tiles.clear();
+}
+
+void HistoryInner::invalidateTiles(const QRect &rect) {
+	if (_tiles.isEmpty() || rect.isEmpty()) return;
+
+	auto from = qMax(rect.top(), 0) / kHistoryTileHeight, till = qMax(rect.top() + rect.height() - 1, 0) / kHistoryTileHeight;
+	for (auto i = _tiles.lowerBound(from), e = _tiles.end(); i != e && i.key() <= till; ++i) {
+		i->dirty += rect.intersected(QRect(0, i.key() * kHistoryTileHeight, width(), kHistoryTileHeight));
+	}
+}
+
+void HistoryInner::clearFarTiles() {
+	auto screen = _visibleAreaBottom - _visibleAreaTop;
+	auto from = qMax(_visibleAreaTop - screen, 0) / kHistoryTileHeight;
+	auto till = (_visibleAreaBottom + screen) / kHistoryTileHeight;
+	for (auto i = _tiles.begin(); i != _tiles.end();) {
+		if (i.key() < from || i.key() > till) {
+			i = _tiles.erase(i);
+		} else {
+			++i;
+		}
+	}
+}
+
+void HistoryInner::repaintAll() {
+	invalidateTiles();
+	update();
+}
+
 void HistoryInner::paintEvent(QPaintEvent *e) {
 	if (!App::main() || (App::wnd() && App::wnd()->contentOverlapped(this, e))) {
 		return;
@@ -379,112 +536,21 @@ void HistoryInner::paintEvent(QPaintEvent *e) {
 		HistoryLayout::paintEmpty(p, width(), height());
 	}
 	if (!noHistoryDisplayed) {
-		adjustCurrent(r.top());
-
-		SelectedItems::const_iterator selEnd = _selected.cend();
-		bool hasSel = !_selected.isEmpty();
-
-		int32 drawToY = r.y() + r.height();
-
-		int32 selfromy = itemTop(_dragSelFrom), seltoy = itemTop(_dragSelTo);
-		if (selfromy < 0 || seltoy < 0) {
-			selfromy = seltoy = -1;
-		} else {
-			seltoy += _dragSelTo->height();
-		}
-
-		int32 mtop = migratedTop(), htop = historyTop(), hdrawtop = historyDrawTop();
-		if (mtop >= 0) {
-			int32 iBlock = (_curHistory == _migrated ? _curBlock : (_migrated->blocks.size() - 1));
-			HistoryBlock *block = _migrated->blocks[iBlock];
-			int32 iItem = (_curHistory == _migrated ? _curItem : (block->items.size() - 1));
-			HistoryItem *item = block->items[iItem];
-
-			int32 y = mtop + block->y + item->y;
-			p.save();
-			p.translate(0, y);
-			if (r.y() < y + item->height()) while (y < drawToY) {
-				TextSelection sel;
-				if (y >= selfromy && y < seltoy) {
-					if (_dragSelecting && !item->serviceMsg() && item->id > 0) {
-						sel = FullSelection;
-					}
-				} else if (hasSel) {
-					auto i = _selected.constFind(item);
-					if (i != selEnd) {
-						sel = i.value();
-					}
-				}
-				item->draw(p, r.translated(0, -y), sel, ms);
-
+		if (Global::HistoryTilesEnabled()) {
+			paintTiles(p, r, ms);
+			enumerateItemsInRect(r, [](HistoryItem *item, int y, const QRect &clip) {
 				if (item->hasViews()) {
 					App::main()->scheduleViewIncrement(item);
 				}
-
-				int32 h = item->height();
-				p.translate(0, h);
-				y += h;
-
-				++iItem;
-				if (iItem == block->items.size()) {
-					iItem = 0;
-					++iBlock;
-					if (iBlock == _migrated->blocks.size()) {
-						break;
-					}
-					block = _migrated->blocks[iBlock];
-				}
-				item = block->items[iItem];
-			}
-			p.restore();
-		}
-		if (htop >= 0) {
-			int32 iBlock = (_curHistory == _history ? _curBlock : 0);
-			HistoryBlock *block = _history->blocks[iBlock];
-			int32 iItem = (_curHistory == _history ? _curItem : 0);
-			HistoryItem *item = block->items[iItem];
-
-			QRect historyRect = r.intersected(QRect(0, hdrawtop, width(), r.top() + r.height()));
-			int32 y = htop + block->y + item->y;
-			p.save();
-			p.translate(0, y);
-			while (y < drawToY) {
-				int32 h = item->height();
-				if (historyRect.y() < y + h && hdrawtop < y + h) {
-					TextSelection sel;
-					if (y >= selfromy && y < seltoy) {
-						if (_dragSelecting && !item->serviceMsg() && item->id > 0) {
-							sel = FullSelection;
-						}
-					} else if (hasSel) {
-						auto i = _selected.constFind(item);
-						if (i != selEnd) {
-							sel = i.value();
-						}
-					}
-					item->draw(p, historyRect.translated(0, -y), sel, ms);
-
-					if (item->hasViews()) {
-						App::main()->scheduleViewIncrement(item);
-					}
-				}
-				p.translate(0, h);
-				y += h;
-
-				++iItem;
-				if (iItem == block->items.size()) {
-					iItem = 0;
-					++iBlock;
-					if (iBlock == _history->blocks.size()) {
-						break;
-					}
-					block = _history->blocks[iBlock];
-				}
-				item = block->items[iItem];
+			});
+		} else {
+			if (!_tiles.isEmpty()) {
+				_tiles.clear();
 			}
-			p.restore();
+			paintItems(p, r, ms);
 		}
 
+		int32 mtop = migratedTop(), htop = historyTop();
 		if (mtop >= 0 || htop >= 0) {
 			enumerateUserpics([&p, &r](HistoryMessage *message, int userpicTop) {
 				// stop the enumeration if the userpic is above the painted rect
@@ -991,7 +1057,7 @@ void HistoryInner::itemRemoved(HistoryItem *item) {
 	if (_dragSelFrom == item || _dragSelTo == item) {
 		_dragSelFrom = 0;
 		_dragSelTo = 0;
-		update();
+		repaintAll();
 	}
 	onUpdateSelected();
 }
@@ -1050,7 +1116,7 @@ void HistoryInner::dragActionFinish(const QPoint &screenPos, Qt::MouseButton but
 			}
 		} else {
 			_selected.clear();
-			update();
+			repaintAll();
 		}
 	} else if (_dragAction == Selecting) {
 		if (_dragSelFrom && _dragSelTo) {
@@ -1440,6 +1506,7 @@ void HistoryInner::setToClipboard(const TextWithEntities &forClipboard, QClipboa
 }
 
 void HistoryInner::resizeEvent(QResizeEvent *e) {
+	invalidateTiles();
 	onUpdateSelected();
 }
 
@@ -1511,6 +1578,8 @@ void HistoryInner::keyPressEvent(QKeyEvent *e) {
 }
 
 void HistoryInner::recountHeight() {
+	invalidateTiles();
+
 	int visibleHeight = _scroll->height();
 	int oldHistoryPaddingTop = qMax(visibleHeight - historyHeight() - st::historyPaddingBottom, 0);
 	if (_botAbout && !_botAbout->info->text.isEmpty()) {
@@ -1621,12 +1690,13 @@ bool HistoryInner::wasSelectedText() const {
 
 void HistoryInner::setFirstLoading(bool loading) {
 	_firstLoading = loading;
-	update();
+	repaintAll();
 }
 
 void HistoryInner::visibleAreaUpdated(int top, int bottom) {
 	_visibleAreaTop = top;
 	_visibleAreaBottom = bottom;
+	clearFarTiles();
 
 	// if history has pending resize events we should not update scrollTopItem
 	if (hasPendingResizedItems()) {
@@ -1704,10 +1774,12 @@ void HistoryInner::toggleScrollDateShown() {
 void HistoryInner::repaintScrollDateCallback() {
 	int updateTop = _visibleAreaTop;
 	int updateHeight = st::msgServiceMargin.top() + st::msgServicePadding.top() + st::msgServiceFont->height + st::msgServicePadding.bottom();
-	update(0, updateTop, width(), updateHeight);
+	update(0, updateTop, width(), updateHeight); // dates are not cached in tiles
 }
 
 void HistoryInner::updateSize() {
+	invalidateTiles();
+
 	int visibleHeight = _scroll->height();
 	int newHistoryPaddingTop = qMax(visibleHeight - historyHeight() - st::historyPaddingBottom, 0);
 	if (_botAbout && !_botAbout->info->text.isEmpty()) {
@@ -1734,7 +1806,7 @@ void HistoryInner::updateSize() {
 
 		dragActionUpdate(QCursor::pos());
 	} else {
-		update();
+		repaintAll();
 	}
 }
 
@@ -1785,28 +1857,28 @@ void HistoryInner::adjustCurrent(int32 y) const {
 void HistoryInner::adjustCurrent(int32 y, History *history) const {
 	t_assert(!history->isEmpty());
 	_curHistory = history;
+
+	// block->y and item->y are prefix sums of the heights kept by resizeGetHeight(),
+	// so if the cached position does not contain y we find it with a binary search
+	// instead of walking from the previous position item by item
 	if (_curBlock >= history->blocks.size()) {
 		_curBlock = history->blocks.size() - 1;
 		_curItem = 0;
 	}
-	while (history->blocks.at(_curBlock)->y > y && _curBlock > 0) {
-		--_curBlock;
-		_curItem = 0;
-	}
-	while (history->blocks.at(_curBlock)->y + history->blocks.at(_curBlock)->height <= y && _curBlock + 1 < history->blocks.size()) {
-		++_curBlock;
+	HistoryBlock *block = history->blocks.at(_curBlock);
+	if ((block->y > y && _curBlock > 0) || (block->y + block->height <= y && _curBlock + 1 < history->blocks.size())) {
+		_curBlock = binarySearchBlocksOrItems(history->blocks, y + 1);
 		_curItem = 0;
+		block = history->blocks.at(_curBlock);
 	}
-	HistoryBlock *block = history->blocks.at(_curBlock);
+
 	if (_curItem >= block->items.size()) {
 		_curItem = block->items.size() - 1;
 	}
 	int by = block->y;
-	while (block->items.at(_curItem)->y + by > y && _curItem > 0) {
-		--_curItem;
-	}
-	while (block->items.at(_curItem)->y + block->items.at(_curItem)->height() + by <= y && _curItem + 1 < block->items.size()) {
-		++_curItem;
+	HistoryItem *item = block->items.at(_curItem);
+	if ((item->y + by > y && _curItem > 0) || (item->y + item->height() + by <= y && _curItem + 1 < block->items.size())) {
+		_curItem = binarySearchBlocksOrItems(block->items, y - by + 1);
 	}
 }
 
@@ -2102,7 +2174,7 @@ void HistoryInner::updateDragSelection(HistoryItem *dragSelFrom, HistoryItem *dr
 	}
 	if (!force) return;
 
-	update();
+	repaintAll();
 }
 
 void HistoryInner::BotAbout::clickHandlerActiveChanged(const ClickHandlerPtr &p, bool active) {
@@ -3015,7 +3087,10 @@ HistoryWidget::HistoryWidget(QWidget *parent) : TWidget(parent)
 
 	setAcceptDrops(true);
 
-	subscribe(FileDownload::ImageLoaded(), [this] { update(); });
+	subscribe(FileDownload::ImageLoaded(), [this] {
+		update();
+		if (_list) _list->repaintAll();
+	});
 	connect(&_scroll, SIGNAL(scrolled()), this, SLOT(onScroll()));
 	connect(&_reportSpamPanel, SIGNAL(reportClicked()), this, SLOT(onReportSpamClicked()));
 	connect(&_reportSpamPanel, SIGNAL(hideClicked()), this, SLOT(onReportSpamHide()));
@@ -3154,6 +3229,7 @@ void HistoryWidget::start() {
 }
 
 void HistoryWidget::onStickersUpdated() {
+	Stickers::refreshEmojiIndex();
 	_emojiPan->refreshStickers();
 	updateStickersByEmoji();
 }
@@ -3619,7 +3695,7 @@ void HistoryWidget::notify_migrateUpdated(PeerData *peer) {
 }
 
 void HistoryWidget::notify_clipStopperHidden(ClipStopperType type) {
-	if (_list) _list->update();
+	if (_list) _list->repaintAll();
 }
 
 bool HistoryWidget::cmd_search() {
@@ -5073,6 +5149,7 @@ void HistoryWidget::delayedShowAt(MsgId showAtMsgId) {
 }
 
 void HistoryWidget::onScroll() {
+	MTP::clearLoaderPriorities();
 	App::checkImageCacheSize();
 	preloadHistoryIfNeeded();
 	visibleAreaUpdated();
@@ -5098,11 +5175,20 @@ void HistoryWidget::preloadHistoryIfNeeded() {
 	updateToEndVisibility();
 
 	int st = _scroll.scrollTop(), stm = _scroll.scrollTopMax(), sh = _scroll.height();
-	if (st + PreloadHeightsCount * sh > stm) {
+
+	// The space left for the unloaded messages is not counted, they are loaded when their space is reached.
+	int loadedFrom = 0, loadedTill = stm;
+	if (_history->unloadedHeightAbove() > 0) {
+		loadedFrom = _list->historyTop() + _history->unloadedHeightAbove();
+	}
+	if (_history->unloadedHeightBelow() > 0) {
+		loadedTill = qMax(stm - _history->unloadedHeightBelow(), 0);
+	}
+	if (st + PreloadHeightsCount * sh > loadedTill) {
 		loadMessagesDown();
 	}
 
-	if (st < PreloadHeightsCount * sh) {
+	if (st < loadedFrom + PreloadHeightsCount * sh) {
 		loadMessages();
 	}
 
@@ -6961,7 +7047,7 @@ void HistoryWidget::onUpdateHistoryItems() {
 
 	uint64 ms = getms();
 	if (_lastScrolled + 100 <= ms) {
-		_list->update();
+		_list->repaintAll();
 	} else {
 		_updateHistoryItems.start(_lastScrolled + 100 - ms);
 	}
@@ -6996,7 +7082,7 @@ void HistoryWidget::notify_inlineItemLayoutChanged(const InlineBots::Layout::Ite
 void HistoryWidget::notify_handlePendingHistoryUpdate() {
 	if (hasPendingResizedItems()) {
 		updateListSize();
-		_list->update();
+		_list->repaintAll();
 	}
 }
 
@@ -7084,6 +7170,14 @@ void HistoryWidget::itemEdited(HistoryItem *item) {
 	}
 }
 
+bool HistoryWidget::benchmarkScroll(int delta) {
+	if (!_list || _scroll.isHidden() || isHidden()) {
+		return false;
+	}
+	_scroll.scrollToY(_scroll.scrollTop() + delta);
+	return true;
+}
+
 void HistoryWidget::updateScrollColors() {
 	if (!App::historyScrollBarColor()) return;
 	_scroll.updateColors(App::historyScrollBarColor(), App::historyScrollBgColor(), App::historyScrollBarOverColor(), App::historyScrollBgOverColor());
@@ -8751,10 +8845,12 @@ void HistoryWidget::paintEvent(QPaintEvent *e) {
 			bool smooth = p.renderHints().testFlag(QPainter::SmoothPixmapTransform);
 			p.setRenderHint(QPainter::SmoothPixmapTransform);
 
+			// until the exact size image is cached draw the nearest mip
 			QRect to, from;
 			App::main()->backgroundParams(fill, to, from);
+			auto &level = Window::chatBackground()->imageForSize(from, to.size() * cIntRetinaFactor());
 			to.moveTop(to.top() + fromy);
-			p.drawPixmap(to, pix, from);
+			p.drawPixmap(to, level, from);
 
 			if (!smooth) p.setRenderHint(QPainter::SmoothPixmapTransform, false);
 		}
@@ -72,6 +72,9 @@ public:
 
 	void repaintItem(const HistoryItem *item);
 
+	// Drops the cached tiles (if any) and repaints everything.
+	void repaintAll();
+
 	bool canCopySelected() const;
 	bool canDeleteSelected() const;
 
@@ -165,6 +168,23 @@ private:
 	void repaintScrollDateCallback();
 	bool displayScrollDate() const;
 
+	// Optional cache of the painted messages in fixed height tiles (Global::HistoryTilesEnabled()),
+	// so that scrolling mostly blits them. Floating dates and userpics are painted over the tiles.
+	struct HistoryTile {
+		QPixmap pixmap;
+		QRegion dirty; // repainted before the tile is used next time
+	};
+	void paintItems(Painter &p, const QRect &r, uint64 ms);
+	void paintTiles(Painter &p, const QRect &r, uint64 ms);
+	void invalidateTiles();
+	void invalidateTiles(const QRect &rect);
+	void clearFarTiles();
+	QMap<int, HistoryTile> _tiles;
+
+	// method has "void (*Method)(HistoryItem *item, int itemtop, const QRect &clip)" signature
+	template <typename Method>
+	void enumerateItemsInRect(const QRect &r, Method method);
+
 	PeerData *_peer = nullptr;
 	History *_migrated = nullptr;
 	History *_history = nullptr;
@@ -616,6 +636,7 @@ public:
 	void noSelectingScroll();
 
 	bool touchScroll(const QPoint &delta);
+	bool benchmarkScroll(int delta); // false if no history is shown
 
 	uint64 animActiveTimeStart(const HistoryItem *msg) const;
 	void stopAnimActive();
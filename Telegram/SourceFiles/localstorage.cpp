@@ -34,6 +34,8 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 #include "media/media_audio.h"
 #include "application.h"
 #include "apiwrap.h"
+#include "stickers/stickers.h"
+#include "core/startup_profiler.h"
 
 namespace Local {
 namespace {
@@ -60,6 +62,30 @@ bool _started = false;
 internal::Manager *_manager = nullptr;
 TaskQueue *_localLoader = nullptr;
 
+// Voice waveforms are counted apart from the local images loading.
+QVector<TaskQueue*> _waveformCounters;
+int _waveformCounterIndex = 0;
+
+// Files needed soon after the map is read are read and decrypted in parallel
+// by the prefetchers, they are taken and parsed on the main thread.
+struct PrefetchedFile {
+	int options = 0;
+	bool done = false;
+	int32 version = 0;
+	QByteArray data; // decrypted, empty if reading failed
+	qint64 position = 0;
+};
+QVector<TaskQueue*> _prefetchers;
+int _prefetcherIndex = 0;
+QMutex _prefetchMutex;
+QWaitCondition _prefetchCondition;
+QMap<QString, PrefetchedFile> _prefetchedFiles; // by file name, guarded by _prefetchMutex
+
+void _forgetPrefetchedFile(const QString &name) {
+	QMutexLocker lock(&_prefetchMutex);
+	_prefetchedFiles.remove(name);
+}
+
 bool _working() {
 	return _manager && !_basePath.isEmpty();
 }
@@ -110,6 +136,8 @@ void clearKey(const FileKey &key, int options = UserPath | SafePath) {
 		if (!_working()) return;
 	}
 
+	_forgetPrefetchedFile(toFilePart(key));
+
 	QString base = (options & UserPath) ? _userBasePath : _basePath, name;
 	name.reserve(base.size() + 0x11);
 	name.append(base).append(toFilePart(key)).append('0');
@@ -205,6 +233,7 @@ struct FileWriteDescriptor {
 		} else {
 			if (!_working()) return;
 		}
+		_forgetPrefetchedFile(name);
 
 		// detect order of read attempts and file version
 		QString toTry[2];
@@ -302,20 +331,16 @@ struct FileWriteDescriptor {
 	}
 };
 
-bool readFile(FileReadDescriptor &result, const QString &name, int options = UserPath | SafePath) {
-	if (options & UserPath) {
-		if (!_userWorking()) return false;
-	} else {
-		if (!_working()) return false;
-	}
-
+// Doesn't use the global state, so it can be called from other threads.
+// They don't remove the stale copy, the main thread could be writing it.
+bool _readFileAt(FileReadDescriptor &result, const QString &basePath, const QString &name, int options, bool removeStale = true) {
 	// detect order of read attempts
 	QString toTry[2];
-	toTry[0] = ((options & UserPath) ? _userBasePath : _basePath) + name + '0';
+	toTry[0] = basePath + name + '0';
 	if (options & SafePath) {
 		QFileInfo toTry0(toTry[0]);
 		if (toTry0.exists()) {
-			toTry[1] = ((options & UserPath) ? _userBasePath : _basePath) + name + '1';
+			toTry[1] = basePath + name + '1';
 			QFileInfo toTry1(toTry[1]);
 			if (toTry1.exists()) {
 				QDateTime mod0 = toTry0.lastModified(), mod1 = toTry1.lastModified();
@@ -390,7 +415,7 @@ bool readFile(FileReadDescriptor &result, const QString &name, int options = Use
 		result.stream.setDevice(&result.buffer);
 		result.stream.setVersion(QDataStream::Qt_5_1);
 
-		if ((i == 0 && !toTry[1].isEmpty()) || i == 1) {
+		if (removeStale && ((i == 0 && !toTry[1].isEmpty()) || i == 1)) {
 			QFile::remove(toTry[1 - i]);
 		}
 
@@ -399,6 +424,15 @@ bool readFile(FileReadDescriptor &result, const QString &name, int options = Use
 	return false;
 }
 
+bool readFile(FileReadDescriptor &result, const QString &name, int options = UserPath | SafePath) {
+	if (options & UserPath) {
+		if (!_userWorking()) return false;
+	} else {
+		if (!_working()) return false;
+	}
+	return _readFileAt(result, (options & UserPath) ? _userBasePath : _basePath, name, options);
+}
+
 bool decryptLocal(EncryptedDescriptor &result, const QByteArray &encrypted, const MTP::AuthKey &key = _localKey) {
 	if (encrypted.size() <= 16 || (encrypted.size() & 0x0F)) {
 		LOG(("App Error: bad encrypted part size: %1").arg(encrypted.size()));
@@ -435,10 +469,7 @@ bool decryptLocal(EncryptedDescriptor &result, const QByteArray &encrypted, cons
 	return true;
 }
 
-bool readEncryptedFile(FileReadDescriptor &result, const QString &name, int options = UserPath | SafePath, const MTP::AuthKey &key = _localKey) {
-	if (!readFile(result, name, options)) {
-		return false;
-	}
+bool _decryptFile(FileReadDescriptor &result, const MTP::AuthKey &key) {
 	QByteArray encrypted;
 	result.stream >> encrypted;
 
@@ -465,6 +496,106 @@ bool readEncryptedFile(FileReadDescriptor &result, const QString &name, int opti
 	return true;
 }
 
+class PrefetchFileTask : public Task {
+public:
+	PrefetchFileTask(const char *phase, const QString &name, int options, const QString &basePath, const MTP::AuthKey &key)
+		: _phase(phase)
+		, _name(name)
+		, _options(options)
+		, _basePath(basePath)
+		, _key(key) {
+	}
+
+	void process() override {
+		StartupProfiler::Phase phase(_phase);
+
+		FileReadDescriptor file;
+		auto success = _readFileAt(file, _basePath, _name, _options, false) && _decryptFile(file, _key);
+
+		QMutexLocker lock(&_prefetchMutex);
+		auto i = _prefetchedFiles.find(_name);
+		if (i == _prefetchedFiles.end()) {
+			return; // the file was written or cleared meanwhile
+		}
+		if (success) {
+			i->version = file.version;
+			i->data = file.data;
+			i->position = file.buffer.pos();
+		}
+		i->done = true;
+		_prefetchCondition.wakeAll();
+	}
+	void finish() override {
+	}
+
+private:
+	const char *_phase;
+	QString _name;
+	int _options;
+	QString _basePath;
+	MTP::AuthKey _key;
+
+};
+
+void _prefetchFile(const char *phase, const QString &name, int options = UserPath | SafePath) {
+	if (_prefetchers.isEmpty()) return;
+	{
+		QMutexLocker lock(&_prefetchMutex);
+		if (_prefetchedFiles.contains(name)) return;
+		_prefetchedFiles[name].options = options;
+	}
+	auto prefetcher = _prefetchers[_prefetcherIndex];
+	_prefetcherIndex = (_prefetcherIndex + 1) % _prefetchers.size();
+	prefetcher->addTask(new PrefetchFileTask(phase, name, options, (options & UserPath) ? _userBasePath : _basePath, _localKey));
+}
+
+void _prefetchFile(const char *phase, const FileKey &key) {
+	if (key) _prefetchFile(phase, toFilePart(key));
+}
+
+// Waits for the prefetcher if the file is being read, returns false if it was not prefetched.
+bool _takePrefetchedFile(FileReadDescriptor &result, const QString &name, int options) {
+	PrefetchedFile file;
+	{
+		QMutexLocker lock(&_prefetchMutex);
+		auto i = _prefetchedFiles.find(name);
+		if (i == _prefetchedFiles.end() || i->options != options) {
+			return false;
+		}
+		while (!i->done) {
+			_prefetchCondition.wait(&_prefetchMutex);
+			i = _prefetchedFiles.find(name);
+			if (i == _prefetchedFiles.end()) {
+				return false;
+			}
+		}
+		file = i.value();
+		_prefetchedFiles.erase(i);
+	}
+	if (file.data.isEmpty()) {
+		return false; // read it once again to log the error
+	}
+
+	result.version = file.version;
+	result.data = file.data;
+	result.buffer.setBuffer(&result.data);
+	result.buffer.open(QIODevice::ReadOnly);
+	result.buffer.seek(file.position);
+	result.stream.setDevice(&result.buffer);
+	result.stream.setVersion(QDataStream::Qt_5_1);
+	return true;
+}
+
+bool readEncryptedFile(FileReadDescriptor &result, const QString &name, int options = UserPath | SafePath, const MTP::AuthKey &key = _localKey) {
+	if (&key == &_localKey && _takePrefetchedFile(result, name, options)) {
+		return true;
+	}
+	if (!readFile(result, name, options)) {
+		return false;
+	}
+	return _decryptFile(result, key);
+}
+
 bool readEncryptedFile(FileReadDescriptor &result, const FileKey &fkey, int options = UserPath | SafePath, const MTP::AuthKey &key = _localKey) {
 	return readEncryptedFile(result, toFilePart(fkey), options, key);
 }
@@ -490,6 +621,15 @@ enum { // Local Storage Keys
 	lskSavedGifs = 0x0f, // no data
 	lskStickersKeys = 0x10, // no data
 	lskTrustedBots = 0x11, // no data
+	lskClipSidecars = 0x12, // data: StorageKey location
+	lskVoiceWaveforms = 0x13, // no data
+	lskInlineBotResults = 0x14, // no data
+	lskMapJournal = 0x15, // data: quint64 journal id
+};
+
+enum { // Map Journal Operations
+	mjoInsert = 0x01, // data: StorageKey location, FileKey key, qint32 size
+	mjoRemove = 0x02, // data: StorageKey location
 };
 
 enum {
@@ -552,6 +692,8 @@ enum {
 	dbiNativeNotifications = 0x44,
 	dbiNotificationsCount  = 0x45,
 	dbiNotificationsCorner = 0x46,
+	dbiLocalStorageLimit = 0x47,
+	dbiMessagesMemoryLimit = 0x48,
 
 	dbiEncryptedWithSalt = 333,
 	dbiEncrypted = 444,
@@ -597,11 +739,174 @@ FileKey _userSettingsKey = 0;
 FileKey _recentHashtagsAndBotsKey = 0;
 bool _recentHashtagsAndBotsWereRead = false;
 
+FileKey _voiceWaveformsKey = 0;
+bool _voiceWaveformsWereRead = false;
+QMap<DocumentId, VoiceWaveform> _voiceWaveforms;
+QList<DocumentId> _voiceWaveformsOrder;
+
+FileKey _inlineBotResultsKey = 0;
+bool _inlineBotResultsWereRead = false;
+QByteArray _inlineBotResults;
+bool _inlineBotResultsChanged = false; // _inlineBotResults must be serialized again
+base::lambda_unique<QByteArray()> _inlineBotResultsSerializer;
+
 FileKey _savedPeersKey = 0;
 
 typedef QMap<StorageKey, FileDesc> StorageMap;
-StorageMap _imagesMap, _stickerImagesMap, _audiosMap;
-int32 _storageImagesSize = 0, _storageStickersSize = 0, _storageAudiosSize = 0;
+StorageMap _imagesMap, _stickerImagesMap, _audiosMap, _clipSidecarsMap;
+int64 _storageImagesSize = 0, _storageStickersSize = 0, _storageAudiosSize = 0, _storageClipSidecarsSize = 0;
+
+// Cache maps can have many thousands of entries, so their sections of the map
+// file are parsed by a prefetcher while the main thread goes on with the startup.
+constexpr auto kStorageMapEntrySize = qint64(3 * sizeof(quint64) + sizeof(qint32));
+struct StorageMaps {
+	StorageMap images, stickerImages, audios, clipSidecars;
+	qint64 imagesSize = 0, stickerImagesSize = 0, audiosSize = 0, clipSidecarsSize = 0;
+};
+bool _storageMapsParsing = false;
+bool _storageMapsParsed = false; // guarded by _prefetchMutex
+StorageMaps _parsedStorageMaps; // guarded by _prefetchMutex
+
+bool _storageMapByType(StorageMaps &maps, quint32 keyType, StorageMap *&map, qint64 *&size) {
+	switch (keyType) {
+	case lskImages: map = &maps.images; size = &maps.imagesSize; return true;
+	case lskStickerImages: map = &maps.stickerImages; size = &maps.stickerImagesSize; return true;
+	case lskAudios: map = &maps.audios; size = &maps.audiosSize; return true;
+	case lskClipSidecars: map = &maps.clipSidecars; size = &maps.clipSidecarsSize; return true;
+	}
+	return false;
+}
+
+// Applies the map journal records on top of the parsed cache map sections.
+void _applyMapJournal(const QByteArray &journal, StorageMaps &result) {
+	QDataStream stream(journal);
+	stream.setVersion(QDataStream::Qt_5_1);
+	while (!stream.atEnd()) {
+		quint32 op = 0, keyType = 0;
+		quint64 first = 0, second = 0;
+		stream >> op >> keyType >> first >> second;
+
+		StorageMap *map = nullptr;
+		qint64 *size = nullptr;
+		if (!_storageMapByType(result, keyType, map, size) || !_checkStreamStatus(stream)) {
+			LOG(("App Error: bad map journal record %1 for key type %2").arg(op).arg(keyType));
+			return;
+		}
+		auto location = StorageKey(first, second);
+		auto i = map->find(location);
+		if (i != map->end()) {
+			*size -= i.value().second;
+			map->erase(i);
+		}
+		if (op == mjoInsert) {
+			FileKey key = 0;
+			qint32 fileSize = 0;
+			stream >> key >> fileSize;
+			if (!_checkStreamStatus(stream)) {
+				return;
+			}
+			map->insert(location, FileDesc(key, fileSize));
+			*size += fileSize;
+		} else if (op != mjoRemove) {
+			LOG(("App Error: unknown map journal operation %1").arg(op));
+			return;
+		}
+	}
+}
+
+// Parses lskImages, lskStickerImages, lskAudios and lskClipSidecars sections
+// of the map and applies the map journal to them, any thread can call it.
+void _parseStorageMaps(const QByteArray &sections, const QByteArray &journal, StorageMaps &result) {
+	QDataStream stream(sections);
+	stream.setVersion(QDataStream::Qt_5_1);
+	while (!stream.atEnd()) {
+		quint32 keyType = 0, count = 0;
+		stream >> keyType >> count;
+
+		StorageMap *map = nullptr;
+		qint64 *size = nullptr;
+		if (!_storageMapByType(result, keyType, map, size) || !_checkStreamStatus(stream)) {
+			LOG(("App Error: bad cache map section %1").arg(keyType));
+			return;
+		}
+		for (quint32 i = 0; i < count; ++i) {
+			FileKey key;
+			quint64 first, second;
+			qint32 fileSize;
+			stream >> key >> first >> second >> fileSize;
+			map->insert(StorageKey(first, second), FileDesc(key, fileSize));
+			*size += fileSize;
+		}
+	}
+	_applyMapJournal(journal, result);
+}
+
+class ParseStorageMapsTask : public Task {
+public:
+	ParseStorageMapsTask(const QByteArray &sections, const QByteArray &journal) : _sections(sections), _journal(journal) {
+	}
+
+	void process() override {
+		StartupProfiler::Phase phase("Local::parseStorageMaps");
+
+		StorageMaps maps;
+		_parseStorageMaps(_sections, _journal, maps);
+
+		QMutexLocker lock(&_prefetchMutex);
+		_parsedStorageMaps = std_::move(maps);
+		_storageMapsParsed = true;
+		_prefetchCondition.wakeAll();
+	}
+	void finish() override {
+	}
+
+private:
+	QByteArray _sections;
+	QByteArray _journal;
+
+};
+
+void _setStorageMaps(StorageMaps &&maps) {
+	_imagesMap = std_::move(maps.images);
+	_storageImagesSize = maps.imagesSize;
+	_stickerImagesMap = std_::move(maps.stickerImages);
+	_storageStickersSize = maps.stickerImagesSize;
+	_audiosMap = std_::move(maps.audios);
+	_storageAudiosSize = maps.audiosSize;
+	_clipSidecarsMap = std_::move(maps.clipSidecars);
+	_storageClipSidecarsSize = maps.clipSidecarsSize;
+}
+
+void _startParsingStorageMaps(const QByteArray &sections, const QByteArray &journal) {
+	if (_prefetchers.isEmpty()) {
+		StorageMaps maps;
+		_parseStorageMaps(sections, journal, maps);
+		_setStorageMaps(std_::move(maps));
+		return;
+	}
+	{
+		QMutexLocker lock(&_prefetchMutex);
+		_storageMapsParsed = false;
+	}
+	_storageMapsParsing = true;
+	_prefetchers[0]->addTask(new ParseStorageMapsTask(sections, journal));
+}
+
+// Must be called before any access to the cache maps, waits for them to be parsed.
+void _readStorageMaps() {
+	if (!_storageMapsParsing) return;
+	_storageMapsParsing = false;
+
+	StorageMaps maps;
+	{
+		QMutexLocker lock(&_prefetchMutex);
+		while (!_storageMapsParsed) {
+			_prefetchCondition.wait(&_prefetchMutex);
+		}
+		maps = base::take(_parsedStorageMaps);
+	}
+	_setStorageMaps(std_::move(maps));
+}
 
 bool _mapChanged = false;
 int32 _oldMapVersion = 0, _oldSettingsVersion = 0;
@@ -614,6 +919,239 @@ enum WriteMapWhen {
 
 void _writeMap(WriteMapWhen when = WriteMapSoon);
 
+// Cache map changes are appended to the map journal as encrypted records, so that
+// saving a downloaded file doesn't rewrite the whole map. The map is rewritten when
+// something else in it changes or when the journal becomes too large.
+quint64 _mapJournalId = 0; // written to the map, a journal with another id is outdated
+qint64 _mapJournalSize = -1; // -1 if we can't append to the journal file
+qint64 _mapSize = 0;
+QByteArray _mapJournalPending;
+
+QString _mapJournalPath() {
+	return _userBasePath + qsl("mapjournal");
+}
+
+void _journalMapChange(quint32 op, quint32 keyType, const StorageKey &location, const FileDesc &desc = FileDesc()) {
+	if (_mapChanged) return; // the whole map will be written anyway
+
+	QDataStream stream(&_mapJournalPending, QIODevice::WriteOnly | QIODevice::Append);
+	stream.setVersion(QDataStream::Qt_5_1);
+	stream << op << keyType << quint64(location.first) << quint64(location.second);
+	if (op == mjoInsert) {
+		stream << quint64(desc.first) << qint32(desc.second);
+	}
+}
+
+void _journalMapInsert(quint32 keyType, const StorageKey &location, const FileDesc &desc) {
+	_journalMapChange(mjoInsert, keyType, location, desc);
+}
+
+void _journalMapRemove(quint32 keyType, const StorageKey &location) {
+	_journalMapChange(mjoRemove, keyType, location);
+}
+
+// Returns false if the whole map should be written instead.
+bool _appendMapJournal() {
+	if (_mapJournalSize < 0) return false;
+	if (_mapJournalSize + _mapJournalPending.size() > qMax(qint64(LocalMapJournalSizeMin), _mapSize / 2)) {
+		return false;
+	}
+
+	QFile f(_mapJournalPath());
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Append) || f.size() != _mapJournalSize) {
+		LOG(("App Info: could not append to the map journal, writing the map."));
+		return false;
+	}
+
+	EncryptedDescriptor data(_mapJournalPending.size());
+	data.stream.writeRawData(_mapJournalPending.constData(), _mapJournalPending.size());
+
+	QDataStream stream(&f);
+	stream.setVersion(QDataStream::Qt_5_1);
+	stream << FileWriteDescriptor::prepareEncrypted(data);
+	f.close();
+	if (stream.status() != QDataStream::Ok || f.error() != QFile::NoError) {
+		return false;
+	}
+
+	_mapJournalSize = f.size();
+	_mapJournalPending.clear();
+	return true;
+}
+
+// Called after the map with this journal id is written.
+void _startMapJournal(quint64 journalId) {
+	_mapJournalId = journalId;
+	_mapJournalSize = -1;
+	_mapJournalPending.clear();
+
+	QFile f(_mapJournalPath());
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		LOG(("App Error: could not open map journal for writing."));
+		return;
+	}
+	QDataStream stream(&f);
+	stream.setVersion(QDataStream::Qt_5_1);
+	stream << quint64(journalId);
+	f.close();
+	if (stream.status() == QDataStream::Ok && f.error() == QFile::NoError) {
+		_mapJournalSize = f.size();
+	}
+}
+
+// Reads the records of the journal started for the map with this journal id.
+// A damaged record ends the reading, it could be the app crashed while writing it.
+QByteArray _readMapJournal(quint64 journalId, qint64 &appendAt) {
+	appendAt = -1;
+
+	QFile f(_mapJournalPath());
+	if (!f.open(QIODevice::ReadOnly)) {
+		LOG(("App Info: map journal not found."));
+		return QByteArray();
+	}
+	QDataStream stream(&f);
+	stream.setVersion(QDataStream::Qt_5_1);
+
+	quint64 id = 0;
+	stream >> id;
+	if (stream.status() != QDataStream::Ok || id != journalId) {
+		LOG(("App Info: map journal is outdated."));
+		return QByteArray();
+	}
+
+	QByteArray result;
+	auto valid = f.pos();
+	while (!stream.atEnd()) {
+		QByteArray encrypted;
+		stream >> encrypted;
+
+		EncryptedDescriptor data;
+		if (stream.status() != QDataStream::Ok || !decryptLocal(data, encrypted)) {
+			LOG(("App Error: bad map journal record at %1, skipping the rest.").arg(valid));
+			return result;
+		}
+		result.append(data.data.constData() + sizeof(uint32), data.data.size() - int(sizeof(uint32)));
+		valid = f.pos();
+	}
+	appendAt = valid;
+	return result;
+}
+
+void _writeVoiceWaveforms(WriteMapWhen when = WriteMapSoon) {
+	if (when != WriteMapNow) {
+		_manager->writeVoiceWaveforms(when == WriteMapFast);
+		return;
+	}
+	if (!_working()) return;
+
+	_manager->writingVoiceWaveforms();
+	if (_voiceWaveforms.isEmpty()) {
+		if (_voiceWaveformsKey) {
+			clearKey(_voiceWaveformsKey);
+			_voiceWaveformsKey = 0;
+			_mapChanged = true;
+			_writeMap();
+		}
+		return;
+	}
+	if (!_voiceWaveformsKey) {
+		_voiceWaveformsKey = genKey();
+		_mapChanged = true;
+		_writeMap(WriteMapFast);
+	}
+	quint32 size = sizeof(quint32);
+	for (auto i = _voiceWaveforms.cbegin(), e = _voiceWaveforms.cend(); i != e; ++i) {
+		size += sizeof(quint64) + sizeof(quint32) + i.value().size();
+	}
+	EncryptedDescriptor data(size);
+	data.stream << quint32(_voiceWaveformsOrder.size());
+	for_const (auto id, _voiceWaveformsOrder) {
+		auto &waveform = _voiceWaveforms[id];
+		data.stream << quint64(id) << QByteArray::fromRawData(waveform.constData(), waveform.size());
+	}
+	FileWriteDescriptor file(_voiceWaveformsKey);
+	file.writeEncrypted(data);
+}
+
+void _readVoiceWaveforms() {
+	if (_voiceWaveformsWereRead) return;
+	_voiceWaveformsWereRead = true;
+
+	if (!_voiceWaveformsKey) return;
+
+	FileReadDescriptor waveforms;
+	if (!readEncryptedFile(waveforms, _voiceWaveformsKey)) {
+		clearKey(_voiceWaveformsKey);
+		_voiceWaveformsKey = 0;
+		_writeMap();
+		return;
+	}
+
+	quint32 count = 0;
+	waveforms.stream >> count;
+	for (quint32 i = 0; i < count; ++i) {
+		quint64 id = 0;
+		QByteArray bytes;
+		waveforms.stream >> id >> bytes;
+		if (!_checkStreamStatus(waveforms.stream)) {
+			_voiceWaveforms.clear();
+			_voiceWaveformsOrder.clear();
+			return;
+		}
+		if (bytes.isEmpty() || _voiceWaveforms.contains(id)) continue;
+
+		VoiceWaveform waveform(bytes.size());
+		memcpy(waveform.data(), bytes.constData(), bytes.size());
+		_voiceWaveforms.insert(id, waveform);
+		_voiceWaveformsOrder.push_back(id);
+	}
+}
+
+void _rememberVoiceWaveform(DocumentId id, const VoiceWaveform &waveform) {
+	if (!_working()) return;
+
+	_readVoiceWaveforms();
+	if (_voiceWaveforms.contains(id)) return;
+
+	_voiceWaveforms.insert(id, waveform);
+	_voiceWaveformsOrder.push_back(id);
+	while (_voiceWaveformsOrder.size() > WaveformsCacheLimit) {
+		_voiceWaveforms.remove(_voiceWaveformsOrder.takeFirst());
+	}
+	_writeVoiceWaveforms();
+}
+
+void _writeInlineBotResults(WriteMapWhen when = WriteMapSoon) {
+	if (when != WriteMapNow) {
+		_manager->writeInlineBotResults(when == WriteMapFast);
+		return;
+	}
+	if (!_working()) return;
+
+	_manager->writingInlineBotResults();
+	if (base::take(_inlineBotResultsChanged) && _inlineBotResultsSerializer) {
+		_inlineBotResults = _inlineBotResultsSerializer();
+	}
+	if (_inlineBotResults.isEmpty()) {
+		if (_inlineBotResultsKey) {
+			clearKey(_inlineBotResultsKey);
+			_inlineBotResultsKey = 0;
+			_mapChanged = true;
+			_writeMap();
+		}
+		return;
+	}
+	if (!_inlineBotResultsKey) {
+		_inlineBotResultsKey = genKey();
+		_mapChanged = true;
+		_writeMap(WriteMapFast);
+	}
+	EncryptedDescriptor data(sizeof(quint32) + _inlineBotResults.size());
+	data.stream << _inlineBotResults;
+	FileWriteDescriptor file(_inlineBotResultsKey);
+	file.writeEncrypted(data);
+}
+
 void _writeLocations(WriteMapWhen when = WriteMapSoon) {
 	if (when != WriteMapNow) {
 		_manager->writeLocations(when == WriteMapFast);
@@ -1015,6 +1553,22 @@ bool _readSetting(quint32 blockId, QDataStream &stream, int version) {
 		Global::SetNotificationsCount((v > 0 ? v : 3));
 	} break;
 
+	case dbiLocalStorageLimit: {
+		qint32 v;
+		stream >> v;
+		if (!_checkStreamStatus(stream)) return false;
+
+		Global::SetLocalStorageLimit(int64(qMax(v, 0)) * 1024 * 1024);
+	} break;
+
+	case dbiMessagesMemoryLimit: {
+		qint32 v;
+		stream >> v;
+		if (!_checkStreamStatus(stream)) return false;
+
+		Global::SetMessagesMemoryLimit(int64(qMax(v, 0)) * 1024 * 1024);
+	} break;
+
 	case dbiNotificationsCorner: {
 		qint32 v;
 		stream >> v;
@@ -1596,7 +2150,7 @@ void _writeUserSettings() {
 		_writeMap(WriteMapFast);
 	}
 
-	uint32 size = 20 * (sizeof(quint32) + sizeof(qint32));
+	uint32 size = 22 * (sizeof(quint32) + sizeof(qint32));
 	size += sizeof(quint32) + Serialize::stringSize(Global::AskDownloadPath() ? QString() : Global::DownloadPath()) + Serialize::bytearraySize(Global::AskDownloadPath() ? QByteArray() : Global::DownloadPathBookmark());
 	size += sizeof(quint32) + sizeof(qint32) + (cRecentEmojisPreload().isEmpty() ? cGetRecentEmojis().size() : cRecentEmojisPreload().size()) * (sizeof(uint64) + sizeof(ushort));
 	size += sizeof(quint32) + sizeof(qint32) + cEmojiVariants().size() * (sizeof(uint32) + sizeof(uint64));
@@ -1633,6 +2187,8 @@ void _writeUserSettings() {
 	data.stream << quint32(dbiDialogsMode) << qint32(Global::DialogsModeEnabled() ? 1 : 0) << static_cast<qint32>(Global::DialogsMode());
 	data.stream << quint32(dbiModerateMode) << qint32(Global::ModerateModeEnabled() ? 1 : 0);
 	data.stream << quint32(dbiAutoPlay) << qint32(cAutoPlayGif() ? 1 : 0);
+	data.stream << quint32(dbiLocalStorageLimit) << qint32(Global::LocalStorageLimit() / (1024 * 1024));
+	data.stream << quint32(dbiMessagesMemoryLimit) << qint32(Global::MessagesMemoryLimit() / (1024 * 1024));
 
 	{
 		RecentEmojisPreload v(cRecentEmojisPreload());
@@ -1737,6 +2293,7 @@ void _readMtpData() {
 }
 
 ReadMapState _readMap(const QByteArray &pass) {
+	StartupProfiler::Phase readMapPhase("Local::readMap");
 	uint64 ms = getms();
 	QByteArray dataNameUtf8 = (cDataFile() + (cTestMode() ? qsl(":/test/") : QString())).toUtf8();
 	FileKey dataNameHash[2];
@@ -1760,7 +2317,10 @@ ReadMapState _readMap(const QByteArray &pass) {
 		LOG(("App Error: bad salt in map file, size: %1").arg(salt.size()));
 		return ReadMapFailed;
 	}
-	createLocalKey(pass, &salt, &_passKey);
+	{
+		StartupProfiler::Phase phase("Local::createLocalKey");
+		createLocalKey(pass, &salt, &_passKey);
+	}
 
 	EncryptedDescriptor keyData, map;
 	if (!decryptLocal(keyData, keyEncrypted, _passKey)) {
@@ -1785,13 +2345,16 @@ ReadMapState _readMap(const QByteArray &pass) {
 
 	DraftsMap draftsMap, draftCursorsMap;
 	DraftsNotReadMap draftsNotReadMap;
-	StorageMap imagesMap, stickerImagesMap, audiosMap;
-	qint64 storageImagesSize = 0, storageStickersSize = 0, storageAudiosSize = 0;
+	QByteArray storageMapsSections;
+	QDataStream storageMapsStream(&storageMapsSections, QIODevice::WriteOnly);
+	storageMapsStream.setVersion(QDataStream::Qt_5_1);
 	quint64 locationsKey = 0, reportSpamStatusesKey = 0, trustedBotsKey = 0;
 	quint64 recentStickersKeyOld = 0;
 	quint64 installedStickersKey = 0, featuredStickersKey = 0, recentStickersKey = 0, archivedStickersKey = 0;
 	quint64 savedGifsKey = 0;
 	quint64 backgroundKey = 0, userSettingsKey = 0, recentHashtagsAndBotsKey = 0, savedPeersKey = 0;
+	quint64 voiceWaveformsKey = 0, inlineBotResultsKey = 0;
+	quint64 mapJournalId = 0;
 	while (!map.stream.atEnd()) {
 		quint32 keyType;
 		map.stream >> keyType;
@@ -1817,41 +2380,23 @@ ReadMapState _readMap(const QByteArray &pass) {
 				draftCursorsMap.insert(p, key);
 			}
 		} break;
-		case lskImages: {
+		case lskImages:
+		case lskStickerImages:
+		case lskAudios:
+		case lskClipSidecars: {
 			quint32 count = 0;
 			map.stream >> count;
-			for (quint32 i = 0; i < count; ++i) {
-				FileKey key;
-				quint64 first, second;
-				qint32 size;
-				map.stream >> key >> first >> second >> size;
-				imagesMap.insert(StorageKey(first, second), FileDesc(key, size));
-				storageImagesSize += size;
+			auto size = qint64(count) * kStorageMapEntrySize;
+			if (size > map.buffer.size() - map.buffer.pos()) {
+				LOG(("App Error: bad cache map size %1 for key type %2").arg(count).arg(keyType));
+				return ReadMapFailed;
 			}
-		} break;
-		case lskStickerImages: {
-			quint32 count = 0;
-			map.stream >> count;
-			for (quint32 i = 0; i < count; ++i) {
-				FileKey key;
-				quint64 first, second;
-				qint32 size;
-				map.stream >> key >> first >> second >> size;
-				stickerImagesMap.insert(StorageKey(first, second), FileDesc(key, size));
-				storageStickersSize += size;
-			}
-		} break;
-		case lskAudios: {
-			quint32 count = 0;
-			map.stream >> count;
-			for (quint32 i = 0; i < count; ++i) {
-				FileKey key;
-				quint64 first, second;
-				qint32 size;
-				map.stream >> key >> first >> second >> size;
-				audiosMap.insert(StorageKey(first, second), FileDesc(key, size));
-				storageAudiosSize += size;
+			QByteArray section(int(size), Qt::Uninitialized);
+			if (map.stream.readRawData(section.data(), section.size()) != section.size()) {
+				return ReadMapFailed;
 			}
+			storageMapsStream << keyType << count;
+			storageMapsStream.writeRawData(section.constData(), section.size());
 		} break;
 		case lskLocations: {
 			map.stream >> locationsKey;
@@ -1874,6 +2419,12 @@ ReadMapState _readMap(const QByteArray &pass) {
 		case lskRecentHashtagsAndBots: {
 			map.stream >> recentHashtagsAndBotsKey;
 		} break;
+		case lskVoiceWaveforms: {
+			map.stream >> voiceWaveformsKey;
+		} break;
+		case lskInlineBotResults: {
+			map.stream >> inlineBotResultsKey;
+		} break;
 		case lskStickersOld: {
 			map.stream >> installedStickersKey;
 		} break;
@@ -1890,6 +2441,9 @@ ReadMapState _readMap(const QByteArray &pass) {
 		case lskSavedPeers: {
 			map.stream >> savedPeersKey;
 		} break;
+		case lskMapJournal: {
+			map.stream >> mapJournalId;
+		} break;
 		default:
 		LOG(("App Error: unknown key type in encrypted map: %1").arg(keyType));
 		return ReadMapFailed;
@@ -1903,12 +2457,12 @@ ReadMapState _readMap(const QByteArray &pass) {
 	_draftCursorsMap = draftCursorsMap;
 	_draftsNotReadMap = draftsNotReadMap;
 
-	_imagesMap = imagesMap;
-	_storageImagesSize = storageImagesSize;
-	_stickerImagesMap = stickerImagesMap;
-	_storageStickersSize = storageStickersSize;
-	_audiosMap = audiosMap;
-	_storageAudiosSize = storageAudiosSize;
+	qint64 mapJournalSize = -1;
+	auto mapJournal = mapJournalId ? _readMapJournal(mapJournalId, mapJournalSize) : QByteArray();
+	_startParsingStorageMaps(storageMapsSections, mapJournal);
+	_mapJournalId = mapJournalId;
+	_mapJournalSize = mapJournalSize;
+	_mapSize = map.data.size();
 
 	_locationsKey = locationsKey;
 	_reportSpamStatusesKey = reportSpamStatusesKey;
@@ -1923,7 +2477,24 @@ ReadMapState _readMap(const QByteArray &pass) {
 	_backgroundKey = backgroundKey;
 	_userSettingsKey = userSettingsKey;
 	_recentHashtagsAndBotsKey = recentHashtagsAndBotsKey;
+	_voiceWaveformsKey = voiceWaveformsKey;
+	_inlineBotResultsKey = inlineBotResultsKey;
 	_oldMapVersion = mapData.version;
+
+	// The order is the order in which the files are needed.
+	_prefetchFile("Local::prefetchLocations", _locationsKey);
+	_prefetchFile("Local::prefetchReportSpamStatuses", _reportSpamStatusesKey);
+	_prefetchFile("Local::prefetchUserSettings", _userSettingsKey);
+	_prefetchFile("Local::prefetchMtpData", toFilePart(_dataNameKey), SafePath);
+	_prefetchFile("Local::prefetchVoiceWaveforms", _voiceWaveformsKey);
+	_prefetchFile("Local::prefetchSavedPeers", _savedPeersKey);
+	_prefetchFile("Local::prefetchInstalledStickers", _installedStickersKey);
+	_prefetchFile("Local::prefetchFeaturedStickers", _featuredStickersKey);
+	_prefetchFile("Local::prefetchRecentStickers", _recentStickersKey);
+	_prefetchFile("Local::prefetchSavedGifs", _savedGifsKey);
+	_prefetchFile("Local::prefetchTrustedBots", _trustedBotsKey);
+	_prefetchFile("Local::prefetchRecentHashtagsAndBots", _recentHashtagsAndBotsKey);
+
 	if (_oldMapVersion < AppVersion) {
 		_mapChanged = true;
 		_writeMap();
@@ -1938,8 +2509,21 @@ ReadMapState _readMap(const QByteArray &pass) {
 		_readReportSpamStatuses();
 	}
 
-	_readUserSettings();
-	_readMtpData();
+	{
+		StartupProfiler::Phase phase("Local::readUserSettings");
+		_readUserSettings();
+	}
+	{
+		StartupProfiler::Phase phase("Local::readMtpData");
+		_readMtpData();
+	}
+	{
+		// Voice messages look up their remembered waveforms while painting.
+		StartupProfiler::Phase phase("Local::readVoiceWaveforms");
+		_readVoiceWaveforms();
+	}
+
+	checkStorageLimit();
 
 	LOG(("Map read time: %1").arg(getms() - ms));
 	if (_oldSettingsVersion < AppVersion) {
@@ -1954,7 +2538,11 @@ void _writeMap(WriteMapWhen when) {
 		return;
 	}
 	_manager->writingMap();
-	if (!_mapChanged) return;
+	if (!_mapChanged) {
+		if (_mapJournalPending.isEmpty() || _appendMapJournal()) return;
+		_mapChanged = true;
+	}
+	_readStorageMaps();
 	if (_userBasePath.isEmpty()) {
 		LOG(("App Error: _userBasePath is empty in writeMap()"));
 		return;
@@ -1987,6 +2575,7 @@ void _writeMap(WriteMapWhen when) {
 	if (!_imagesMap.isEmpty()) mapSize += sizeof(quint32) * 2 + _imagesMap.size() * (sizeof(quint64) * 3 + sizeof(qint32));
 	if (!_stickerImagesMap.isEmpty()) mapSize += sizeof(quint32) * 2 + _stickerImagesMap.size() * (sizeof(quint64) * 3 + sizeof(qint32));
 	if (!_audiosMap.isEmpty()) mapSize += sizeof(quint32) * 2 + _audiosMap.size() * (sizeof(quint64) * 3 + sizeof(qint32));
+	if (!_clipSidecarsMap.isEmpty()) mapSize += sizeof(quint32) * 2 + _clipSidecarsMap.size() * (sizeof(quint64) * 3 + sizeof(qint32));
 	if (_locationsKey) mapSize += sizeof(quint32) + sizeof(quint64);
 	if (_reportSpamStatusesKey) mapSize += sizeof(quint32) + sizeof(quint64);
 	if (_trustedBotsKey) mapSize += sizeof(quint32) + sizeof(quint64);
@@ -1999,6 +2588,9 @@ void _writeMap(WriteMapWhen when) {
 	if (_backgroundKey) mapSize += sizeof(quint32) + sizeof(quint64);
 	if (_userSettingsKey) mapSize += sizeof(quint32) + sizeof(quint64);
 	if (_recentHashtagsAndBotsKey) mapSize += sizeof(quint32) + sizeof(quint64);
+	if (_voiceWaveformsKey) mapSize += sizeof(quint32) + sizeof(quint64);
+	if (_inlineBotResultsKey) mapSize += sizeof(quint32) + sizeof(quint64);
+	mapSize += sizeof(quint32) + sizeof(quint64);
 	EncryptedDescriptor mapData(mapSize);
 	if (!_draftsMap.isEmpty()) {
 		mapData.stream << quint32(lskDraft) << quint32(_draftsMap.size());
@@ -2030,6 +2622,12 @@ void _writeMap(WriteMapWhen when) {
 			mapData.stream << quint64(i.value().first) << quint64(i.key().first) << quint64(i.key().second) << qint32(i.value().second);
 		}
 	}
+	if (!_clipSidecarsMap.isEmpty()) {
+		mapData.stream << quint32(lskClipSidecars) << quint32(_clipSidecarsMap.size());
+		for (auto i = _clipSidecarsMap.cbegin(), e = _clipSidecarsMap.cend(); i != e; ++i) {
+			mapData.stream << quint64(i.value().first) << quint64(i.key().first) << quint64(i.key().second) << qint32(i.value().second);
+		}
+	}
 	if (_locationsKey) {
 		mapData.stream << quint32(lskLocations) << quint64(_locationsKey);
 	}
@@ -2061,8 +2659,24 @@ void _writeMap(WriteMapWhen when) {
 	if (_recentHashtagsAndBotsKey) {
 		mapData.stream << quint32(lskRecentHashtagsAndBots) << quint64(_recentHashtagsAndBotsKey);
 	}
-	map.writeEncrypted(mapData);
+	if (_voiceWaveformsKey) {
+		mapData.stream << quint32(lskVoiceWaveforms) << quint64(_voiceWaveformsKey);
+	}
+	if (_inlineBotResultsKey) {
+		mapData.stream << quint32(lskInlineBotResults) << quint64(_inlineBotResultsKey);
+	}
+	auto mapJournalId = rand_value<quint64>();
+	mapData.stream << quint32(lskMapJournal) << quint64(mapJournalId);
+	auto written = map.writeEncrypted(mapData);
+	map.finish();
 
+	_mapSize = mapSize;
+	if (written) {
+		_startMapJournal(mapJournalId);
+	} else {
+		_mapJournalSize = -1;
+		_mapJournalPending.clear();
+	}
 	_mapChanged = false;
 }
 
@@ -2076,6 +2690,15 @@ void finish() {
 		_manager = 0;
 		delete _localLoader;
 		_localLoader = 0;
+		for_const (auto counter, _waveformCounters) {
+			delete counter;
+		}
+		_waveformCounters.clear();
+		for_const (auto prefetcher, _prefetchers) {
+			delete prefetcher;
+		}
+		_prefetchers.clear();
+		_storageMapsParsing = false;
 	}
 }
 
@@ -2084,6 +2707,14 @@ void start() {
 
 	_manager = new internal::Manager();
 	_localLoader = new TaskQueue(0, FileLoaderQueueStopTimeout);
+	auto waveformCountersCount = qMax(qMin(QThread::idealThreadCount() - 1, int(WaveformCountThreadsLimit)), 1);
+	for (auto i = 0; i != waveformCountersCount; ++i) {
+		_waveformCounters.push_back(new TaskQueue(0, FileLoaderQueueStopTimeout));
+	}
+	auto prefetchersCount = qMax(qMin(QThread::idealThreadCount(), int(LocalPrefetchThreadsLimit)), 1);
+	for (auto i = 0; i != prefetchersCount; ++i) {
+		_prefetchers.push_back(new TaskQueue(0, FileLoaderQueueStopTimeout));
+	}
 
 	_basePath = cWorkingDir() + qsl("tdata/");
 	if (!QDir().exists(_basePath)) QDir().mkpath(_basePath);
@@ -2261,6 +2892,18 @@ void reset() {
 	if (_localLoader) {
 		_localLoader->stop();
 	}
+	for_const (auto counter, _waveformCounters) {
+		counter->stop();
+	}
+	for_const (auto prefetcher, _prefetchers) {
+		prefetcher->stop();
+	}
+	{
+		QMutexLocker lock(&_prefetchMutex);
+		_prefetchedFiles.clear();
+		_parsedStorageMaps = StorageMaps();
+	}
+	_storageMapsParsing = false;
 
 	_passKeySalt.clear(); // reset passcode, local key
 	_draftsMap.clear();
@@ -2272,7 +2915,8 @@ void reset() {
 	_draftsNotReadMap.clear();
 	_stickerImagesMap.clear();
 	_audiosMap.clear();
-	_storageImagesSize = _storageStickersSize = _storageAudiosSize = 0;
+	_clipSidecarsMap.clear();
+	_storageImagesSize = _storageStickersSize = _storageAudiosSize = _storageClipSidecarsSize = 0;
 	_webFilesMap.clear();
 	_storageWebFilesSize = 0;
 	_locationsKey = _reportSpamStatusesKey = _trustedBotsKey = 0;
@@ -2280,7 +2924,18 @@ void reset() {
 	_installedStickersKey = _featuredStickersKey = _recentStickersKey = _archivedStickersKey = 0;
 	_savedGifsKey = 0;
 	_backgroundKey = _userSettingsKey = _recentHashtagsAndBotsKey = _savedPeersKey = 0;
+	_voiceWaveformsKey = 0;
+	_voiceWaveformsWereRead = false;
+	_voiceWaveforms.clear();
+	_voiceWaveformsOrder.clear();
+	_inlineBotResultsKey = 0;
+	_inlineBotResultsWereRead = false;
+	_inlineBotResults.clear();
+	_inlineBotResultsChanged = false;
 	_oldMapVersion = _oldSettingsVersion = 0;
+	_mapJournalId = 0;
+	_mapJournalSize = -1;
+	_mapJournalPending.clear();
 	_mapChanged = true;
 	_writeMap(WriteMapNow);
 
@@ -2580,6 +3235,7 @@ qint32 _storageAudioSize(qint32 rawlen) {
 }
 
 void writeImage(const StorageKey &location, const ImagePtr &image) {
+	_readStorageMaps();
 	if (image->isNull() || !image->loaded()) return;
 	if (_imagesMap.constFind(location) != _imagesMap.cend()) return;
 
@@ -2599,6 +3255,7 @@ void writeImage(const StorageKey &location, const ImagePtr &image) {
 }
 
 void writeImage(const StorageKey &location, const StorageImageSaved &image, bool overwrite) {
+	_readStorageMaps();
 	if (!_working()) return;
 
 	qint32 size = _storageImageSize(image.data.size());
@@ -2606,8 +3263,9 @@ void writeImage(const StorageKey &location, const StorageImageSaved &image, bool
 	if (i == _imagesMap.cend()) {
 		i = _imagesMap.insert(location, FileDesc(genKey(UserPath), size));
 		_storageImagesSize += size;
-		_mapChanged = true;
+		_journalMapInsert(lskImages, location, i.value());
 		_writeMap();
+		checkStorageLimit();
 	} else if (!overwrite) {
 		return;
 	}
@@ -2704,11 +3362,14 @@ public:
 			clearKey(_key, UserPath);
 			_storageImagesSize -= j->second;
 			_imagesMap.erase(j);
+			_journalMapRemove(lskImages, _location);
+			_writeMap();
 		}
 	}
 };
 
 TaskId startImageLoad(const StorageKey &location, mtpFileLoader *loader) {
+	_readStorageMaps();
 	StorageMap::const_iterator j = _imagesMap.constFind(location);
 	if (j == _imagesMap.cend() || !_localLoader) {
 		return 0;
@@ -2717,14 +3378,17 @@ TaskId startImageLoad(const StorageKey &location, mtpFileLoader *loader) {
 }
 
 int32 hasImages() {
+	_readStorageMaps();
 	return _imagesMap.size();
 }
 
 qint64 storageImagesSize() {
+	_readStorageMaps();
 	return _storageImagesSize;
 }
 
 void writeStickerImage(const StorageKey &location, const QByteArray &sticker, bool overwrite) {
+	_readStorageMaps();
 	if (!_working()) return;
 
 	qint32 size = _storageStickerSize(sticker.size());
@@ -2732,8 +3396,9 @@ void writeStickerImage(const StorageKey &location, const QByteArray &sticker, bo
 	if (i == _stickerImagesMap.cend()) {
 		i = _stickerImagesMap.insert(location, FileDesc(genKey(UserPath), size));
 		_storageStickersSize += size;
-		_mapChanged = true;
+		_journalMapInsert(lskStickerImages, location, i.value());
 		_writeMap();
+		checkStorageLimit();
 	} else if (!overwrite) {
 		return;
 	}
@@ -2763,11 +3428,14 @@ public:
 			clearKey(j.value().first, UserPath);
 			_storageStickersSize -= j.value().second;
 			_stickerImagesMap.erase(j);
+			_journalMapRemove(lskStickerImages, _location);
+			_writeMap();
 		}
 	}
 };
 
 TaskId startStickerImageLoad(const StorageKey &location, mtpFileLoader *loader) {
+	_readStorageMaps();
 	auto j = _stickerImagesMap.constFind(location);
 	if (j == _stickerImagesMap.cend() || !_localLoader) {
 		return 0;
@@ -2776,29 +3444,34 @@ TaskId startStickerImageLoad(const StorageKey &location, mtpFileLoader *loader)
 }
 
 bool willStickerImageLoad(const StorageKey &location) {
+	_readStorageMaps();
 	return _stickerImagesMap.constFind(location) != _stickerImagesMap.cend();
 }
 
 bool copyStickerImage(const StorageKey &oldLocation, const StorageKey &newLocation) {
+	_readStorageMaps();
 	auto i = _stickerImagesMap.constFind(oldLocation);
 	if (i == _stickerImagesMap.cend()) {
 		return false;
 	}
 	_stickerImagesMap.insert(newLocation, i.value());
-	_mapChanged = true;
+	_journalMapInsert(lskStickerImages, newLocation, i.value());
 	_writeMap();
 	return true;
 }
 
 int32 hasStickers() {
+	_readStorageMaps();
 	return _stickerImagesMap.size();
 }
 
 qint64 storageStickersSize() {
+	_readStorageMaps();
 	return _storageStickersSize;
 }
 
 void writeAudio(const StorageKey &location, const QByteArray &audio, bool overwrite) {
+	_readStorageMaps();
 	if (!_working()) return;
 
 	qint32 size = _storageAudioSize(audio.size());
@@ -2806,8 +3479,9 @@ void writeAudio(const StorageKey &location, const QByteArray &audio, bool overwr
 	if (i == _audiosMap.cend()) {
 		i = _audiosMap.insert(location, FileDesc(genKey(UserPath), size));
 		_storageAudiosSize += size;
-		_mapChanged = true;
+		_journalMapInsert(lskAudios, location, i.value());
 		_writeMap();
+		checkStorageLimit();
 	} else if (!overwrite) {
 		return;
 	}
@@ -2837,11 +3511,14 @@ public:
 			clearKey(j.value().first, UserPath);
 			_storageAudiosSize -= j.value().second;
 			_audiosMap.erase(j);
+			_journalMapRemove(lskAudios, _location);
+			_writeMap();
 		}
 	}
 };
 
 TaskId startAudioLoad(const StorageKey &location, mtpFileLoader *loader) {
+	_readStorageMaps();
 	auto j = _audiosMap.constFind(location);
 	if (j == _audiosMap.cend() || !_localLoader) {
 		return 0;
@@ -2850,24 +3527,86 @@ TaskId startAudioLoad(const StorageKey &location, mtpFileLoader *loader) {
 }
 
 bool copyAudio(const StorageKey &oldLocation, const StorageKey &newLocation) {
+	_readStorageMaps();
 	auto i = _audiosMap.constFind(oldLocation);
 	if (i == _audiosMap.cend()) {
 		return false;
 	}
 	_audiosMap.insert(newLocation, i.value());
-	_mapChanged = true;
+	_journalMapInsert(lskAudios, newLocation, i.value());
 	_writeMap();
 	return true;
 }
 
 int32 hasAudios() {
+	_readStorageMaps();
 	return _audiosMap.size();
 }
 
 qint64 storageAudiosSize() {
+	_readStorageMaps();
 	return _storageAudiosSize;
 }
 
+qint32 _storageClipSidecarSize(qint32 rawlen) {
+	// fulllen + storagekey + len + data
+	qint32 result = sizeof(uint32) + sizeof(quint64) * 2 + sizeof(quint32) + rawlen;
+	if (result & 0x0F) result += 0x10 - (result & 0x0F);
+	result += tdfMagicLen + sizeof(qint32) + sizeof(quint32) + 0x10 + 0x10; // magic + version + len of encrypted + part of sha1 + md5
+	return result;
+}
+
+void writeClipSidecar(const StorageKey &location, const QByteArray &sidecar) {
+	_readStorageMaps();
+	if (!_working()) return;
+
+	qint32 size = _storageClipSidecarSize(sidecar.size());
+	auto i = _clipSidecarsMap.constFind(location);
+	if (i == _clipSidecarsMap.cend()) {
+		i = _clipSidecarsMap.insert(location, FileDesc(genKey(UserPath), size));
+		_storageClipSidecarsSize += size;
+		_journalMapInsert(lskClipSidecars, location, i.value());
+		_writeMap();
+	}
+	EncryptedDescriptor data(sizeof(quint64) * 2 + sizeof(quint32) + sidecar.size());
+	data.stream << quint64(location.first) << quint64(location.second) << sidecar;
+	FileWriteDescriptor file(i.value().first, UserPath);
+	file.writeEncrypted(data);
+	if (i.value().second != size) {
+		_storageClipSidecarsSize += size;
+		_storageClipSidecarsSize -= i.value().second;
+		_clipSidecarsMap[location].second = size;
+	}
+}
+
+ClipSidecarFile clipSidecarFile(const StorageKey &location) {
+	_readStorageMaps();
+	auto result = ClipSidecarFile();
+	auto i = _clipSidecarsMap.constFind(location);
+	if (i != _clipSidecarsMap.cend() && _userWorking()) {
+		result._name = toFilePart(i.value().first);
+		result._basePath = _userBasePath;
+		result._key = _localKey;
+	}
+	return result;
+}
+
+QByteArray ClipSidecarFile::read() const {
+	// A broken file is not removed here, the reader will write a new sidecar over it.
+	FileReadDescriptor sidecar;
+	if (!_readFileAt(sidecar, _basePath, _name, UserPath | SafePath, false) || !_decryptFile(sidecar, _key)) {
+		return QByteArray();
+	}
+
+	quint64 first, second;
+	QByteArray result;
+	sidecar.stream >> first >> second >> result;
+	if (sidecar.stream.status() != QDataStream::Ok) {
+		return QByteArray();
+	}
+	return result;
+}
+
 qint32 _storageWebFileSize(const QString &url, qint32 rawlen) {
 	// fulllen + url + len + data
 	qint32 result = sizeof(uint32) + Serialize::stringSize(url) + sizeof(quint32) + rawlen;
@@ -2885,6 +3624,7 @@ void writeWebFile(const QString &url, const QByteArray &content, bool overwrite)
 		i = _webFilesMap.insert(url, FileDesc(genKey(UserPath), size));
 		_storageWebFilesSize += size;
 		_writeLocations();
+		checkStorageLimit();
 	} else if (!overwrite) {
 		return;
 	}
@@ -2999,6 +3739,7 @@ public:
 			if (!_waveform.isEmpty()) {
 				voice->waveform = _waveform;
 				voice->wavemax = _wavemax;
+				_rememberVoiceWaveform(_doc->id, _waveform);
 			}
 			if (voice->waveform.isEmpty()) {
 				voice->waveform.resize(1);
@@ -3034,10 +3775,21 @@ protected:
 
 void countVoiceWaveform(DocumentData *document) {
 	if (VoiceData *voice = document->voice()) {
-		if (_localLoader) {
+		if (_working()) {
+			auto i = _voiceWaveforms.constFind(document->id);
+			if (i != _voiceWaveforms.cend()) {
+				voice->waveform = i.value();
+				voice->wavemax = *std::max_element(voice->waveform.cbegin(), voice->waveform.cend());
+				return;
+			}
+		}
+		if (!_waveformCounters.isEmpty()) {
+			auto counter = _waveformCounters[_waveformCounterIndex];
+			_waveformCounterIndex = (_waveformCounterIndex + 1) % _waveformCounters.size();
+
 			voice->waveform.resize(1 + sizeof(TaskId));
 			voice->waveform[0] = -1; // counting
-			TaskId taskId = _localLoader->addTask(new CountWaveformTask(document));
+			TaskId taskId = counter->addTask(new CountWaveformTask(document));
 			memcpy(voice->waveform.data() + 1, &taskId, sizeof(taskId));
 		}
 	}
@@ -3047,6 +3799,9 @@ void cancelTask(TaskId id) {
 	if (_localLoader) {
 		_localLoader->cancelTask(id);
 	}
+	for_const (auto counter, _waveformCounters) {
+		counter->cancelTask(id);
+	}
 }
 
 void _writeStickerSet(QDataStream &stream, const Stickers::Set &set) {
@@ -3299,6 +4054,8 @@ void _readStickerSets(FileKey &stickersKey, Stickers::Order *outOrder = nullptr,
 void writeInstalledStickers() {
 	if (!Global::started()) return;
 
+	Stickers::refreshEmojiIndex();
+
 	_writeStickerSets(_installedStickersKey, [](const Stickers::Set &set) {
 		if (set.id == Stickers::CloudRecentSetId) { // separate file for recent
 			return StickerSetCheckResult::Skip;
@@ -3442,6 +4199,7 @@ void readInstalledStickers() {
 
 	Global::RefStickerSets().clear();
 	_readStickerSets(_installedStickersKey, &Global::RefStickerSetsOrder(), qFlags(MTPDstickerSet::Flag::f_installed));
+	Stickers::refreshEmojiIndex();
 }
 
 void readFeaturedStickers() {
@@ -3591,13 +4349,21 @@ void readSavedGifs() {
 	}
 }
 
-void writeBackground(int32 id, const QImage &img) {
+void writeBackground(int32 id, const QImage &img, const QVector<QImage> &mips) {
 	if (!_working()) return;
 
 	QByteArray png;
+	QList<QByteArray> mipsData;
 	if (!img.isNull()) {
 		QBuffer buf(&png);
 		if (!img.save(&buf, "BMP")) return;
+
+		for_const (auto &mip, mips) {
+			QByteArray mipData;
+			QBuffer mipBuf(&mipData);
+			if (!mip.save(&mipBuf, "BMP")) return;
+			mipsData.push_back(mipData);
+		}
 	}
 	if (!_backgroundKey) {
 		_backgroundKey = genKey();
@@ -3605,9 +4371,21 @@ void writeBackground(int32 id, const QImage &img) {
 		_writeMap(WriteMapFast);
 	}
 	quint32 size = sizeof(qint32) + sizeof(quint32) + (png.isEmpty() ? 0 : (sizeof(quint32) + png.size()));
+	if (!png.isEmpty()) {
+		size += sizeof(quint32);
+		for_const (auto &mipData, mipsData) {
+			size += sizeof(quint32) + mipData.size();
+		}
+	}
 	EncryptedDescriptor data(size);
 	data.stream << qint32(id);
-	if (!png.isEmpty()) data.stream << png;
+	if (!png.isEmpty()) {
+		data.stream << png;
+		data.stream << quint32(mipsData.size());
+		for_const (auto &mipData, mipsData) {
+			data.stream << mipData;
+		}
+	}
 
 	FileWriteDescriptor file(_backgroundKey);
 	file.writeEncrypted(data);
@@ -3639,6 +4417,26 @@ bool readBackground() {
 	}
 	bg.stream >> pngData;
 
+	// mips are checked against the image in App::initBackground()
+	// and prepared again if they are missing or don't fit
+	QVector<QImage> mips;
+	if (!bg.stream.atEnd()) {
+		quint32 mipsCount = 0;
+		bg.stream >> mipsCount;
+		for (quint32 i = 0; i < mipsCount && bg.stream.status() == QDataStream::Ok; ++i) {
+			QByteArray mipData;
+			bg.stream >> mipData;
+
+			QImage mip;
+			if (!mip.loadFromData(mipData, "BMP")) {
+				mips.clear();
+				break;
+			}
+			mip.setDevicePixelRatio(cRetinaFactor());
+			mips.push_back(mip);
+		}
+	}
+
 	QImage img;
 	QBuffer buf(&pngData);
 	QImageReader reader(&buf);
@@ -3646,7 +4444,7 @@ bool readBackground() {
 	reader.setAutoTransform(true);
 #endif // OS_MAC_OLD
 	if (reader.read(&img)) {
-		App::initBackground(id, img, true);
+		App::initBackground(id, img, true, mips);
 		return true;
 	}
 	return false;
@@ -4078,6 +4876,47 @@ void readTrustedBots() {
 	}
 }
 
+void setInlineBotResultsSerializer(base::lambda_unique<QByteArray()> &&serializer) {
+	if (_inlineBotResultsChanged && _inlineBotResultsSerializer) {
+		// the owner of the cache can be destroyed before the write timer fires
+		_inlineBotResults = _inlineBotResultsSerializer();
+		_inlineBotResultsChanged = false;
+	}
+	_inlineBotResultsSerializer = std_::move(serializer);
+}
+
+void inlineBotResultsChanged() {
+	if (!_working()) return;
+
+	_inlineBotResultsWereRead = true;
+	_inlineBotResultsChanged = true;
+	_writeInlineBotResults();
+}
+
+QByteArray readInlineBotResults() {
+	if (!_working()) return QByteArray();
+	if (_inlineBotResultsWereRead) return _inlineBotResults;
+	_inlineBotResultsWereRead = true;
+
+	if (!_inlineBotResultsKey) return QByteArray();
+
+	FileReadDescriptor results;
+	if (!readEncryptedFile(results, _inlineBotResultsKey)) {
+		clearKey(_inlineBotResultsKey);
+		_inlineBotResultsKey = 0;
+		_writeMap();
+		return QByteArray();
+	}
+
+	QByteArray serialized;
+	results.stream >> serialized;
+	if (!_checkStreamStatus(results.stream)) {
+		return QByteArray();
+	}
+	_inlineBotResults = serialized;
+	return _inlineBotResults;
+}
+
 void makeBotTrusted(UserData *bot) {
 	if (!isBotTrusted(bot)) {
 		_trustedBots.insert(bot->id);
@@ -4109,21 +4948,84 @@ bool decrypt(const void *src, void *dst, uint32 len, const void *key128) {
 	return true;
 }
 
+void checkStorageLimit() {
+	if (_manager && Global::LocalStorageLimit() > 0) {
+		_manager->checkStorageLimit();
+	}
+}
+
+struct ClearManagerEntry {
+	int type = 0; // ClearManagerImages, ClearManagerStickers, ClearManagerAudios or ClearManagerWebFiles
+	quint32 keyType = 0; // storage map of the file, not used for web files
+	StorageKey location;
+	QString webFile;
+	FileDesc file;
+	TimeId modified = 0; // filled in the clear manager thread
+};
+
 struct ClearManagerData {
 	QThread *thread;
-	StorageMap images, stickers, audios;
-	WebFilesMap webFiles;
+	QVector<ClearManagerEntry> storage; // already removed from the storage maps
+	QVector<ClearManagerEntry> candidates; // checked by ClearManagerOld and ClearManagerQuota tasks
+	QVector<ClearManagerEntry> removed; // deleted candidates, still not removed from the storage maps
+	TimeId age = 0;
+	int64 limit = 0;
 	QMutex mutex;
 	QList<int> tasks;
 	bool working;
 };
 
+namespace {
+
+void _collectClearEntries(const StorageMap &map, int type, quint32 keyType, QVector<ClearManagerEntry> &result) {
+	result.reserve(result.size() + map.size());
+	for (auto i = map.cbegin(), e = map.cend(); i != e; ++i) {
+		ClearManagerEntry entry;
+		entry.type = type;
+		entry.keyType = keyType;
+		entry.location = i.key();
+		entry.file = i.value();
+		result.push_back(entry);
+	}
+}
+
+void _collectClearEntries(int types, QVector<ClearManagerEntry> &result) {
+	if (types & ClearManagerImages) {
+		_collectClearEntries(_imagesMap, ClearManagerImages, lskImages, result);
+		_collectClearEntries(_clipSidecarsMap, ClearManagerImages, lskClipSidecars, result);
+	}
+	if (types & ClearManagerStickers) {
+		_collectClearEntries(_stickerImagesMap, ClearManagerStickers, lskStickerImages, result);
+	}
+	if (types & ClearManagerAudios) {
+		_collectClearEntries(_audiosMap, ClearManagerAudios, lskAudios, result);
+	}
+	if (types & ClearManagerWebFiles) {
+		result.reserve(result.size() + _webFilesMap.size());
+		for (auto i = _webFilesMap.cbegin(), e = _webFilesMap.cend(); i != e; ++i) {
+			ClearManagerEntry entry;
+			entry.type = ClearManagerWebFiles;
+			entry.webFile = i.key();
+			entry.file = i.value();
+			result.push_back(entry);
+		}
+	}
+}
+
+TimeId _clearEntryModified(const ClearManagerEntry &entry) {
+	auto modified = QFileInfo(_userBasePath + toFilePart(entry.file.first) + '0').lastModified();
+	return modified.isValid() ? TimeId(modified.toTime_t()) : 0;
+}
+
+} // namespace
+
 ClearManager::ClearManager() : data(new ClearManagerData()) {
 	data->thread = new QThread();
 	data->working = true;
 }
 
-bool ClearManager::addTask(int task) {
+bool ClearManager::addTask(int task, TimeId age) {
+	_readStorageMaps();
 	QMutexLocker lock(&data->mutex);
 	if (!data->working) return false;
 
@@ -4145,6 +5047,11 @@ bool ClearManager::addTask(int task) {
 			_storageAudiosSize = 0;
 			_mapChanged = true;
 		}
+		if (!_clipSidecarsMap.isEmpty()) {
+			_clipSidecarsMap.clear();
+			_storageClipSidecarsSize = 0;
+			_mapChanged = true;
+		}
 		if (!_draftsMap.isEmpty()) {
 			_draftsMap.clear();
 			_mapChanged = true;
@@ -4181,73 +5088,59 @@ bool ClearManager::addTask(int task) {
 			_savedPeersKey = 0;
 			_mapChanged = true;
 		}
+		if (_voiceWaveformsKey) {
+			_voiceWaveformsKey = 0;
+			_mapChanged = true;
+		}
+		_voiceWaveforms.clear();
+		_voiceWaveformsOrder.clear();
+		if (_inlineBotResultsKey) {
+			_inlineBotResultsKey = 0;
+			_mapChanged = true;
+		}
+		_inlineBotResults.clear();
+		_inlineBotResultsChanged = false;
 		_writeMap();
 	} else {
-		if (task & ClearManagerStorage) {
-			if (data->images.isEmpty()) {
-				data->images = _imagesMap;
-			} else {
-				for (StorageMap::const_iterator i = _imagesMap.cbegin(), e = _imagesMap.cend(); i != e; ++i) {
-					StorageKey k = i.key();
-					while (data->images.constFind(k) != data->images.cend()) {
-						++k.second;
-					}
-					data->images.insert(k, i.value());
-				}
+		if (task & (ClearManagerOld | ClearManagerQuota)) {
+			// Files are removed from the storage maps in applyRemoved() after they are deleted.
+			data->candidates.clear();
+			_collectClearEntries(ClearManagerStorage, data->candidates);
+			if (task & ClearManagerOld) {
+				data->age = age;
 			}
-			if (!_imagesMap.isEmpty()) {
-				_imagesMap.clear();
-				_storageImagesSize = 0;
-				_mapChanged = true;
+			if (task & ClearManagerQuota) {
+				data->limit = Global::LocalStorageLimit();
 			}
-			if (data->stickers.isEmpty()) {
-				data->stickers = _stickerImagesMap;
-			} else {
-				for (StorageMap::const_iterator i = _stickerImagesMap.cbegin(), e = _stickerImagesMap.cend(); i != e; ++i) {
-					StorageKey k = i.key();
-					while (data->stickers.constFind(k) != data->stickers.cend()) {
-						++k.second;
-					}
-					data->stickers.insert(k, i.value());
+		} else if (task & ClearManagerStorage) {
+			_collectClearEntries(task, data->storage);
+			if (task & ClearManagerImages) {
+				if (!_imagesMap.isEmpty()) {
+					_imagesMap.clear();
+					_storageImagesSize = 0;
+					_mapChanged = true;
+				}
+				if (!_clipSidecarsMap.isEmpty()) {
+					_clipSidecarsMap.clear();
+					_storageClipSidecarsSize = 0;
+					_mapChanged = true;
 				}
 			}
-			if (!_stickerImagesMap.isEmpty()) {
+			if ((task & ClearManagerStickers) && !_stickerImagesMap.isEmpty()) {
 				_stickerImagesMap.clear();
 				_storageStickersSize = 0;
 				_mapChanged = true;
 			}
-			if (data->webFiles.isEmpty()) {
-				data->webFiles = _webFilesMap;
-			} else {
-				for (WebFilesMap::const_iterator i = _webFilesMap.cbegin(), e = _webFilesMap.cend(); i != e; ++i) {
-					QString k = i.key();
-					while (data->webFiles.constFind(k) != data->webFiles.cend()) {
-						k += '#';
-					}
-					data->webFiles.insert(k, i.value());
-				}
+			if ((task & ClearManagerAudios) && !_audiosMap.isEmpty()) {
+				_audiosMap.clear();
+				_storageAudiosSize = 0;
+				_mapChanged = true;
 			}
-			if (!_webFilesMap.isEmpty()) {
+			if ((task & ClearManagerWebFiles) && !_webFilesMap.isEmpty()) {
 				_webFilesMap.clear();
 				_storageWebFilesSize = 0;
 				_writeLocations();
 			}
-			if (data->audios.isEmpty()) {
-				data->audios = _audiosMap;
-			} else {
-				for (StorageMap::const_iterator i = _audiosMap.cbegin(), e = _audiosMap.cend(); i != e; ++i) {
-					StorageKey k = i.key();
-					while (data->audios.constFind(k) != data->audios.cend()) {
-						++k.second;
-					}
-					data->audios.insert(k, i.value());
-				}
-			}
-			if (!_audiosMap.isEmpty()) {
-				_audiosMap.clear();
-				_storageAudiosSize = 0;
-				_mapChanged = true;
-			}
 			_writeMap();
 		}
 		for (int32 i = 0, l = data->tasks.size(); i < l; ++i) {
@@ -4263,7 +5156,7 @@ bool ClearManager::hasTask(ClearManagerTask task) {
 	if (data->tasks.isEmpty()) return false;
 	if (data->tasks.at(0) == ClearManagerAll) return true;
 	for (int32 i = 0, l = data->tasks.size(); i < l; ++i) {
-		if (data->tasks.at(i) == task) return true;
+		if (data->tasks.at(i) & task) return true;
 	}
 	return false;
 }
@@ -4273,7 +5166,7 @@ void ClearManager::start() {
 	connect(data->thread, SIGNAL(started()), this, SLOT(onStart()));
 	connect(data->thread, SIGNAL(finished()), data->thread, SLOT(deleteLater()));
 	connect(data->thread, SIGNAL(finished()), this, SLOT(deleteLater()));
-	data->thread->start();
+	data->thread->start(QThread::LowestPriority);
 }
 
 void ClearManager::stop() {
@@ -4286,16 +5179,139 @@ void ClearManager::stop() {
 	thread->wait();
 }
 
+void ClearManager::applyRemoved() {
+	QVector<ClearManagerEntry> removed;
+	{
+		QMutexLocker lock(&data->mutex);
+		removed = base::take(data->removed);
+	}
+	if (removed.isEmpty()) return;
+
+	_readStorageMaps();
+	auto locationsChanged = false;
+	for_const (auto &entry, removed) {
+		if (entry.type == ClearManagerWebFiles) {
+			auto i = _webFilesMap.find(entry.webFile);
+			if (i != _webFilesMap.cend() && i->first == entry.file.first) {
+				_storageWebFilesSize -= i->second;
+				_webFilesMap.erase(i);
+				locationsChanged = true;
+			}
+			continue;
+		}
+
+		StorageMap *map = nullptr;
+		int64 *size = nullptr;
+		switch (entry.keyType) {
+		case lskImages: map = &_imagesMap; size = &_storageImagesSize; break;
+		case lskStickerImages: map = &_stickerImagesMap; size = &_storageStickersSize; break;
+		case lskAudios: map = &_audiosMap; size = &_storageAudiosSize; break;
+		case lskClipSidecars: map = &_clipSidecarsMap; size = &_storageClipSidecarsSize; break;
+		}
+		if (!map) continue;
+
+		auto i = map->find(entry.location);
+		if (i != map->cend() && i->first == entry.file.first) {
+			*size -= i->second;
+			map->erase(i);
+			_journalMapRemove(entry.keyType, entry.location);
+		}
+	}
+	if (locationsChanged) {
+		_writeLocations();
+	}
+	_writeMap();
+}
+
 ClearManager::~ClearManager() {
 	delete data;
 }
 
+// Deletes the files by batches and returns false if the manager was stopped.
+bool ClearManager::clearEntries(int task, const QVector<ClearManagerEntry> &entries, bool removeFromMaps) {
+	auto filesCount = entries.size();
+	auto bytesCount = qint64(0);
+	for_const (auto &entry, entries) {
+		bytesCount += entry.file.second;
+	}
+
+	auto bytesDone = qint64(0);
+	for (auto from = 0; from < filesCount; from += LocalClearBatchSize) {
+		auto till = qMin(from + int(LocalClearBatchSize), filesCount);
+		for (auto i = from; i != till; ++i) {
+			clearKey(entries[i].file.first, UserPath);
+			bytesDone += entries[i].file.second;
+		}
+		{
+			QMutexLocker lock(&data->mutex);
+			if (data->tasks.isEmpty()) return false;
+			if (removeFromMaps) {
+				data->removed += entries.mid(from, till - from);
+			}
+		}
+		emit progress(task, till, filesCount, bytesDone, bytesCount);
+		if (till < filesCount) {
+			QThread::msleep(LocalClearBatchPause);
+		}
+	}
+	return true;
+}
+
+// Leaves only the files of the task types older than age, returns false if the manager was stopped.
+bool ClearManager::selectOld(int task, TimeId age, QVector<ClearManagerEntry> &entries) {
+	auto till = TimeId(QDateTime::currentDateTime().toTime_t()) - age;
+	QVector<ClearManagerEntry> result;
+	for (int i = 0, count = entries.size(); i != count; ++i) {
+		auto &entry = entries[i];
+		if ((entry.type & task) && _clearEntryModified(entry) < till) {
+			result.push_back(entry);
+		}
+		if (!((i + 1) % LocalClearBatchSize)) {
+			QMutexLocker lock(&data->mutex);
+			if (data->tasks.isEmpty()) return false;
+		}
+	}
+	entries = result;
+	return true;
+}
+
+// Leaves only the oldest files that should be deleted to fit the limit, returns false if the manager was stopped.
+bool ClearManager::selectOverQuota(int64 limit, QVector<ClearManagerEntry> &entries) {
+	auto total = int64(0);
+	for (int i = 0, count = entries.size(); i != count; ++i) {
+		auto &entry = entries[i];
+		entry.modified = _clearEntryModified(entry);
+		total += entry.file.second;
+		if (!((i + 1) % LocalClearBatchSize)) {
+			QMutexLocker lock(&data->mutex);
+			if (data->tasks.isEmpty()) return false;
+		}
+	}
+	if (limit <= 0 || total <= limit) {
+		entries.clear();
+		return true;
+	}
+
+	// Delete a bit more than needed, so that the next cached files don't start the task again right away.
+	auto fit = limit - limit / 10;
+	std::sort(entries.begin(), entries.end(), [](const ClearManagerEntry &a, const ClearManagerEntry &b) {
+		return a.modified < b.modified;
+	});
+	auto count = 0;
+	while (count < entries.size() && total > fit) {
+		total -= entries[count++].file.second;
+	}
+	entries.resize(count);
+	return true;
+}
+
 void ClearManager::onStart() {
 	while (true) {
 		int task = 0;
 		bool result = false;
-		StorageMap images, stickers, audios;
-		WebFilesMap webFiles;
+		TimeId age = 0;
+		int64 limit = 0;
+		QVector<ClearManagerEntry> entries;
 		{
 			QMutexLocker lock(&data->mutex);
 			if (data->tasks.isEmpty()) {
@@ -4303,13 +5319,22 @@ void ClearManager::onStart() {
 				break;
 			}
 			task = data->tasks.at(0);
-			images = data->images;
-			stickers = data->stickers;
-			audios = data->audios;
-			webFiles = data->webFiles;
+			if (task != ClearManagerAll) {
+				if (task & (ClearManagerOld | ClearManagerQuota)) {
+					entries = data->candidates;
+					age = data->age;
+					limit = data->limit;
+				} else if (task & ClearManagerStorage) {
+					// Files of other types are left for their tasks.
+					QVector<ClearManagerEntry> left;
+					for_const (auto &entry, data->storage) {
+						((entry.type & task) ? entries : left).push_back(entry);
+					}
+					data->storage = left;
+				}
+			}
 		}
-		switch (task) {
-		case ClearManagerAll: {
+		if (task == ClearManagerAll) {
 			result = QDir(cTempDir()).removeRecursively();
 			QDirIterator di(_userBasePath, QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
 			while (di.hasNext()) {
@@ -4324,25 +5349,19 @@ void ClearManager::onStart() {
 					}
 				}
 			}
-		} break;
-		case ClearManagerDownloads:
+		} else if (task == ClearManagerDownloads) {
 			result = QDir(cTempDir()).removeRecursively();
-		break;
-		case ClearManagerStorage:
-			for (StorageMap::const_iterator i = images.cbegin(), e = images.cend(); i != e; ++i) {
-				clearKey(i.value().first, UserPath);
-			}
-			for (StorageMap::const_iterator i = stickers.cbegin(), e = stickers.cend(); i != e; ++i) {
-				clearKey(i.value().first, UserPath);
-			}
-			for (StorageMap::const_iterator i = audios.cbegin(), e = audios.cend(); i != e; ++i) {
-				clearKey(i.value().first, UserPath);
+		} else if (task & (ClearManagerOld | ClearManagerQuota)) {
+			auto selected = (task & ClearManagerOld) ? selectOld(task, age, entries) : selectOverQuota(limit, entries);
+			if (!selected || !clearEntries(task, entries, true)) {
+				break;
 			}
-			for (WebFilesMap::const_iterator i = webFiles.cbegin(), e = webFiles.cend(); i != e; ++i) {
-				clearKey(i.value().first, UserPath);
+			result = true;
+		} else if (task & ClearManagerStorage) {
+			if (!clearEntries(task, entries, false)) {
+				break;
 			}
 			result = true;
-		break;
 		}
 		{
 			QMutexLocker lock(&data->mutex);
@@ -4369,6 +5388,12 @@ Manager::Manager() {
 	connect(&_mapWriteTimer, SIGNAL(timeout()), this, SLOT(mapWriteTimeout()));
 	_locationsWriteTimer.setSingleShot(true);
 	connect(&_locationsWriteTimer, SIGNAL(timeout()), this, SLOT(locationsWriteTimeout()));
+	_voiceWaveformsWriteTimer.setSingleShot(true);
+	connect(&_voiceWaveformsWriteTimer, SIGNAL(timeout()), this, SLOT(voiceWaveformsWriteTimeout()));
+	_inlineBotResultsWriteTimer.setSingleShot(true);
+	connect(&_inlineBotResultsWriteTimer, SIGNAL(timeout()), this, SLOT(inlineBotResultsWriteTimeout()));
+	_storageLimitTimer.setSingleShot(true);
+	connect(&_storageLimitTimer, SIGNAL(timeout()), this, SLOT(storageLimitTimeout()));
 }
 
 void Manager::writeMap(bool fast) {
@@ -4395,6 +5420,36 @@ void Manager::writingLocations() {
 	_locationsWriteTimer.stop();
 }
 
+void Manager::writeVoiceWaveforms(bool fast) {
+	if (!_voiceWaveformsWriteTimer.isActive() || fast) {
+		_voiceWaveformsWriteTimer.start(fast ? 1 : WriteMapTimeout);
+	} else if (_voiceWaveformsWriteTimer.remainingTime() <= 0) {
+		voiceWaveformsWriteTimeout();
+	}
+}
+
+void Manager::writingVoiceWaveforms() {
+	_voiceWaveformsWriteTimer.stop();
+}
+
+void Manager::writeInlineBotResults(bool fast) {
+	if (!_inlineBotResultsWriteTimer.isActive() || fast) {
+		_inlineBotResultsWriteTimer.start(fast ? 1 : WriteMapTimeout);
+	} else if (_inlineBotResultsWriteTimer.remainingTime() <= 0) {
+		inlineBotResultsWriteTimeout();
+	}
+}
+
+void Manager::writingInlineBotResults() {
+	_inlineBotResultsWriteTimer.stop();
+}
+
+void Manager::checkStorageLimit() {
+	if (!_storageLimitTimer.isActive()) {
+		_storageLimitTimer.start(LocalStorageLimitCheckTimeout);
+	}
+}
+
 void Manager::mapWriteTimeout() {
 	_writeMap(WriteMapNow);
 }
@@ -4403,6 +5458,25 @@ void Manager::locationsWriteTimeout() {
 	_writeLocations(WriteMapNow);
 }
 
+void Manager::voiceWaveformsWriteTimeout() {
+	_writeVoiceWaveforms(WriteMapNow);
+}
+
+void Manager::inlineBotResultsWriteTimeout() {
+	_writeInlineBotResults(WriteMapNow);
+}
+
+void Manager::storageLimitTimeout() {
+	auto limit = Global::LocalStorageLimit();
+	if (limit <= 0 || !App::wnd()) return;
+
+	_readStorageMaps();
+	auto size = _storageImagesSize + _storageStickersSize + _storageAudiosSize + _storageClipSidecarsSize + int64(_storageWebFilesSize);
+	if (size > limit) {
+		App::wnd()->tempDirDelete(ClearManagerQuota);
+	}
+}
+
 void Manager::finish() {
 	if (_mapWriteTimer.isActive()) {
 		mapWriteTimeout();
@@ -4410,6 +5484,12 @@ void Manager::finish() {
 	if (_locationsWriteTimer.isActive()) {
 		locationsWriteTimeout();
 	}
+	if (_voiceWaveformsWriteTimer.isActive()) {
+		voiceWaveformsWriteTimeout();
+	}
+	if (_inlineBotResultsWriteTimer.isActive()) {
+		inlineBotResultsWriteTimeout();
+	}
 }
 
 } // namespace internal
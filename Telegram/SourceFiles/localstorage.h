@@ -40,23 +40,35 @@ void setPasscode(const QByteArray &passcode);
 enum ClearManagerTask {
 	ClearManagerAll = 0xFFFF,
 	ClearManagerDownloads = 0x01,
-	ClearManagerStorage = 0x02,
+	ClearManagerImages = 0x02, // with clip sidecars
+	ClearManagerStickers = 0x04,
+	ClearManagerAudios = 0x08,
+	ClearManagerWebFiles = 0x10,
+	ClearManagerStorage = ClearManagerImages | ClearManagerStickers | ClearManagerAudios | ClearManagerWebFiles,
+
+	ClearManagerOld = 0x100, // with storage types: only files older than the age passed to addTask()
+	ClearManagerQuota = 0x200, // oldest storage files until the storage fits Global::LocalStorageLimit()
 };
 
+struct ClearManagerEntry;
 struct ClearManagerData;
 class ClearManager : public QObject {
 	Q_OBJECT
 
 public:
 	ClearManager();
-	bool addTask(int task);
+	bool addTask(int task, TimeId age = 0);
 	bool hasTask(ClearManagerTask task);
 	void start();
 	void stop();
 
+	// Removes the files deleted by ClearManagerOld and ClearManagerQuota tasks from the storage maps.
+	void applyRemoved();
+
 signals:
 	void succeed(int task, void *manager);
 	void failed(int task, void *manager);
+	void progress(int task, int filesDone, int filesCount, qint64 bytesDone, qint64 bytesCount);
 
 private slots:
 	void onStart();
@@ -64,10 +76,17 @@ private slots:
 private:
 	~ClearManager();
 
+	bool clearEntries(int task, const QVector<ClearManagerEntry> &entries, bool removeFromMaps);
+	bool selectOld(int task, TimeId age, QVector<ClearManagerEntry> &entries);
+	bool selectOverQuota(int64 limit, QVector<ClearManagerEntry> &entries);
+
 	ClearManagerData *data;
 
 };
 
+// Starts a ClearManagerQuota task a bit later if the storage doesn't fit Global::LocalStorageLimit().
+void checkStorageLimit();
+
 enum ReadMapState {
 	ReadMapFailed = 0,
 	ReadMapDone = 1,
@@ -117,6 +136,28 @@ bool copyAudio(const StorageKey &oldLocation, const StorageKey &newLocation);
 int32 hasAudios();
 qint64 storageAudiosSize();
 
+// Small cached first frame, size and seek index of a video or gif document.
+void writeClipSidecar(const StorageKey &location, const QByteArray &sidecar);
+
+// The sidecar file is found on the main thread, it is read and decrypted
+// later by read() which can be called from the clip reader threads.
+class ClipSidecarFile {
+public:
+	explicit operator bool() const {
+		return !_name.isEmpty();
+	}
+	QByteArray read() const;
+
+private:
+	friend ClipSidecarFile clipSidecarFile(const StorageKey &location);
+
+	QString _name;
+	QString _basePath;
+	MTP::AuthKey _key;
+
+};
+ClipSidecarFile clipSidecarFile(const StorageKey &location);
+
 void writeWebFile(const QString &url, const QByteArray &data, bool overwrite = true);
 TaskId startWebFileLoad(const QString &url, webFileLoader *loader);
 int32 hasWebFiles();
@@ -142,7 +183,7 @@ void writeSavedGifs();
 void readSavedGifs();
 int32 countSavedGifsHash();
 
-void writeBackground(int32 id, const QImage &img);
+void writeBackground(int32 id, const QImage &img, const QVector<QImage> &mips);
 bool readBackground();
 
 void writeRecentHashtagsAndBots();
@@ -154,6 +195,13 @@ void readSavedPeers();
 
 void writeReportSpamStatuses();
 
+// The inline bot results cache is serialized only when the write timer fires.
+// The owner sets the serializer, marks the cache changed after each update
+// and resets the serializer before it is destroyed.
+void setInlineBotResultsSerializer(base::lambda_unique<QByteArray()> &&serializer);
+void inlineBotResultsChanged();
+QByteArray readInlineBotResults();
+
 void makeBotTrusted(UserData *bot);
 bool isBotTrusted(UserData *bot);
 
@@ -173,17 +221,28 @@ public:
 	void writingMap();
 	void writeLocations(bool fast);
 	void writingLocations();
+	void writeVoiceWaveforms(bool fast);
+	void writingVoiceWaveforms();
+	void writeInlineBotResults(bool fast);
+	void writingInlineBotResults();
+	void checkStorageLimit();
 	void finish();
 
 	public slots:
 
 	void mapWriteTimeout();
 	void locationsWriteTimeout();
+	void voiceWaveformsWriteTimeout();
+	void inlineBotResultsWriteTimeout();
+	void storageLimitTimeout();
 
 private:
 
 	QTimer _mapWriteTimer;
 	QTimer _locationsWriteTimer;
+	QTimer _voiceWaveformsWriteTimer;
+	QTimer _inlineBotResultsWriteTimer;
+	QTimer _storageLimitTimer;
 
 };
 
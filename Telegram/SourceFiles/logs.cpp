@@ -23,6 +23,10 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 
 #include <signal.h>
 #include <new>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "pspecific.h"
 
@@ -60,16 +64,19 @@ enum LogDataType {
 	LogDataCount
 };
 
-QMutex *_logsMutex(LogDataType type, bool clear = false) {
-	static QMutex *LogsMutexes = 0;
-	if (clear) {
-		delete[] LogsMutexes;
-		LogsMutexes = 0;
-	} else if (!LogsMutexes) {
-		LogsMutexes = new QMutex[LogDataCount];
-	}
-	return &LogsMutexes[type];
-}
+// Trace file is a header ("TDTR", version, record size, start unixtime)
+// followed by the records, all in the native (little endian) byte order.
+struct TraceRecord {
+	quint64 time; // microseconds since the trace start
+	quint64 id;
+	qint32 dc;
+	qint32 offset;
+	qint32 size;
+	quint16 event;
+	quint16 reserved;
+};
+static_assert(sizeof(TraceRecord) == 32, "Bad TraceRecord size.");
+constexpr qint32 kTraceVersion = 1;
 
 QString _logsFilePath(LogDataType type, const QString &postfix = QString()) {
 	QString path(cWorkingDir());
@@ -108,7 +115,6 @@ public:
 	}
 
 	void closeMain() {
-		QMutexLocker lock(_logsMutex(LogDataMain));
 		if (files[LogDataMain]) {
 			streams[LogDataMain].setDevice(0);
 			files[LogDataMain]->close();
@@ -132,18 +138,81 @@ public:
 	}
 
 	void write(LogDataType type, const QString &msg) {
-		QMutexLocker lock(_logsMutex(type));
-		if (type != LogDataMain) reopenDebug();
+		if (type != LogDataMain && !debugChecked) {
+			reopenDebug();
+			debugChecked = true;
+		}
 		if (!streams[type].device()) return;
 
 		streams[type] << msg;
-		streams[type].flush();
+		written[type] = true;
+	}
+
+	void writeTrace(const TraceRecord *records, int count) {
+		if (!traceFile.isOpen()) {
+			// skip the records that were queued before the trace was switched off
+			while (count > 0 && records->time <= traceClosedTime) {
+				++records;
+				--count;
+			}
+			if (!count || traceFailed || !openTrace()) {
+				return;
+			}
+		}
+		traceFile.write(reinterpret_cast<const char*>(records), count * sizeof(TraceRecord));
+		traceWritten = true;
+	}
+
+	void closeTrace(quint64 time) {
+		if (traceFile.isOpen()) {
+			traceFile.close();
+		}
+		traceWritten = false;
+		traceFailed = false;
+		traceClosedTime = time;
+	}
+
+	void flush() {
+		for (int32 i = 0; i < LogDataCount; ++i) {
+			if (written[i]) {
+				written[i] = false;
+				if (streams[i].device()) {
+					streams[i].flush();
+				}
+			}
+		}
+		if (traceWritten) {
+			traceWritten = false;
+			traceFile.flush();
+		}
+		debugChecked = false;
 	}
 
 private:
 
+	bool openTrace() {
+		QDir().mkdir(cWorkingDir() + qstr("DebugLogs"));
+		traceFile.setFileName(cWorkingDir() + qsl("DebugLogs/trace_%1.bin").arg(QDateTime::currentDateTime().toString(qsl("yyyyMMdd_hhmmss"))));
+		if (!traceFile.open(QIODevice::WriteOnly)) {
+			traceFailed = true;
+			LOG(("Could not open trace file '%1'!").arg(traceFile.fileName()));
+			return false;
+		}
+		qint32 header[4] = { 0, kTraceVersion, qint32(sizeof(TraceRecord)), qint32(unixtime()) };
+		memcpy(header, "TDTR", 4);
+		traceFile.write(reinterpret_cast<const char*>(header), sizeof(header));
+		return true;
+	}
+
 	QSharedPointer<QFile> files[LogDataCount];
 	QTextStream streams[LogDataCount];
+	bool written[LogDataCount] = { false };
+	bool debugChecked = false; // debug logs are switched each 15 minutes, check once per batch
+
+	QFile traceFile;
+	bool traceWritten = false;
+	bool traceFailed = false;
+	quint64 traceClosedTime = 0;
 
 	int32 part = -1;
 
@@ -271,6 +340,245 @@ private:
 
 LogsDataFields *LogsData = 0;
 
+namespace {
+
+constexpr int kLogsQueueSize = 4096; // must be a power of two
+constexpr int kLogsBatchSize = 256; // wake up the writer when that many records are waiting
+constexpr int kLogsFlushTimeoutMs = 200; // write and flush the records at least that often
+
+// Lock-free ring of records, any thread can push into it.
+// Only the thread holding the LogsWriter mutex pops the records.
+template <typename Record>
+class LogsQueue {
+public:
+	LogsQueue() {
+		for (auto i = 0; i != kLogsQueueSize; ++i) {
+			_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	bool push(const Record &record) {
+		auto position = _pushPosition.load(std::memory_order_relaxed);
+		while (true) {
+			auto &cell = _cells[position & (kLogsQueueSize - 1)];
+			auto sequence = cell.sequence.load(std::memory_order_acquire);
+			auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+			if (!difference) {
+				if (_pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					cell.record = record;
+					cell.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (difference < 0) {
+				return false; // the queue is full
+			} else {
+				position = _pushPosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool pop(Record &record) {
+		auto position = _popPosition.load(std::memory_order_relaxed);
+		auto &cell = _cells[position & (kLogsQueueSize - 1)];
+		if (cell.sequence.load(std::memory_order_acquire) != position + 1) {
+			return false;
+		}
+		record = std_::move(cell.record);
+		cell.record = Record();
+		cell.sequence.store(position + kLogsQueueSize, std::memory_order_release);
+		_popPosition.store(position + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	size_t size() const {
+		return _pushPosition.load(std::memory_order_relaxed) - _popPosition.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Cell {
+		std::atomic<size_t> sequence;
+		Record record;
+	};
+	Cell _cells[kLogsQueueSize];
+	std::atomic<size_t> _pushPosition { 0 };
+	std::atomic<size_t> _popPosition { 0 };
+
+};
+
+struct LogsRecord {
+	LogDataType type = LogDataMain;
+	QString text;
+};
+
+thread_local bool LogsWriterLocked = false;
+
+// Writes the queued records to LogsData in batches on a separate thread.
+class LogsWriter {
+public:
+	LogsWriter() : _thread([this] { run(); }) {
+	}
+
+	void write(LogDataType type, const QString &msg) {
+		auto record = LogsRecord();
+		record.type = type;
+		record.text = msg;
+		push(_queue, record);
+	}
+
+	void writeTrace(const TraceRecord &record) {
+		push(_traceQueue, record);
+	}
+
+	// Writes all the queued records and calls the callback with LogsData locked.
+	template <typename Callback>
+	void withData(Callback callback) {
+		std::unique_lock<std::mutex> lock(_mutex);
+		LogsWriterLocked = true;
+		drain();
+		callback();
+		LogsWriterLocked = false;
+	}
+
+	void flush() {
+		withData([] {});
+	}
+
+	// Called from the crash handler, we don't wait for the writer there.
+	void tryFlush() {
+		if (!LogsWriterLocked && _mutex.try_lock()) {
+			LogsWriterLocked = true;
+			drain();
+			LogsWriterLocked = false;
+			_mutex.unlock();
+		}
+	}
+
+	~LogsWriter() {
+		{
+			std::unique_lock<std::mutex> lock(_wakeMutex);
+			_stopping = true;
+			_wake.notify_one();
+		}
+		_thread.join();
+		flush();
+	}
+
+private:
+	template <typename Record>
+	void push(LogsQueue<Record> &queue, const Record &record) {
+		while (!queue.push(record)) {
+			if (LogsWriterLocked) {
+				return; // LOG() while writing with the queue full, drop it
+			}
+			flush(); // the writer is behind, help it
+		}
+
+		// Lock the wake mutex only for the first record after a flush and
+		// for the first one that fills a batch, not for each of them.
+		if (queue.size() >= kLogsBatchSize) {
+			if (!_batchWakeSent.exchange(true)) {
+				wake(true);
+			}
+		} else if (!_wakeSent.exchange(true)) {
+			wake(false);
+		}
+	}
+
+	void wake(bool batchReady) {
+		std::unique_lock<std::mutex> lock(_wakeMutex);
+		_hasRecords = true;
+		if (batchReady) {
+			_batchReady = true;
+		}
+		_wake.notify_one();
+	}
+
+	// Sleeps while there is nothing to write, after the first record
+	// waits for a full batch or kLogsFlushTimeoutMs, whichever is first.
+	void run() {
+		std::unique_lock<std::mutex> lock(_wakeMutex);
+		while (true) {
+			_wake.wait(lock, [this] { return _stopping || _hasRecords; });
+			if (_stopping) {
+				break;
+			}
+			_wake.wait_for(lock, std::chrono::milliseconds(kLogsFlushTimeoutMs), [this] { return _stopping || _batchReady; });
+			_hasRecords = _batchReady = false;
+			_wakeSent.store(false);
+			_batchWakeSent.store(false);
+
+			lock.unlock();
+			flush();
+			lock.lock();
+		}
+	}
+
+	void drain() {
+		auto record = LogsRecord();
+		while (_queue.pop(record)) {
+			if (LogsData) {
+				LogsData->write(record.type, record.text);
+			}
+		}
+
+		TraceRecord traces[kLogsBatchSize];
+		auto count = 0;
+		while (_traceQueue.pop(traces[count])) {
+			if (++count == kLogsBatchSize) {
+				if (LogsData) {
+					LogsData->writeTrace(traces, count);
+				}
+				count = 0;
+			}
+		}
+		if (count && LogsData) {
+			LogsData->writeTrace(traces, count);
+		}
+
+		if (LogsData) {
+			LogsData->flush();
+		}
+	}
+
+	LogsQueue<LogsRecord> _queue;
+	LogsQueue<TraceRecord> _traceQueue;
+	std::mutex _mutex;
+	std::mutex _wakeMutex;
+	std::condition_variable _wake;
+	bool _stopping = false; // guarded by _wakeMutex
+	bool _hasRecords = false; // guarded by _wakeMutex
+	bool _batchReady = false; // guarded by _wakeMutex
+	std::atomic<bool> _wakeSent = { false };
+	std::atomic<bool> _batchWakeSent = { false };
+	std::thread _thread;
+
+};
+
+LogsWriter *Writer = nullptr;
+QElapsedTimer TraceTimer;
+
+void _logsDeleteData() {
+	if (Writer) {
+		Writer->withData([] {
+			delete LogsData;
+			LogsData = 0;
+		});
+	} else {
+		delete LogsData;
+		LogsData = 0;
+	}
+}
+
+bool _logsOpenMain() {
+	auto result = false;
+	Writer->withData([&result] {
+		result = LogsData->openMain();
+	});
+	return result;
+}
+
+} // namespace
+
 typedef QList<QPair<LogDataType, QString> > LogsInMemoryList;
 LogsInMemoryList *LogsInMemory = 0;
 LogsInMemoryList *DeletedLogsInMemory = SharedMemoryLocation<LogsInMemoryList, 0>();
@@ -280,7 +588,7 @@ QString LogsBeforeSingleInstanceChecked; // LogsInMemory already dumped in LogsD
 void _logsWrite(LogDataType type, const QString &msg) {
 	if (LogsData && (type == LogDataMain || LogsStartIndexChosen < 0)) {
 		if (type == LogDataMain || cDebug()) {
-			LogsData->write(type, msg);
+			Writer->write(type, msg);
 		}
 	} else if (LogsInMemory != DeletedLogsInMemory) {
 		if (!LogsInMemory) {
@@ -334,12 +642,14 @@ namespace Logs {
 #endif // Q_OS_WINRT
 		}
 
+		Writer = new LogsWriter();
+		TraceTimer.start();
 		LogsData = new LogsDataFields();
 		if (!workingDirChosen) {
 			cForceWorkingDir(cWorkingDir());
-			if (!LogsData->openMain()) {
+			if (!_logsOpenMain()) {
 				cForceWorkingDir(cExeDir());
-				if (!LogsData->openMain()) {
+				if (!_logsOpenMain()) {
 					cForceWorkingDir(psAppDataPath());
 				}
 			}
@@ -355,9 +665,8 @@ namespace Logs {
 		Sandbox::WorkingDirReady();
 		SignalHandlers::StartCrashHandler();
 
-		if (!LogsData->openMain()) {
-			delete LogsData;
-			LogsData = 0;
+		if (!_logsOpenMain()) {
+			_logsDeleteData();
 		}
 
 		LOG(("Launched version: %1, alpha: %2, beta: %3, debug mode: %4, test dc: %5").arg(AppVersion).arg(Logs::b(cAlphaVersion())).arg(cBetaVersion()).arg(Logs::b(cDebug())).arg(Logs::b(cTestMode())));
@@ -395,16 +704,14 @@ namespace Logs {
 	}
 
 	void finish() {
-		delete LogsData;
-		LogsData = 0;
+		_logsDeleteData();
+		delete base::take(Writer);
 
 		if (LogsInMemory && LogsInMemory != DeletedLogsInMemory) {
 			delete LogsInMemory;
 		}
 		LogsInMemory = DeletedLogsInMemory;
 
-		_logsMutex(LogDataMain, true);
-
 		SignalHandlers::FinishCrashHandler();
 	}
 
@@ -415,11 +722,14 @@ namespace Logs {
 	bool instanceChecked() {
 		if (!LogsData) return false;
 
-		if (!LogsData->instanceChecked()) {
+		auto checked = false;
+		Writer->withData([&checked] {
+			checked = LogsData->instanceChecked();
+		});
+		if (!checked) {
 			LogsBeforeSingleInstanceChecked = Logs::full();
 
-			delete LogsData;
-			LogsData = 0;
+			_logsDeleteData();
 			LOG(("FATAL: Could not move logging to '%1'!").arg(_logsFilePath(LogDataMain)));
 			return false;
 		}
@@ -460,7 +770,11 @@ namespace Logs {
 	void closeMain() {
 		LOG(("Explicitly closing main log and finishing crash handlers."));
 		if (LogsData) {
-			LogsData->closeMain();
+			Writer->withData([] {
+				if (LogsData) {
+					LogsData->closeMain();
+				}
+			});
 		}
 	}
 
@@ -513,9 +827,42 @@ namespace Logs {
 		_logsWrite(LogDataMtp, msg);
 	}
 
+	void writeTrace(TraceEvent event, int32 dc, uint64 id, int32 offset, int32 size) {
+		if (!LogsData || LogsStartIndexChosen >= 0) {
+			return; // not writing to files yet or in multiple instances mode
+		}
+
+		auto record = TraceRecord();
+		record.time = quint64(TraceTimer.nsecsElapsed() / 1000);
+		record.id = id;
+		record.dc = dc;
+		record.offset = offset;
+		record.size = size;
+		record.event = quint16(event);
+		record.reserved = 0;
+		Writer->writeTrace(record);
+	}
+
+	void closeTrace() {
+		if (LogsData) {
+			auto time = quint64(TraceTimer.nsecsElapsed() / 1000);
+			Writer->withData([time] {
+				if (LogsData) {
+					LogsData->closeTrace(time);
+				}
+			});
+		}
+	}
+
 	QString full() {
 		if (LogsData) {
-			return LogsData->full();
+			auto result = QString();
+			Writer->withData([&result] {
+				if (LogsData) {
+					result = LogsData->full();
+				}
+			});
+			return result;
 		}
 		if (!LogsInMemory || LogsInMemory == DeletedLogsInMemory) {
 			return LogsBeforeSingleInstanceChecked;
@@ -905,6 +1252,12 @@ namespace internal {
 
 		dump() << "\n";
 
+		// The report is written already, the queued log records are
+		// flushed after it only if the writer is not busy right now.
+		if (Writer) {
+			Writer->tryFlush();
+		}
+
 		ReportingThreadId = nullptr;
 	}
 
@@ -38,6 +38,19 @@ namespace Logs {
 	void writeTcp(const QString &v);
 	void writeMtp(int32 dc, const QString &v);
 
+	// Binary trace records, read by the TraceStat tool (_other/tracestat.cpp).
+	enum class TraceEvent : uint16 {
+		MtpPacketSent = 1, // id - container or message msgId
+		MtpRequestSent = 2, // id - requestId
+		MtpResponseReceived = 3, // id - requestId
+		FilePartRequested = 4, // id - requestId
+		FilePartLoaded = 5, // id - requestId
+		FileUploadPartSent = 6, // id - requestId
+		FileUploadPartDone = 7, // id - requestId
+	};
+	void writeTrace(TraceEvent event, int32 dc, uint64 id, int32 offset, int32 size);
+	void closeTrace(); // call after the trace flag is switched off, next records start a new file
+
 	QString full();
 
 	inline const char *b(bool v) {
@@ -86,6 +99,9 @@ namespace Logs {
 #define MTP_LOG(dc, msg) { if (cDebug() || !Logs::started()) Logs::writeMtp(dc, QString msg); }
 //usage MTP_LOG(dc, ("log: %1 %2").arg(1).arg(2))
 
+#define TRACE_LOG(event, dc, id, offset, size) { if (DebugLogging::Trace()) Logs::writeTrace(Logs::TraceEvent::event, dc, id, offset, size); }
+//usage TRACE_LOG(FilePartLoaded, dc, requestId, offset, bytes.size())
+
 namespace SignalHandlers {
 
 	struct dump {
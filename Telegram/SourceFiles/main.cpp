@@ -23,6 +23,7 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 #include "pspecific.h"
 
 #include "localstorage.h"
+#include "core/startup_profiler.h"
 
 int main(int argc, char *argv[]) {
 #ifndef Q_OS_MAC // Retina display support is working fine, others are not.
@@ -41,6 +42,8 @@ int main(int argc, char *argv[]) {
 #endif // !TDESKTOP_DISABLE_CRASH_REPORTS
 	}
 
+	StartupProfiler::start();
+
 	// both are finished in Application::closeApplication
 	Logs::start(); // must be started before Platform is started
 	Platform::start(); // must be started before QApplication is created
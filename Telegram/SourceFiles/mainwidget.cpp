@@ -56,9 +56,45 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 #include "media/player/media_player_instance.h"
 #include "core/qthelp_regex.h"
 #include "core/qthelp_url.h"
+#include "core/startup_profiler.h"
+#include "core/memory_pool.h"
 #include "window/chat_background.h"
 #include "window/player_wrap_widget.h"
 
+namespace {
+
+class CacheBackgroundTask : public Task {
+public:
+	CacheBackgroundTask(MainWidget *main, int requestId, const QImage &image, const QRect &from, const QSize &size, const QRect &forRect, const QPoint &position)
+		: _main(main)
+		, _requestId(requestId)
+		, _image(image)
+		, _from(from)
+		, _size(size)
+		, _forRect(forRect)
+		, _position(position) {
+	}
+
+	void process() override {
+		_image = _image.copy(_from).scaled(_size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+	}
+	void finish() override {
+		_main->backgroundCached(_requestId, _forRect, _position, std_::move(_image));
+	}
+
+private:
+	MainWidget *_main;
+	int _requestId;
+	QImage _image;
+	QRect _from;
+	QSize _size;
+	QRect _forRect;
+	QPoint _position;
+
+};
+
+} // namespace
+
 StackItemSection::StackItemSection(std_::unique_ptr<Window::SectionMemento> &&memento) : StackItem(nullptr)
 , _memento(std_::move(memento)) {
 }
@@ -110,6 +146,7 @@ MainWidget::MainWidget(MainWindow *window) : TWidget(window)
 
 	connect(&_updateMutedTimer, SIGNAL(timeout()), this, SLOT(onUpdateMuted()));
 	connect(&_viewsIncrementTimer, SIGNAL(timeout()), this, SLOT(onViewsIncrement()));
+	connect(&_historyMemoryTimer, SIGNAL(timeout()), this, SLOT(onHistoryMemoryTimeout()));
 
 	_webPageOrGameUpdater.setSingleShot(true);
 	connect(&_webPageOrGameUpdater, SIGNAL(timeout()), this, SLOT(webPagesOrGamesUpdate()));
@@ -1081,15 +1118,35 @@ void MainWidget::onCacheBackground() {
 		_cachedX = 0;
 		_cachedY = 0;
 		_cachedBackground = App::pixmapFromImageInPlace(std_::move(result));
+		_cachedFor = _willCacheFor;
 	} else {
 		QRect to, from;
 		backgroundParams(_willCacheFor, to, from);
-		_cachedX = to.x();
-		_cachedY = to.y();
-		_cachedBackground = App::pixmapFromImageInPlace(bg.toImage().copy(from).scaled(to.width() * cIntRetinaFactor(), to.height() * cIntRetinaFactor(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
-		_cachedBackground.setDevicePixelRatio(cRetinaFactor());
+
+		// scale from the smallest mip that is still not smaller than the result
+		auto size = to.size() * cIntRetinaFactor();
+		auto &source = Window::chatBackground()->imageForSize(from, size);
+		if (!_cacheBackgroundQueue) {
+			_cacheBackgroundQueue = std_::make_unique<TaskQueue>(nullptr, CacheBackgroundQueueStopTimeout);
+		}
+		_cachingFor = _willCacheFor;
+		_cacheBackgroundQueue->addTask(new CacheBackgroundTask(this, ++_cacheBackgroundRequestId, source.toImage(), from, size, _willCacheFor, to.topLeft()));
+	}
+}
+
+void MainWidget::backgroundCached(int requestId, const QRect &forRect, const QPoint &position, QImage &&image) {
+	if (requestId != _cacheBackgroundRequestId) {
+		return;
+	}
+	_cachingFor = QRect();
+	_cachedX = position.x();
+	_cachedY = position.y();
+	_cachedBackground = App::pixmapFromImageInPlace(std_::move(image));
+	_cachedBackground.setDevicePixelRatio(cRetinaFactor());
+	_cachedFor = forRect;
+	if (_history->isVisible()) {
+		_history->update();
 	}
-	_cachedFor = _willCacheFor;
 }
 
 void MainWidget::forwardSelectedItems() {
@@ -1857,6 +1914,8 @@ bool MainWidget::isIdle() const {
 void MainWidget::clearCachedBackground() {
 	_cachedBackground = QPixmap();
 	_cacheBackgroundTimer.stop();
+	_cachingFor = QRect();
+	++_cacheBackgroundRequestId;
 	update();
 }
 
@@ -1866,13 +1925,17 @@ QPixmap MainWidget::cachedBackground(const QRect &forRect, int &x, int &y) {
 		y = _cachedY;
 		return _cachedBackground;
 	}
-	if (_willCacheFor != forRect || !_cacheBackgroundTimer.isActive()) {
+	if (_willCacheFor != forRect || (!_cacheBackgroundTimer.isActive() && _cachingFor != forRect)) {
 		_willCacheFor = forRect;
 		_cacheBackgroundTimer.start(CacheBackgroundTimeout);
 	}
 	return QPixmap();
 }
 
+bool MainWidget::benchmarkScrollHistory(int delta) {
+	return _history->benchmarkScroll(delta);
+}
+
 void MainWidget::backgroundParams(const QRect &forRect, QRect &to, QRect &from) const {
 	auto bg = Window::chatBackground()->image().size();
 	if (uint64(bg.width()) * forRect.height() > uint64(bg.height()) * forRect.width()) {
@@ -2639,6 +2702,69 @@ void MainWidget::historyCleared(History *history) {
 	_history->historyCleared(history);
 }
 
+void MainWidget::checkHistoryMemory() {
+	if (Global::MessagesMemoryLimit() > 0 && !_historyMemoryTimer.isActive()) {
+		_historyMemoryTimer.start(MessagesMemoryCheckTimeout);
+	}
+}
+
+bool MainWidget::isItemReferenced(HistoryItem *item) const {
+	for_const (auto forwarding, _toForward) {
+		if (forwarding == item) {
+			return true;
+		}
+	}
+	return _dialogs->hasSearchResult(item);
+}
+
+bool MainWidget::canUnloadHistory(History *history) {
+	auto check = [history](PeerData *peer) {
+		return !peer || (peer != history->peer && peer->migrateFrom() != history->peer && peer->migrateTo() != history->peer);
+	};
+	return check(historyPeer()) && check(overviewPeer());
+}
+
+void MainWidget::onHistoryMemoryTimeout() {
+	auto limit = Global::MessagesMemoryLimit();
+	if (limit <= 0) {
+		return;
+	}
+
+	// The message objects are in the memory pool, their texts are counted separately.
+	int64 texts = 0;
+	for_const (auto history, App::histories().map) {
+		texts += history->textMemorySize();
+	}
+	auto wasSize = MemoryPool::liveSize() + texts;
+	if (wasSize <= limit) {
+		return;
+	}
+
+	// The chats with the oldest last messages are unloaded first.
+	QVector<History*> histories;
+	for_const (auto history, App::histories().map) {
+		if (canUnloadHistory(history)) {
+			histories.push_back(history);
+		}
+	}
+	std::sort(histories.begin(), histories.end(), [](History *a, History *b) {
+		return a->lastMsgDate < b->lastMsgDate;
+	});
+
+	auto unloaded = 0;
+	for_const (auto history, histories) {
+		texts -= history->textMemorySize();
+		unloaded += history->unloadFarBlocks(HistoryUnloadKeepItems);
+		texts += history->textMemorySize();
+		if (MemoryPool::liveSize() + texts <= limit) {
+			break;
+		}
+	}
+	if (unloaded > 0) {
+		LOG(("Memory Info: unloaded %1 far history messages, from %2 to %3 bytes.").arg(unloaded).arg(wasSize).arg(MemoryPool::liveSize() + texts));
+	}
+}
+
 void MainWidget::animShow(const QPixmap &bgAnimCache, bool back) {
 	if (App::app()) App::app()->mtpPause();
 
@@ -3455,7 +3581,10 @@ void MainWidget::start(const MTPUser &user) {
 		App::wnd()->getTitle()->updateControlsVisibility();
 	}
 
-	Local::readSavedPeers();
+	{
+		StartupProfiler::Phase phase("Local::readSavedPeers");
+		Local::readSavedPeers();
+	}
 
 	cSetOtherOnline(0);
 	App::feedUsers(MTP_vector<MTPUser>(1, user));
@@ -3464,10 +3593,13 @@ void MainWidget::start(const MTPUser &user) {
 
 	_started = true;
 	App::wnd()->sendServiceHistoryRequest();
-	Local::readInstalledStickers();
-	Local::readFeaturedStickers();
-	Local::readRecentStickers();
-	Local::readSavedGifs();
+	{
+		StartupProfiler::Phase phase("Local::readStickers");
+		Local::readInstalledStickers();
+		Local::readFeaturedStickers();
+		Local::readRecentStickers();
+		Local::readSavedGifs();
+	}
 	_history->start();
 
 	checkStartUrl();
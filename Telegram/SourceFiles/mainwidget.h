@@ -194,6 +194,11 @@ public:
 	void markActiveHistoryAsRead();
 	void historyCleared(History *history);
 
+	// Checks a bit later if the message objects and texts take more memory than
+	// Global::MessagesMemoryLimit() and unloads far blocks of the hidden histories.
+	void checkHistoryMemory();
+	bool isItemReferenced(HistoryItem *item) const;
+
 	void peerBefore(const PeerData *inPeer, MsgId inMsg, PeerData *&outPeer, MsgId &outMsg);
 	void peerAfter(const PeerData *inPeer, MsgId inMsg, PeerData *&outPeer, MsgId &outMsg);
 	PeerData *historyPeer();
@@ -322,8 +327,10 @@ public:
 	bool isIdle() const;
 
 	QPixmap cachedBackground(const QRect &forRect, int &x, int &y);
+	void backgroundCached(int requestId, const QRect &forRect, const QPoint &position, QImage &&image);
 	void backgroundParams(const QRect &forRect, QRect &to, QRect &from) const;
 	void updateScrollColors();
+	bool benchmarkScrollHistory(int delta);
 
 	void setChatBackground(const App::WallPaper &wp);
 	bool chatBackgroundLoading();
@@ -464,6 +471,8 @@ public slots:
 	void onViewsIncrement();
 	void onActiveChannelUpdateFull();
 
+	void onHistoryMemoryTimeout();
+
 	void onDownloadPathSettings();
 
 	void onSharePhoneWithBot(PeerData *recipient);
@@ -671,6 +680,11 @@ private:
 	int _cachedY = 0;
 	SingleTimer _cacheBackgroundTimer;
 
+	// the scaling is done in a separate thread, results of outdated requests are dropped
+	std_::unique_ptr<TaskQueue> _cacheBackgroundQueue;
+	QRect _cachingFor;
+	int _cacheBackgroundRequestId = 0;
+
 	typedef QMap<ChannelData*, bool> UpdatedChannels;
 	UpdatedChannels _updatedChannels;
 
@@ -687,6 +701,9 @@ private:
 	void viewsIncrementDone(QVector<MTPint> ids, const MTPVector<MTPint> &result, mtpRequestId req);
 	bool viewsIncrementFail(const RPCError &error, mtpRequestId req);
 
+	bool canUnloadHistory(History *history);
+	SingleTimer _historyMemoryTimer;
+
 	std_::unique_ptr<App::WallPaper> _background;
 
 	std_::unique_ptr<ApiWrap> _api;
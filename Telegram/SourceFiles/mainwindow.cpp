@@ -1061,9 +1061,9 @@ MainWindow::TempDirState MainWindow::localStorageState() {
 	return (Local::hasImages() || Local::hasStickers() || Local::hasWebFiles() || Local::hasAudios()) ? TempDirExists : TempDirEmpty;
 }
 
-void MainWindow::tempDirDelete(int task) {
+void MainWindow::tempDirDelete(int task, TimeId age) {
 	if (_clearManager) {
-		if (_clearManager->addTask(task)) {
+		if (_clearManager->addTask(task, age)) {
 			return;
 		} else {
 			_clearManager->stop();
@@ -1071,13 +1071,17 @@ void MainWindow::tempDirDelete(int task) {
 		}
 	}
 	_clearManager = new Local::ClearManager();
-	_clearManager->addTask(task);
+	_clearManager->addTask(task, age);
 	connect(_clearManager, SIGNAL(succeed(int,void*)), this, SLOT(onClearFinished(int,void*)));
 	connect(_clearManager, SIGNAL(failed(int,void*)), this, SLOT(onClearFailed(int,void*)));
+	connect(_clearManager, SIGNAL(progress(int,int,int,qint64,qint64)), this, SLOT(onClearProgress(int,int,int,qint64,qint64)));
 	_clearManager->start();
 }
 
 void MainWindow::onClearFinished(int task, void *manager) {
+	if (_clearManager) {
+		_clearManager->applyRemoved();
+	}
 	if (manager && manager == _clearManager) {
 		_clearManager->stop();
 		_clearManager = nullptr;
@@ -1086,6 +1090,9 @@ void MainWindow::onClearFinished(int task, void *manager) {
 }
 
 void MainWindow::onClearFailed(int task, void *manager) {
+	if (_clearManager) {
+		_clearManager->applyRemoved();
+	}
 	if (manager && manager == _clearManager) {
 		_clearManager->stop();
 		_clearManager = nullptr;
@@ -1093,6 +1100,13 @@ void MainWindow::onClearFailed(int task, void *manager) {
 	emit tempDirClearFailed(task);
 }
 
+void MainWindow::onClearProgress(int task, int filesDone, int filesCount, qint64 bytesDone, qint64 bytesCount) {
+	if (_clearManager) {
+		_clearManager->applyRemoved();
+	}
+	emit tempDirClearProgress(task, filesDone, filesCount, bytesDone, bytesCount);
+}
+
 void MainWindow::notifySchedule(History *history, HistoryItem *item) {
 	if (App::quitting() || !history->currentNotification() || !App::api()) return;
 
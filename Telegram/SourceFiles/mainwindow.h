@@ -137,7 +137,7 @@ public:
 	};
 	TempDirState tempDirState();
 	TempDirState localStorageState();
-	void tempDirDelete(int task);
+	void tempDirDelete(int task, TimeId age = 0);
 
 	void notifySettingGot();
 	void notifySchedule(History *history, HistoryItem *item);
@@ -197,6 +197,7 @@ public slots:
 
 	void onClearFinished(int task, void *manager);
 	void onClearFailed(int task, void *manager);
+	void onClearProgress(int task, int filesDone, int filesCount, qint64 bytesDone, qint64 bytesCount);
 
 	void notifyShowNext();
 	void updateTrayMenu(bool force = false);
@@ -216,6 +217,7 @@ signals:
 	void resized(const QSize &size);
 	void tempDirCleared(int task);
 	void tempDirClearFailed(int task);
+	void tempDirClearProgress(int task, int filesDone, int filesCount, qint64 bytesDone, qint64 bytesCount);
 	void newAuthorization();
 
 private slots:
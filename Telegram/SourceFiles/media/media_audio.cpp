@@ -66,6 +66,7 @@ namespace {
 	AudioPlayer *player = 0;
 
 	float64 suppressAllGain = 1., suppressSongGain = 1.;
+	QAtomicInt underrunsCount = 0;
 
 	AudioCapture *capture = 0;
 }
@@ -261,6 +262,81 @@ void audioFinish() {
 	cSetHasAudioPlayer(false);
 }
 
+AudioPrebuffer::AudioPrebuffer(int32 format, int32 frequency)
+: _format(format)
+, _frequency(frequency)
+, _chunks(AudioPrebufferChunksLimit) {
+}
+
+int64 AudioPrebuffer::targetSamples() const {
+	return (int64(AudioPrebufferMs) * _frequency) / 1000;
+}
+
+int64 AudioPrebuffer::bufferedSamples() const {
+	return _bufferedSamples.loadAcquire();
+}
+
+bool AudioPrebuffer::full() const {
+	return _chunks.full();
+}
+
+bool AudioPrebuffer::push(Chunk &&chunk) {
+	auto samplesCount = int(chunk.samplesCount);
+	if (!_chunks.push(std_::move(chunk))) {
+		return false;
+	}
+	_bufferedSamples.fetchAndAddOrdered(samplesCount);
+	return true;
+}
+
+void AudioPrebuffer::finish() {
+	_finished.storeRelease(1);
+	_decoding.storeRelease(0);
+}
+
+void AudioPrebuffer::decodingStarted() {
+	_decoding.storeRelease(1);
+}
+
+void AudioPrebuffer::decodingStopped() {
+	_decoding.storeRelease(0);
+}
+
+bool AudioPrebuffer::pop(Chunk &chunk) {
+	if (!_chunks.pop(chunk)) {
+		return false;
+	}
+	_bufferedSamples.fetchAndAddOrdered(-int(chunk.samplesCount));
+	return true;
+}
+
+bool AudioPrebuffer::empty() const {
+	return _chunks.empty();
+}
+
+bool AudioPrebuffer::exhausted() const {
+	// Check the flag first, the last chunk is pushed before it is set.
+	return _finished.loadAcquire() && _chunks.empty();
+}
+
+bool AudioPrebuffer::requestDecoding() {
+	if (_finished.loadAcquire() || _cancelled.loadAcquire() || _chunks.full()) {
+		return false;
+	}
+	if (bufferedSamples() * 2 >= targetSamples()) {
+		return false;
+	}
+	return _decoding.testAndSetOrdered(0, 1);
+}
+
+void AudioPrebuffer::cancel() {
+	_cancelled.storeRelease(1);
+}
+
+bool AudioPrebuffer::cancelled() const {
+	return _cancelled.loadAcquire();
+}
+
 void AudioPlayer::AudioMsg::clear() {
 	audio = AudioMsgId();
 	file = FileLocation();
@@ -282,6 +358,11 @@ void AudioPlayer::AudioMsg::clear() {
 	}
 	nextBuffer = 0;
 
+	if (prebuffer) {
+		prebuffer->cancel();
+		prebuffer = nullptr;
+	}
+
 	videoData = nullptr;
 	videoPlayId = 0;
 }
@@ -920,6 +1001,10 @@ bool audioCheckError() {
 	return _checkALError();
 }
 
+int audioUnderrunsCount() {
+	return underrunsCount.loadAcquire();
+}
+
 } // namespace internal
 
 AudioCapture::AudioCapture() : _capture(new AudioCaptureInner(&_captureThread)) {
@@ -1067,6 +1152,9 @@ void AudioPlayerFader::onTimer() {
 int32 AudioPlayerFader::updateOnePlayback(AudioPlayer::AudioMsg *m, bool &hasPlaying, bool &hasFading, float64 suppressGain, bool suppressGainChanged) {
 	bool playing = false, fading = false;
 
+	auto fed = feedFromPrebuffer(m);
+	if (fed & EmitError) return fed;
+
 	ALint pos = 0;
 	ALint state = AL_INITIAL;
 	alGetSourcei(m->source, AL_SAMPLE_OFFSET, &pos);
@@ -1074,7 +1162,7 @@ int32 AudioPlayerFader::updateOnePlayback(AudioPlayer::AudioMsg *m, bool &hasPla
 	alGetSourcei(m->source, AL_SOURCE_STATE, &state);
 	if (!_checkALError()) { setStoppedState(m, AudioPlayerStoppedAtError); return EmitError; }
 
-	int32 emitSignals = 0;
+	int32 emitSignals = fed;
 	switch (m->playbackState.state) {
 	case AudioPlayerFinishing:
 	case AudioPlayerPausing:
@@ -1163,6 +1251,89 @@ int32 AudioPlayerFader::updateOnePlayback(AudioPlayer::AudioMsg *m, bool &hasPla
 	return emitSignals;
 }
 
+int32 AudioPlayerFader::feedFromPrebuffer(AudioPlayer::AudioMsg *m) {
+	auto prebuffer = m->prebuffer.data();
+	if (!prebuffer) return 0;
+
+	if (!prebuffer->empty()) {
+		auto underrun = false;
+		switch (m->playbackState.state) {
+		case AudioPlayerStarting:
+		case AudioPlayerResuming:
+		case AudioPlayerPlaying: {
+			// The source stops by itself if all the queued buffers were played.
+			ALint state = AL_INITIAL;
+			alGetSourcei(m->source, AL_SOURCE_STATE, &state);
+			if (!_checkALError()) { setStoppedState(m, AudioPlayerStoppedAtError); return EmitError; }
+			underrun = (state == AL_STOPPED);
+		} break;
+		}
+
+		ALint processed = 0;
+		alGetSourcei(m->source, AL_BUFFERS_PROCESSED, &processed);
+		if (!_checkALError()) { setStoppedState(m, AudioPlayerStoppedAtError); return EmitError; }
+
+		auto unqueueProcessed = [m, &processed]() {
+			ALuint buffer = 0;
+			alSourceUnqueueBuffers(m->source, 1, &buffer);
+			if (!_checkALError()) return false;
+			--processed;
+
+			for (int i = 0; i < 3; ++i) {
+				if (m->buffers[i] == buffer) {
+					m->nextBuffer = i;
+					m->skipStart += m->samplesCount[i];
+					m->samplesCount[i] = 0;
+					return true;
+				}
+			}
+			LOG(("Audio Error: Could not find the unqueued buffer! Buffer %1 in source %2 with processed count %3").arg(buffer).arg(m->source).arg(processed));
+			return false;
+		};
+
+		// A stopped source would replay all the buffers that are still queued.
+		while (underrun && processed > 0) {
+			if (!unqueueProcessed()) { setStoppedState(m, AudioPlayerStoppedAtError); return EmitError; }
+		}
+
+		auto queued = false;
+		while (!prebuffer->empty()) {
+			if (m->samplesCount[m->nextBuffer]) {
+				if (processed < 1) break;
+				if (!unqueueProcessed()) { setStoppedState(m, AudioPlayerStoppedAtError); return EmitError; }
+			}
+
+			AudioPrebuffer::Chunk chunk;
+			prebuffer->pop(chunk);
+			m->samplesCount[m->nextBuffer] = chunk.samplesCount;
+			alBufferData(m->buffers[m->nextBuffer], prebuffer->format(), chunk.samples.constData(), chunk.samples.size(), prebuffer->frequency());
+			alSourceQueueBuffers(m->source, 1, m->buffers + m->nextBuffer);
+			if (!_checkALError()) { setStoppedState(m, AudioPlayerStoppedAtError); return EmitError; }
+
+			m->skipEnd -= chunk.samplesCount;
+			m->nextBuffer = (m->nextBuffer + 1) % 3;
+			queued = true;
+		}
+
+		if (underrun && queued) {
+			underrunsCount.fetchAndAddOrdered(1);
+			DEBUG_LOG(("Audio Info: playback underrun in source %1, restarting.").arg(m->source));
+			alSourcePlay(m->source);
+			if (!_checkALError()) { setStoppedState(m, AudioPlayerStoppedAtError); return EmitError; }
+		}
+	}
+
+	if (prebuffer->exhausted()) {
+		m->skipEnd = 0;
+		m->playbackState.duration = m->skipStart + m->samplesCount[0] + m->samplesCount[1] + m->samplesCount[2];
+		m->loading = false;
+		m->prebuffer = nullptr;
+	} else if (prebuffer->requestDecoding()) {
+		return EmitNeedToPreload;
+	}
+	return 0;
+}
+
 void AudioPlayerFader::setStoppedState(AudioPlayer::AudioMsg *m, AudioPlayerState state) {
 	m->playbackState.state = state;
 	m->playbackState.position = 0;
@@ -21,6 +21,7 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 #pragma once
 
 #include "core/basic_types.h"
+#include "core/spsc_queue.h"
 
 void audioInit();
 bool audioWorks();
@@ -55,6 +56,52 @@ struct AudioPlaybackState {
 	int32 frequency = 0;
 };
 
+// Decoded samples prepared by the loaders thread ahead of the playback position.
+// Chunks are pushed by the loaders thread and queued to OpenAL by the fader thread.
+class AudioPrebuffer {
+public:
+	struct Chunk {
+		QByteArray samples;
+		int64 samplesCount = 0;
+	};
+
+	AudioPrebuffer(int32 format, int32 frequency);
+
+	int32 format() const {
+		return _format;
+	}
+	int32 frequency() const {
+		return _frequency;
+	}
+	int64 targetSamples() const;
+	int64 bufferedSamples() const;
+	bool full() const;
+
+	// Loaders thread.
+	bool push(Chunk &&chunk);
+	void finish();
+	void decodingStarted();
+	void decodingStopped();
+
+	// Fader thread.
+	bool pop(Chunk &chunk);
+	bool empty() const;
+	bool exhausted() const;
+	bool requestDecoding();
+
+	void cancel();
+	bool cancelled() const;
+
+private:
+	int32 _format, _frequency;
+	base::spsc_queue<Chunk> _chunks;
+	QAtomicInt _bufferedSamples = 0;
+	QAtomicInt _finished = 0;
+	QAtomicInt _cancelled = 0;
+	QAtomicInt _decoding = 0;
+
+};
+
 class AudioPlayer : public QObject, public base::Observable<AudioMsgId>, private base::Subscriber {
 	Q_OBJECT
 
@@ -128,6 +175,8 @@ private:
 		uint32 buffers[3] = { 0 };
 		int64 samplesCount[3] = { 0 };
 
+		QSharedPointer<AudioPrebuffer> prebuffer;
+
 		uint64 videoPlayId = 0;
 		std_::unique_ptr<VideoSoundData> videoData;
 
@@ -176,6 +225,7 @@ QMutex *audioPlayerMutex();
 float64 audioSuppressGain();
 float64 audioSuppressSongGain();
 bool audioCheckError();
+int audioUnderrunsCount();
 
 } // namespace internal
 
@@ -245,6 +295,7 @@ private:
 		EmitNeedToPreload = 0x08,
 	};
 	int32 updateOnePlayback(AudioPlayer::AudioMsg *m, bool &hasPlaying, bool &hasFading, float64 suppressGain, bool suppressGainChanged);
+	int32 feedFromPrebuffer(AudioPlayer::AudioMsg *m);
 	void setStoppedState(AudioPlayer::AudioMsg *m, AudioPlayerState state = AudioPlayerStopped);
 
 	QTimer _timer, _pauseTimer;
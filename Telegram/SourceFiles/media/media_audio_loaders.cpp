@@ -100,6 +100,10 @@ void AudioPlayerLoaders::onStart(const AudioMsgId &audio, qint64 position) {
 		if (!data) return;
 
 		data->loading = true;
+		if (data->prebuffer) {
+			data->prebuffer->cancel();
+			data->prebuffer = nullptr;
+		}
 	}
 
 	loadData(audio, position);
@@ -108,8 +112,8 @@ void AudioPlayerLoaders::onStart(const AudioMsgId &audio, qint64 position) {
 AudioMsgId AudioPlayerLoaders::clear(AudioMsgId::Type type) {
 	AudioMsgId result;
 	switch (type) {
-	case AudioMsgId::Type::Voice: std::swap(result, _audio); _audioLoader = nullptr; break;
-	case AudioMsgId::Type::Song: std::swap(result, _song); _songLoader = nullptr; break;
+	case AudioMsgId::Type::Voice: std::swap(result, _audio); _audioLoader = nullptr; _audioPrebuffer = nullptr; break;
+	case AudioMsgId::Type::Song: std::swap(result, _song); _songLoader = nullptr; _songPrebuffer = nullptr; break;
 	case AudioMsgId::Type::Video: std::swap(result, _video); _videoLoader = nullptr; break;
 	}
 	return result;
@@ -125,9 +129,72 @@ void AudioPlayerLoaders::emitError(AudioMsgId::Type type) {
 }
 
 void AudioPlayerLoaders::onLoad(const AudioMsgId &audio) {
+	auto prebuffer = prebufferForType(audio.type());
+	auto isGoodId = false;
+	switch (audio.type()) {
+	case AudioMsgId::Type::Voice: isGoodId = (_audio == audio); break;
+	case AudioMsgId::Type::Song: isGoodId = (_song == audio); break;
+	}
+	if (prebuffer && *prebuffer && isGoodId) {
+		fillPrebuffer(audio.type());
+		return;
+	}
 	loadData(audio, 0);
 }
 
+QSharedPointer<AudioPrebuffer> *AudioPlayerLoaders::prebufferForType(AudioMsgId::Type type) {
+	switch (type) {
+	case AudioMsgId::Type::Voice: return &_audioPrebuffer;
+	case AudioMsgId::Type::Song: return &_songPrebuffer;
+	}
+	return nullptr;
+}
+
+void AudioPlayerLoaders::fillPrebuffer(AudioMsgId::Type type) {
+	auto prebuffer = *prebufferForType(type);
+	AudioPlayerLoader *l = nullptr;
+	switch (type) {
+	case AudioMsgId::Type::Voice: l = _audioLoader.get(); break;
+	case AudioMsgId::Type::Song: l = _songLoader.get(); break;
+	}
+	if (!l || !prebuffer) return;
+
+	// No audioPlayerMutex here, the fader checks the prebuffer by itself.
+	prebuffer->decodingStarted();
+	auto finished = false;
+	auto target = prebuffer->targetSamples();
+	while (!finished && !prebuffer->full() && prebuffer->bufferedSamples() < target) {
+		AudioPrebuffer::Chunk chunk;
+		auto waiting = false;
+		while (chunk.samples.size() < AudioVoiceMsgBufferSize) {
+			auto res = l->readMore(chunk.samples, chunk.samplesCount);
+			using Result = AudioPlayerLoader::ReadResult;
+			if (res == Result::Error || res == Result::EndOfFile) {
+				finished = true;
+				break;
+			} else if (res == Result::Wait) {
+				waiting = true;
+				break;
+			}
+			if (prebuffer->cancelled()) {
+				clear(type);
+				return;
+			}
+		}
+		if (chunk.samplesCount) {
+			prebuffer->push(std_::move(chunk));
+		}
+		if (waiting) break;
+	}
+
+	if (finished) {
+		prebuffer->finish();
+		clear(type);
+	} else {
+		prebuffer->decodingStopped();
+	}
+}
+
 void AudioPlayerLoaders::loadData(AudioMsgId audio, qint64 position) {
 	SetupError err = SetupNoErrorStarted;
 	auto type = audio.type();
@@ -288,7 +355,15 @@ void AudioPlayerLoaders::loadData(AudioMsgId audio, qint64 position) {
 		clear(type);
 	}
 
-	m->loading = false;
+	// Voice and song keep decoding ahead without the audioPlayerMutex.
+	auto prebuffer = started ? prebufferForType(type) : nullptr;
+	if (prebuffer && !finished) {
+		*prebuffer = MakeShared<AudioPrebuffer>(l->format(), l->frequency());
+		m->prebuffer = *prebuffer;
+	} else {
+		m->loading = false;
+		prebuffer = nullptr;
+	}
 	if (m->playbackState.state == AudioPlayerResuming || m->playbackState.state == AudioPlayerPlaying || m->playbackState.state == AudioPlayerStarting) {
 		ALint state = AL_INITIAL;
 		alGetSourcei(m->source, AL_SOURCE_STATE, &state);
@@ -319,8 +394,14 @@ void AudioPlayerLoaders::loadData(AudioMsgId audio, qint64 position) {
 		} else {
 			setStoppedState(m, AudioPlayerStoppedAtError);
 			emitError(type);
+			return;
 		}
 	}
+
+	if (prebuffer) {
+		lock.unlock();
+		fillPrebuffer(type);
+	}
 }
 
 AudioPlayerLoader *AudioPlayerLoaders::setupLoader(const AudioMsgId &audio, SetupError &err, qint64 &position) {
@@ -57,6 +57,10 @@ private:
 	std_::unique_ptr<AudioPlayerLoader> _songLoader;
 	std_::unique_ptr<ChildFFMpegLoader> _videoLoader;
 
+	// Voice and song are decoded ahead into the prebuffers, fader queues them to OpenAL.
+	QSharedPointer<AudioPrebuffer> _audioPrebuffer;
+	QSharedPointer<AudioPrebuffer> _songPrebuffer;
+
 	QMutex _fromVideoMutex;
 	uint64 _fromVideoPlayId;
 	QQueue<FFMpeg::AVPacketDataWrap> _fromVideoQueue;
@@ -73,6 +77,8 @@ private:
 		SetupNoErrorStarted = 3,
 	};
 	void loadData(AudioMsgId audio, qint64 position);
+	void fillPrebuffer(AudioMsgId::Type type);
+	QSharedPointer<AudioPrebuffer> *prebufferForType(AudioMsgId::Type type);
 	AudioPlayerLoader *setupLoader(const AudioMsgId &audio, SetupError &err, qint64 &position);
 	AudioPlayer::AudioMsg *checkLoader(AudioMsgId::Type type);
 
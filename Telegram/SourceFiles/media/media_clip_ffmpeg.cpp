@@ -306,6 +306,7 @@ bool FFMpegReaderImplementation::start(Mode mode, int64 &positionMs) {
 		return false;
 	}
 	_packetNull.stream_index = _streamId;
+	addKnownKeyframes();
 
 	auto rotateTag = av_dict_get(_fmtContext->streams[_streamId]->metadata, "rotate", NULL, 0);
 	if (rotateTag && *rotateTag->value) {
@@ -410,6 +411,73 @@ bool FFMpegReaderImplementation::start(Mode mode, int64 &positionMs) {
 	return true;
 }
 
+Keyframes FFMpegReaderImplementation::keyframes() const {
+	auto result = _readKeyframes;
+	if (!_opened || _streamId < 0 || _streamId >= int(_fmtContext->nb_streams)) {
+		return result;
+	}
+
+	// Keyframes from the container index usually cover the whole file.
+	auto stream = _fmtContext->streams[_streamId];
+	auto timeBase = stream->time_base;
+	auto indexed = Keyframes();
+	indexed.reserve(qMin(stream->nb_index_entries, int(ClipSidecarKeyframesLimit)));
+	for (auto i = 0; i != stream->nb_index_entries; ++i) {
+		auto &entry = stream->index_entries[i];
+		if (!(entry.flags & AVINDEX_KEYFRAME) || entry.pos < 0) {
+			continue;
+		}
+		Keyframe keyframe;
+		keyframe.positionMs = (entry.timestamp * 1000LL * timeBase.num) / timeBase.den;
+		keyframe.offset = entry.pos;
+		if (indexed.isEmpty() || indexed.back().positionMs < keyframe.positionMs) {
+			indexed.push_back(keyframe);
+		}
+	}
+	if (indexed.size() > result.size()) {
+		result = indexed;
+	}
+	if (result.size() > ClipSidecarKeyframesLimit) {
+		// Keep evenly distributed keyframes, seeking will decode a bit more.
+		auto limited = Keyframes();
+		limited.reserve(ClipSidecarKeyframesLimit);
+		for (auto i = 0; i != ClipSidecarKeyframesLimit; ++i) {
+			limited.push_back(result[(i * result.size()) / ClipSidecarKeyframesLimit]);
+		}
+		result = limited;
+	}
+	return result;
+}
+
+void FFMpegReaderImplementation::addKnownKeyframes() {
+	auto stream = _fmtContext->streams[_streamId];
+	if (_knownKeyframes.isEmpty() || stream->nb_index_entries > 0) {
+		return;
+	}
+
+	// Containers without an index (gif, webm without cues) make
+	// av_seek_frame() search the file, so we give it the index we saved.
+	auto timeBase = stream->time_base;
+	for_const (auto &keyframe, _knownKeyframes) {
+		auto timestamp = (keyframe.positionMs * timeBase.den) / (1000LL * timeBase.num);
+		av_add_index_entry(stream, keyframe.offset, timestamp, 0, 0, AVINDEX_KEYFRAME);
+	}
+}
+
+void FFMpegReaderImplementation::rememberKeyframe(AVPacket *packet) {
+	if (!(packet->flags & AV_PKT_FLAG_KEY) || packet->pos < 0) {
+		return;
+	}
+	auto positionMs = countPacketMs(packet);
+	if (!_readKeyframes.isEmpty() && _readKeyframes.back().positionMs >= positionMs) {
+		return; // looped or seeked back
+	}
+	Keyframe keyframe;
+	keyframe.positionMs = positionMs;
+	keyframe.offset = packet->pos;
+	_readKeyframes.push_back(keyframe);
+}
+
 QString FFMpegReaderImplementation::logData() const {
 	return qsl("for file '%1', data size '%2'").arg(_location ? _location->name() : QString()).arg(_data->size());
 }
@@ -470,6 +538,7 @@ void FFMpegReaderImplementation::processPacket(AVPacket *packet) {
 	if (audioPacket || videoPacket) {
 		if (videoPacket) {
 			_lastReadVideoMs = countPacketMs(packet);
+			rememberKeyframe(packet);
 
 			_packetQueue.enqueue(FFMpeg::dataWrapFromPacket(*packet));
 		} else if (audioPacket) {
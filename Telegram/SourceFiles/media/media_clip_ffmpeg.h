@@ -53,6 +53,8 @@ public:
 
 	bool start(Mode mode, int64 &positionMs) override;
 
+	Keyframes keyframes() const override;
+
 	QString logData() const;
 
 	~FFMpegReaderImplementation();
@@ -82,6 +84,9 @@ private:
 		return (_rotation == Rotation::Degrees90) || (_rotation == Rotation::Degrees270);
 	}
 
+	void addKnownKeyframes();
+	void rememberKeyframe(AVPacket *packet);
+
 	void startPacket();
 	void finishPacket();
 	void clearPacketQueue();
@@ -127,6 +132,8 @@ private:
 	int64 _frameTime = 0;
 	int64 _frameTimeCorrection = 0;
 
+	Keyframes _readKeyframes;
+
 };
 
 } // namespace internal
@@ -26,6 +26,12 @@ namespace Media {
 namespace Clip {
 namespace internal {
 
+struct Keyframe {
+	int64 positionMs = 0;
+	int64 offset = 0; // byte offset of the keyframe packet in the file
+};
+using Keyframes = QVector<Keyframe>;
+
 class ReaderImplementation {
 public:
 	ReaderImplementation(FileLocation *location, QByteArray *data)
@@ -59,6 +65,16 @@ public:
 	virtual void resumeAudio() = 0;
 
 	virtual bool start(Mode mode, int64 &positionMs) = 0;
+
+	// Keyframes found in the file, they can be passed to the next
+	// start() of the same file so that seeking does not need to search.
+	virtual Keyframes keyframes() const {
+		return Keyframes();
+	}
+	void setKnownKeyframes(const Keyframes &keyframes) {
+		_knownKeyframes = keyframes;
+	}
+
 	virtual ~ReaderImplementation() {
 	}
 	int64 dataSize() const {
@@ -72,6 +88,7 @@ protected:
 	QBuffer _buffer;
 	QIODevice *_device = nullptr;
 	int64 _dataSize = 0;
+	Keyframes _knownKeyframes;
 
 	void initDevice();
 
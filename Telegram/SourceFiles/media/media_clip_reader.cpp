@@ -30,8 +30,10 @@ extern "C" {
 
 #include "media/media_clip_ffmpeg.h"
 #include "media/media_clip_qtgif.h"
+#include "media/media_clip_shared_frames.h"
 #include "mainwidget.h"
 #include "mainwindow.h"
+#include "localstorage.h"
 
 namespace Media {
 namespace Clip {
@@ -83,6 +85,78 @@ QPixmap _prepareFrame(const FrameRequest &request, const QImage &original, bool
 	return QPixmap::fromImage(original, Qt::ColorOnly);
 }
 
+constexpr qint32 kSidecarVersion = 1;
+
+struct Sidecar {
+	QSize dimensions;
+	int64 durationMs = 0;
+	QImage cover;
+	bool coverAlpha = false;
+	internal::Keyframes keyframes;
+};
+
+QByteArray serializeSidecar(const Sidecar &sidecar) {
+	QByteArray cover;
+	if (!sidecar.cover.isNull()) {
+		QBuffer buffer(&cover);
+		sidecar.cover.save(&buffer, sidecar.coverAlpha ? "PNG" : "JPG", sidecar.coverAlpha ? -1 : 87);
+	}
+
+	QByteArray result;
+	{
+		QDataStream stream(&result, QIODevice::WriteOnly);
+		stream.setVersion(QDataStream::Qt_5_1);
+		stream << kSidecarVersion << qint32(sidecar.dimensions.width()) << qint32(sidecar.dimensions.height());
+		stream << qint64(sidecar.durationMs) << cover << qint32(sidecar.coverAlpha ? 1 : 0);
+		stream << quint32(sidecar.keyframes.size());
+		for_const (auto &keyframe, sidecar.keyframes) {
+			stream << qint64(keyframe.positionMs) << qint64(keyframe.offset);
+		}
+	}
+	return result;
+}
+
+bool parseSidecar(const QByteArray &data, Sidecar &sidecar) {
+	QDataStream stream(data);
+	stream.setVersion(QDataStream::Qt_5_1);
+
+	qint32 version = 0, width = 0, height = 0, coverAlpha = 0;
+	qint64 durationMs = 0;
+	QByteArray cover;
+	quint32 keyframesCount = 0;
+	stream >> version;
+	if (version != kSidecarVersion) {
+		return false;
+	}
+	stream >> width >> height >> durationMs >> cover >> coverAlpha >> keyframesCount;
+	if (stream.status() != QDataStream::Ok || width <= 0 || height <= 0 || keyframesCount > ClipSidecarKeyframesLimit) {
+		return false;
+	}
+	sidecar.keyframes.reserve(keyframesCount);
+	for (quint32 i = 0; i != keyframesCount; ++i) {
+		qint64 positionMs = 0, offset = 0;
+		stream >> positionMs >> offset;
+		internal::Keyframe keyframe;
+		keyframe.positionMs = positionMs;
+		keyframe.offset = offset;
+		sidecar.keyframes.push_back(keyframe);
+	}
+	if (stream.status() != QDataStream::Ok) {
+		return false;
+	}
+	sidecar.dimensions = QSize(width, height);
+	sidecar.durationMs = durationMs;
+	sidecar.coverAlpha = (coverAlpha != 0);
+	if (!cover.isEmpty()) {
+		sidecar.cover = App::readImage(cover, nullptr, false);
+		if (sidecar.cover.isNull()) {
+			return false;
+		}
+		sidecar.cover = sidecar.cover.convertToFormat(QImage::Format_ARGB32);
+	}
+	return true;
+}
+
 } // namespace
 
 Reader::Reader(const FileLocation &location, const QByteArray &data, Callback &&callback, Mode mode, int64 seekMs)
@@ -90,6 +164,20 @@ Reader::Reader(const FileLocation &location, const QByteArray &data, Callback &&
 , _mode(mode)
 , _playId(rand_value<uint64>())
 , _seekPositionMs(seekMs) {
+	init(location, data, Local::ClipSidecarFile());
+}
+
+Reader::Reader(DocumentData *document, Callback &&callback, Mode mode, int64 seekMs)
+: _callback(std_::move(callback))
+, _mode(mode)
+, _playId(rand_value<uint64>())
+, _seekPositionMs(seekMs)
+, _sidecarKey(document->mediaKey())
+, _saveSidecar(document->isValid()) {
+	init(document->location(), document->data(), _saveSidecar ? Local::clipSidecarFile(_sidecarKey) : Local::ClipSidecarFile());
+}
+
+void Reader::init(const FileLocation &location, const QByteArray &data, const Local::ClipSidecarFile &sidecar) {
 	if (threads.size() < ClipThreadsCount) {
 		_threadIndex = threads.size();
 		threads.push_back(new QThread());
@@ -106,7 +194,7 @@ Reader::Reader(const FileLocation &location, const QByteArray &data, Callback &&
 			}
 		}
 	}
-	managers.at(_threadIndex)->append(this, location, data);
+	managers.at(_threadIndex)->append(this, location, data, sidecar);
 }
 
 Reader::Frame *Reader::frameToShow(int32 *index) const { // 0 means not ready
@@ -180,8 +268,14 @@ void Reader::moveToNextWrite() const {
 
 void Reader::callback(Reader *reader, int32 threadIndex, Notification notification) {
 	// check if reader is not deleted already
-	if (managers.size() > threadIndex && managers.at(threadIndex)->carries(reader) && reader->_callback) {
-		reader->_callback(notification);
+	if (managers.size() > threadIndex && managers.at(threadIndex)->carries(reader)) {
+		auto sidecar = managers.at(threadIndex)->takeSidecar(reader);
+		if (!sidecar.isEmpty() && reader->_saveSidecar) {
+			Local::writeClipSidecar(reader->_sidecarKey, sidecar);
+		}
+		if (reader->_callback) {
+			reader->_callback(notification);
+		}
 	}
 }
 
@@ -255,8 +349,12 @@ bool Reader::ready() const {
 
 	Frame *frame = frameToShow();
 	if (frame) {
-		_width = frame->original.width();
-		_height = frame->original.height();
+		// The first frame may be a cover from the sidecar,
+		// the original size is set by the Manager in that case.
+		if (!_width || !_height) {
+			_width = frame->original.width();
+			_height = frame->original.height();
+		}
 		return true;
 	}
 	return false;
@@ -325,11 +423,13 @@ Reader::~Reader() {
 
 class ReaderPrivate {
 public:
-	ReaderPrivate(Reader *reader, const FileLocation &location, const QByteArray &data) : _interface(reader)
+	ReaderPrivate(Reader *reader, const FileLocation &location, const QByteArray &data, const Local::ClipSidecarFile &sidecar) : _interface(reader)
 	, _mode(reader->mode())
 	, _playId(reader->playId())
 	, _seekPositionMs(reader->seekPositionMs())
-	, _data(data) {
+	, _data(data)
+	, _sidecarFile(sidecar)
+	, _sidecarWanted(reader->_saveSidecar) {
 		if (_data.isEmpty()) {
 			_location = std_::make_unique<FileLocation>(location);
 			if (!_location->accessEnable()) {
@@ -341,8 +441,17 @@ public:
 	}
 
 	ProcessResult start(uint64 ms) {
-		if (!_implementation && !init()) {
-			return error();
+		if (!_implementation && !_startedFromSidecar) {
+			auto sidecarData = _sidecarFile ? base::take(_sidecarFile).read() : QByteArray();
+			if (!sidecarData.isEmpty() && !parseSidecar(sidecarData, _sidecar)) {
+				_sidecar = Sidecar();
+			}
+			if (startFromSidecar()) {
+				return ProcessResult::Started;
+			}
+			if (!init()) {
+				return error();
+			}
 		}
 		if (frame() && frame()->original.isNull()) {
 			auto readResult = _implementation->readFramesTill(-1, ms);
@@ -383,11 +492,58 @@ public:
 			_height = frame()->original.height();
 			_durationMs = _implementation->durationMs();
 			_hasAudio = _implementation->hasAudio();
+			if (_seekPositionMs <= 0) {
+				_firstFrame = frame()->original;
+				_firstFrameAlpha = frame()->alpha;
+			}
 			return ProcessResult::Started;
 		}
 		return ProcessResult::Wait;
 	}
 
+	// Gif readers show the first frame from the sidecar without opening the file,
+	// the decoder is started only when the next frame is needed.
+	bool startFromSidecar() {
+		if (_mode != Reader::Mode::Gif || _seekPositionMs > 0 || _sidecar.cover.isNull()) {
+			return false;
+		}
+		_startedFromSidecar = true;
+		frame()->original = _sidecar.cover;
+		frame()->alpha = _sidecar.coverAlpha;
+		frame()->positionMs = 0;
+
+		_width = _sidecar.dimensions.width();
+		_height = _sidecar.dimensions.height();
+		_durationMs = _sidecar.durationMs;
+		_hasAudio = false;
+		return true;
+	}
+
+	// Called when the first frame request is known and when the clip is finished.
+	void updateSidecar() {
+		if (!_sidecarWanted || !_implementation) {
+			return;
+		}
+		auto changed = false;
+		if (_sidecar.cover.isNull() && !_firstFrame.isNull()) {
+			// Any later request size is prepared from the full size cover, like from a decoded frame.
+			_sidecar.cover = _firstFrame;
+			_sidecar.coverAlpha = _firstFrameAlpha;
+			_firstFrame = QImage();
+			changed = true;
+		}
+		auto keyframes = _implementation->keyframes();
+		if (keyframes.size() > _sidecar.keyframes.size()) {
+			_sidecar.keyframes = keyframes;
+			changed = true;
+		}
+		if (changed && _width > 0 && _height > 0) {
+			_sidecar.dimensions = QSize(_width, _height);
+			_sidecar.durationMs = _durationMs;
+			_sidecarReady = serializeSidecar(_sidecar);
+		}
+	}
+
 	ProcessResult process(uint64 ms) { // -1 - do nothing, 0 - update, 1 - reinit
 		if (_state == State::Error) {
 			return ProcessResult::Error;
@@ -400,9 +556,10 @@ public:
 		}
 		if (!_started) {
 			_started = true;
-			if (!_videoPausedAtMs) {
+			if (!_videoPausedAtMs && _implementation) {
 				_implementation->resumeAudio();
 			}
+			updateSidecar();
 		}
 
 		if (!_autoPausedGif && !_videoPausedAtMs && ms >= _nextFrameWhen) {
@@ -412,9 +569,21 @@ public:
 	}
 
 	ProcessResult finishProcess(uint64 ms) {
+		if (sharedFramesReady()) {
+			return finishProcessShared(ms);
+		}
+		if (!_implementation) {
+			// We were playing from the shared frames, but the frame size has changed.
+			if (!init()) {
+				return error();
+			}
+			startedAt(ms);
+		}
+
 		auto frameMs = _seekPositionMs + ms - _animationStarted;
 		auto readResult = _implementation->readFramesTill(frameMs, ms);
 		if (readResult == internal::ReaderImplementation::ReadResult::EndOfFile) {
+			updateSidecar();
 			stop();
 			_state = State::Finished;
 			return ProcessResult::Finished;
@@ -432,9 +601,98 @@ public:
 		if (!renderFrame()) {
 			return error();
 		}
+		recordSharedFrame();
+		return ProcessResult::CopyFrame;
+	}
+
+	ProcessResult finishProcessShared(uint64 ms) {
+		auto loopMs = _shared->loopMs();
+		auto frameMs = static_cast<int64>(ms - _animationStarted);
+		auto loopStartMs = frameMs - (frameMs % loopMs);
+		auto index = _shared->frameIndex(frameMs - loopStartMs);
+		auto &shared = _shared->frame(index);
+
+		// Shared images already have the request device pixel ratio,
+		// so they are not detached when they are assigned here.
+		frame()->original = shared.original;
+		frame()->alpha = shared.alpha;
+		frame()->pix = QPixmap();
+		frame()->pix = _prepareFrame(_request, frame()->original, frame()->alpha, frame()->cache);
+
+		auto nextIndex = index + 1;
+		auto nextFrameMs = loopStartMs + ((nextIndex < _shared->count()) ? _shared->frame(nextIndex).positionMs : loopMs);
+		_nextFrameWhen = _animationStarted + qMax(nextFrameMs, frameMs + 1);
+		_nextFramePositionMs = shared.positionMs;
+		frame()->when = _nextFrameWhen;
+		frame()->positionMs = _nextFramePositionMs;
 		return ProcessResult::CopyFrame;
 	}
 
+	// Gif readers of the same animation with the same frame size share one decoded loop of frames.
+	bool sharedFramesReady() {
+		if (_mode != Reader::Mode::Gif || _seekPositionMs > 0) {
+			return false;
+		}
+		auto size = QSize(_request.framew, _request.frameh);
+		if (_shared && _shared->size() != size) {
+			releaseSharedFrames();
+		}
+		if (!_shared) {
+			if (_sharedSource.isEmpty()) {
+				_sharedSource = internal::SharedFramesSource(_location.get(), _data);
+				if (_sharedSource.isEmpty()) {
+					return false;
+				}
+			}
+			_shared = internal::AcquireSharedFrames(_sharedSource, size, &_sharedRecording);
+			_sharedLastPositionMs = -1;
+			_sharedRecordingStarted = false;
+		}
+		if (!_shared->complete()) {
+			return false;
+		}
+		if (_implementation) {
+			// Nobody needs our own decoder anymore.
+			_implementation = nullptr;
+			_sharedRecording = false;
+		}
+		return true;
+	}
+
+	void recordSharedFrame() {
+		if (!_shared || !_sharedRecording) {
+			return;
+		}
+
+		// The first loop frame was rendered in the original size,
+		// so we start recording from the beginning of the next loop.
+		auto positionMs = _nextFramePositionMs;
+		auto looped = (positionMs <= _sharedLastPositionMs);
+		if (looped && _sharedRecordingStarted) {
+			auto lastPositionMs = _sharedLastPositionMs;
+			auto lastFrameDelay = (_shared->count() > 1) ? (lastPositionMs - _shared->frame(_shared->count() - 2).positionMs) : 0LL;
+			auto loopMs = qMax(qMax(_durationMs, lastPositionMs + lastFrameDelay), 1LL);
+			internal::FinishSharedFrames(_shared, loopMs);
+			_sharedRecording = false;
+			return;
+		}
+		_sharedLastPositionMs = positionMs;
+		if (looped) {
+			_sharedRecordingStarted = true;
+		}
+		if (_sharedRecordingStarted && !internal::AppendSharedFrame(_shared, frame()->original, frame()->alpha, positionMs)) {
+			_sharedRecording = false;
+		}
+	}
+
+	void releaseSharedFrames() {
+		if (_shared) {
+			internal::ReleaseSharedFrames(_shared);
+			_shared = internal::SharedFramesPointer();
+		}
+		_sharedRecording = false;
+	}
+
 	bool renderFrame() {
 		t_assert(frame() != 0 && _request.valid());
 		if (!_implementation->renderFrame(frame()->original, frame()->alpha, QSize(_request.framew, _request.frameh))) {
@@ -461,6 +719,7 @@ public:
 
 		_implementation = std_::make_unique<internal::FFMpegReaderImplementation>(_location.get(), &_data, _playId);
 //		_implementation = new QtGifReaderImplementation(_location, &_data);
+		_implementation->setKnownKeyframes(_sidecar.keyframes);
 
 		auto implementationMode = [this]() {
 			using ImplementationMode = internal::ReaderImplementation::Mode;
@@ -480,7 +739,9 @@ public:
 		if (_videoPausedAtMs) return; // Paused already.
 
 		_videoPausedAtMs = ms;
-		_implementation->pauseAudio();
+		if (_implementation) {
+			_implementation->pauseAudio();
+		}
 	}
 
 	void resumeVideo(uint64 ms) {
@@ -491,7 +752,9 @@ public:
 		_nextFrameWhen += delta;
 
 		_videoPausedAtMs = 0;
-		_implementation->resumeAudio();
+		if (_implementation) {
+			_implementation->resumeAudio();
+		}
 	}
 
 	ProcessResult error() {
@@ -513,6 +776,7 @@ public:
 	}
 
 	~ReaderPrivate() {
+		releaseSharedFrames();
 		stop();
 		_data.clear();
 	}
@@ -560,6 +824,20 @@ private:
 	bool _started = false;
 	uint64 _videoPausedAtMs = 0;
 
+	Local::ClipSidecarFile _sidecarFile; // read once in the first start()
+	Sidecar _sidecar;
+	bool _sidecarWanted = false;
+	bool _startedFromSidecar = false;
+	QByteArray _sidecarReady;
+	QImage _firstFrame;
+	bool _firstFrameAlpha = false;
+
+	QByteArray _sharedSource;
+	internal::SharedFramesPointer _shared;
+	bool _sharedRecording = false;
+	bool _sharedRecordingStarted = false;
+	int64 _sharedLastPositionMs = -1;
+
 	friend class Manager;
 
 };
@@ -577,8 +855,8 @@ Manager::Manager(QThread *thread) : _processingInThread(0), _needReProcess(false
 	anim::registerClipManager(this);
 }
 
-void Manager::append(Reader *reader, const FileLocation &location, const QByteArray &data) {
-	reader->_private = new ReaderPrivate(reader, location, data);
+void Manager::append(Reader *reader, const FileLocation &location, const QByteArray &data, const Local::ClipSidecarFile &sidecar) {
+	reader->_private = new ReaderPrivate(reader, location, data, sidecar);
 	_loadLevel.fetchAndAddRelaxed(AverageGifSize);
 	update(reader);
 }
@@ -611,6 +889,11 @@ bool Manager::carries(Reader *reader) const {
 	return _readerPointers.contains(reader);
 }
 
+QByteArray Manager::takeSidecar(Reader *reader) {
+	QMutexLocker lock(&_readerPointersMutex);
+	return base::take(reader->_sidecarToSave);
+}
+
 Manager::ReaderPointers::iterator Manager::unsafeFindReaderPointer(ReaderPrivate *reader) {
 	ReaderPointers::iterator it = _readerPointers.find(reader->_interface);
 
@@ -628,6 +911,10 @@ Manager::ReaderPointers::const_iterator Manager::constUnsafeFindReaderPointer(Re
 bool Manager::handleProcessResult(ReaderPrivate *reader, ProcessResult result, uint64 ms) {
 	QMutexLocker lock(&_readerPointersMutex);
 	auto it = unsafeFindReaderPointer(reader);
+	if (it != _readerPointers.cend() && !reader->_sidecarReady.isEmpty()) {
+		// Will be saved in Reader::callback() on the main thread.
+		it.key()->_sidecarToSave = base::take(reader->_sidecarReady);
+	}
 	if (result == ProcessResult::Error) {
 		if (it != _readerPointers.cend()) {
 			it.key()->error();
@@ -650,6 +937,8 @@ bool Manager::handleProcessResult(ReaderPrivate *reader, ProcessResult result, u
 		_loadLevel.fetchAndAddRelaxed(reader->_width * reader->_height - AverageGifSize);
 		it.key()->_durationMs = reader->_durationMs;
 		it.key()->_hasAudio = reader->_hasAudio;
+		it.key()->_width = reader->_width;
+		it.key()->_height = reader->_height;
 	}
 	// See if we need to pause GIF because it is not displayed right now.
 	if (!reader->_autoPausedGif && reader->_mode == Reader::Mode::Gif && result == ProcessResult::Repaint) {
@@ -858,6 +1147,9 @@ MTPDocumentAttribute readAttributes(const QString &fname, const QByteArray &data
 }
 
 void Finish() {
+	auto stats = internal::GetSharedFramesStats();
+	LOG(("Clip Info: shared frames cache had %1 hits, %2 misses, %3 bytes in %4 entries.").arg(stats.hits).arg(stats.misses).arg(stats.bytes).arg(stats.entries));
+
 	if (!threads.isEmpty()) {
 		for (int32 i = 0, l = threads.size(); i < l; ++i) {
 			threads.at(i)->quit();
@@ -869,6 +1161,7 @@ void Finish() {
 		threads.clear();
 		managers.clear();
 	}
+	internal::ClearSharedFrames();
 }
 
 } // namespace Clip
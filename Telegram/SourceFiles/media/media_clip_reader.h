@@ -21,6 +21,11 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 #pragma once
 
 class FileLocation;
+class DocumentData;
+
+namespace Local {
+class ClipSidecarFile;
+} // namespace Local
 
 namespace Media {
 namespace Clip {
@@ -59,6 +64,10 @@ public:
 	};
 
 	Reader(const FileLocation &location, const QByteArray &data, Callback &&callback, Mode mode = Mode::Gif, int64 seekMs = 0);
+
+	// Uses and updates the locally stored sidecar of the document:
+	// the first frame, the dimensions, the duration and the keyframes index.
+	Reader(DocumentData *document, Callback &&callback, Mode mode = Mode::Gif, int64 seekMs = 0);
 	static void callback(Reader *reader, int threadIndex, Notification notification); // reader can be deleted
 
 	void setAutoplay() {
@@ -122,6 +131,7 @@ public:
 	~Reader();
 
 private:
+	void init(const FileLocation &location, const QByteArray &data, const Local::ClipSidecarFile &sidecar);
 
 	Callback _callback;
 	Mode _mode;
@@ -165,7 +175,12 @@ private:
 
 	bool _autoplay = false;
 
+	MediaKey _sidecarKey;
+	bool _saveSidecar = false;
+	QByteArray _sidecarToSave; // guarded by Manager::_readerPointersMutex
+
 	friend class Manager;
+	friend class ReaderPrivate;
 
 	ReaderPrivate *_private = nullptr;
 
@@ -195,11 +210,12 @@ public:
 	int32 loadLevel() const {
 		return _loadLevel.load();
 	}
-	void append(Reader *reader, const FileLocation &location, const QByteArray &data);
+	void append(Reader *reader, const FileLocation &location, const QByteArray &data, const Local::ClipSidecarFile &sidecar);
 	void start(Reader *reader);
 	void update(Reader *reader);
 	void stop(Reader *reader);
 	bool carries(Reader *reader) const;
+	QByteArray takeSidecar(Reader *reader);
 	~Manager();
 
 signals:
@@ -0,0 +1,253 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop version of Telegram messaging app, see https://telegram.org
+
+Telegram Desktop is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+In addition, as a special exception, the copyright holders give permission
+to link the code of portions of this program with the OpenSSL library.
+
+Full license: https://github.com/telegramdesktop/tdesktop/blob/master/LICENSE
+Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
+*/
+#include "stdafx.h"
+#include "media/media_clip_shared_frames.h"
+
+namespace Media {
+namespace Clip {
+namespace internal {
+
+class FramesCache {
+public:
+	SharedFramesPointer acquire(const QByteArray &source, QSize size, bool *record);
+	bool append(const SharedFramesPointer &frames, const QImage &original, bool alpha, int64 positionMs);
+	void finish(const SharedFramesPointer &frames, int64 loopMs);
+	void release(const SharedFramesPointer &frames);
+
+	SharedFramesStats stats() const;
+	void clear();
+
+private:
+	using Key = QPair<QByteArray, QPair<int, int>>;
+	static Key keyFor(const QByteArray &source, QSize size) {
+		return qMakePair(source, qMakePair(size.width(), size.height()));
+	}
+
+	void dropFrames(SharedFrames *frames);
+	void evictUnused();
+
+	mutable QMutex _mutex;
+	QMap<Key, SharedFramesPointer> _entries;
+
+	// Last animations that did not fit in SharedClipFramesEntryLimit, they are not recorded again.
+	QList<Key> _uncacheable;
+	uint64 _useCounter = 0;
+	int64 _bytes = 0;
+	int64 _hits = 0;
+	int64 _misses = 0;
+
+};
+
+namespace {
+
+FramesCache Cache;
+
+int64 imageBytes(const QImage &image) {
+	return static_cast<int64>(image.bytesPerLine()) * image.height();
+}
+
+} // namespace
+
+int SharedFrames::frameIndex(int64 loopPositionMs) const {
+	auto i = std::upper_bound(_frames.cbegin(), _frames.cend(), loopPositionMs, [](int64 positionMs, const SharedFrame &frame) {
+		return positionMs < frame.positionMs;
+	});
+	return (i == _frames.cbegin()) ? 0 : static_cast<int>(i - _frames.cbegin()) - 1;
+}
+
+SharedFramesPointer FramesCache::acquire(const QByteArray &source, QSize size, bool *record) {
+	QMutexLocker lock(&_mutex);
+
+	auto key = keyFor(source, size);
+	auto i = _entries.find(key);
+	if (i == _entries.cend()) {
+		i = _entries.insert(key, MakeShared<SharedFrames>(source, size));
+		i.value()->_uncacheable = _uncacheable.contains(key);
+	}
+	auto frames = i.value();
+	++frames->_users;
+	frames->_lastUsed = ++_useCounter;
+	if (frames->complete()) {
+		++_hits;
+		*record = false;
+	} else {
+		++_misses;
+		*record = !frames->_recording && !frames->_uncacheable;
+		if (*record) {
+			frames->_recording = true;
+		}
+	}
+	return frames;
+}
+
+bool FramesCache::append(const SharedFramesPointer &frames, const QImage &original, bool alpha, int64 positionMs) {
+	QMutexLocker lock(&_mutex);
+
+	t_assert(frames->_recording);
+	auto bytes = imageBytes(original);
+	if (frames->_bytes + bytes > SharedClipFramesEntryLimit) {
+		dropFrames(frames.data());
+		frames->_uncacheable = true;
+		_uncacheable.push_back(keyFor(frames->_source, frames->_size));
+		if (_uncacheable.size() > SharedClipUncacheableLimit) {
+			_uncacheable.pop_front();
+		}
+		return false;
+	}
+
+	SharedFrame frame;
+	frame.original = original;
+	frame.alpha = alpha;
+	frame.positionMs = positionMs;
+	frames->_frames.push_back(frame);
+	frames->_bytes += bytes;
+	_bytes += bytes;
+	return true;
+}
+
+void FramesCache::finish(const SharedFramesPointer &frames, int64 loopMs) {
+	QMutexLocker lock(&_mutex);
+
+	t_assert(frames->_recording);
+	frames->_recording = false;
+	if (frames->_frames.isEmpty() || loopMs <= 0) {
+		dropFrames(frames.data());
+		return;
+	}
+	frames->_loopMs = loopMs;
+	frames->_complete.storeRelease(1);
+
+	evictUnused();
+
+	DEBUG_LOG(("Clip Info: shared frames %1x%2 cached, %3 frames, %4 bytes. Total %5 bytes in %6 entries, %7 hits, %8 misses.").arg(frames->_size.width()).arg(frames->_size.height()).arg(frames->_frames.size()).arg(frames->_bytes).arg(_bytes).arg(_entries.size()).arg(_hits).arg(_misses));
+}
+
+void FramesCache::release(const SharedFramesPointer &frames) {
+	QMutexLocker lock(&_mutex);
+
+	t_assert(frames->_users > 0);
+	--frames->_users;
+	if (frames->_recording) {
+		// The recording reader was destroyed before it decoded a full loop.
+		frames->_recording = false;
+		dropFrames(frames.data());
+	}
+	if (!frames->_users && !frames->complete()) {
+		_entries.remove(keyFor(frames->_source, frames->_size));
+	} else {
+		evictUnused();
+	}
+}
+
+void FramesCache::dropFrames(SharedFrames *frames) {
+	_bytes -= frames->_bytes;
+	frames->_bytes = 0;
+	frames->_frames.clear();
+}
+
+void FramesCache::evictUnused() {
+	while (_bytes > SharedClipFramesLimit) {
+		auto oldest = _entries.end();
+		for (auto i = _entries.begin(), e = _entries.end(); i != e; ++i) {
+			auto frames = i.value().data();
+			if (frames->_users || !frames->complete()) {
+				continue;
+			}
+			if (oldest == _entries.end() || frames->_lastUsed < oldest.value()->_lastUsed) {
+				oldest = i;
+			}
+		}
+		if (oldest == _entries.end()) {
+			break;
+		}
+		dropFrames(oldest.value().data());
+		_entries.erase(oldest);
+	}
+}
+
+SharedFramesStats FramesCache::stats() const {
+	QMutexLocker lock(&_mutex);
+
+	SharedFramesStats result;
+	result.hits = _hits;
+	result.misses = _misses;
+	result.bytes = _bytes;
+	result.entries = _entries.size();
+	return result;
+}
+
+void FramesCache::clear() {
+	QMutexLocker lock(&_mutex);
+
+	for_const (auto &frames, _entries) {
+		frames->_frames.clear();
+		frames->_bytes = 0;
+	}
+	_entries.clear();
+	_uncacheable.clear();
+	_bytes = 0;
+}
+
+QByteArray SharedFramesSource(const FileLocation *location, const QByteArray &data) {
+	auto result = QByteArray();
+	if (!data.isEmpty()) {
+		HashMd5 md5(data.constData(), data.size());
+		result.reserve(1 + 16 + sizeof(int32));
+		result.append('m');
+		result.append(reinterpret_cast<const char*>(md5.result()), 16);
+		int32 size = data.size();
+		result.append(reinterpret_cast<const char*>(&size), sizeof(size));
+	} else if (location && !location->isEmpty()) {
+		result.append('f');
+		result.append(location->name().toUtf8());
+		result.append(QByteArray::number(location->size));
+		result.append(QByteArray::number(location->modified.toMSecsSinceEpoch()));
+	}
+	return result;
+}
+
+SharedFramesPointer AcquireSharedFrames(const QByteArray &source, QSize size, bool *record) {
+	return Cache.acquire(source, size, record);
+}
+
+bool AppendSharedFrame(const SharedFramesPointer &frames, const QImage &original, bool alpha, int64 positionMs) {
+	return Cache.append(frames, original, alpha, positionMs);
+}
+
+void FinishSharedFrames(const SharedFramesPointer &frames, int64 loopMs) {
+	Cache.finish(frames, loopMs);
+}
+
+void ReleaseSharedFrames(const SharedFramesPointer &frames) {
+	Cache.release(frames);
+}
+
+SharedFramesStats GetSharedFramesStats() {
+	return Cache.stats();
+}
+
+void ClearSharedFrames() {
+	Cache.clear();
+}
+
+} // namespace internal
+} // namespace Clip
+} // namespace Media
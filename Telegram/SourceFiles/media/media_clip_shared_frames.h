@@ -0,0 +1,112 @@
+/*
+This file is part of Telegram Desktop,
+the official desktop version of Telegram messaging app, see https://telegram.org
+
+Telegram Desktop is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+It is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+In addition, as a special exception, the copyright holders give permission
+to link the code of portions of this program with the OpenSSL library.
+
+Full license: https://github.com/telegramdesktop/tdesktop/blob/master/LICENSE
+Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
+*/
+#pragma once
+
+class FileLocation;
+
+namespace Media {
+namespace Clip {
+namespace internal {
+
+struct SharedFrame {
+	QImage original;
+	bool alpha = true;
+
+	// Real time of the frame inside one loop of the animation.
+	int64 positionMs = 0;
+};
+
+// Decoded frames of one animation loop at one frame size, filled by
+// the first reader that decodes it and used by all the other readers
+// of the same animation with the same frame size instead of decoding.
+class SharedFrames {
+public:
+	SharedFrames(const QByteArray &source, QSize size) : _source(source), _size(size) {
+	}
+
+	const QByteArray &source() const {
+		return _source;
+	}
+	QSize size() const {
+		return _size;
+	}
+
+	// After complete() returns true frames are never changed,
+	// so they can be read from any thread without locking.
+	bool complete() const {
+		return _complete.loadAcquire() != 0;
+	}
+	int count() const {
+		return _frames.size();
+	}
+	const SharedFrame &frame(int index) const {
+		return _frames.at(index);
+	}
+	int64 loopMs() const {
+		return _loopMs;
+	}
+	int frameIndex(int64 loopPositionMs) const;
+
+private:
+	friend class FramesCache;
+
+	QByteArray _source;
+	QSize _size;
+
+	QVector<SharedFrame> _frames;
+	int64 _bytes = 0;
+	int64 _loopMs = 0;
+	QAtomicInt _complete = 0;
+
+	bool _recording = false;
+	bool _uncacheable = false;
+	int _users = 0;
+	uint64 _lastUsed = 0;
+
+};
+using SharedFramesPointer = QSharedPointer<SharedFrames>;
+
+struct SharedFramesStats {
+	int64 hits = 0;
+	int64 misses = 0;
+	int64 bytes = 0;
+	int entries = 0;
+};
+
+// Unique source identifier for the animation in the file or in memory.
+QByteArray SharedFramesSource(const FileLocation *location, const QByteArray &data);
+
+// Returns frames for the source and frame size and sets "record" to true
+// if the caller should append the decoded frames of one full loop.
+// Each acquired pointer should be later released by ReleaseSharedFrames().
+SharedFramesPointer AcquireSharedFrames(const QByteArray &source, QSize size, bool *record);
+
+// Returns false if the recording was dropped, because of the memory limit.
+bool AppendSharedFrame(const SharedFramesPointer &frames, const QImage &original, bool alpha, int64 positionMs);
+void FinishSharedFrames(const SharedFramesPointer &frames, int64 loopMs);
+void ReleaseSharedFrames(const SharedFramesPointer &frames);
+
+SharedFramesStats GetSharedFramesStats();
+void ClearSharedFrames();
+
+} // namespace internal
+} // namespace Clip
+} // namespace Media
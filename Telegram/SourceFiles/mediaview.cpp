@@ -32,9 +32,38 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 #include "styles/style_mediaview.h"
 #include "media/media_audio.h"
 #include "history/history_media_types.h"
+#include "localimageloader.h"
 
 namespace {
 
+constexpr auto kPreloadAheadMs = 2000; // preload the media the user will flip to in that time
+
+class PreparePhotoTask : public Task {
+public:
+	PreparePhotoTask(MediaView *view, PhotoData *photo, const QImage &image, const QSize &size)
+		: _view(view)
+		, _photo(photo)
+		, _image(image)
+		, _size(size) {
+	}
+
+	void process() override {
+		if (_image.size() != _size) {
+			_image = _image.scaled(_size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+		}
+	}
+	void finish() override {
+		_view->photoPrepared(_photo, std_::move(_image));
+	}
+
+private:
+	MediaView *_view;
+	PhotoData *_photo;
+	QImage _image;
+	QSize _size;
+
+};
+
 class SaveMsgClickHandler : public ClickHandler {
 public:
 
@@ -100,8 +129,13 @@ MediaView::MediaView() : TWidget(App::wnd())
 	subscribe(FileDownload::ImageLoaded(), [this] {
 		if (!isHidden()) {
 			updateControls();
+			if (!_preloadedPhotos.isEmpty()) {
+				_prepareTimer.start(0);
+			}
 		}
 	});
+	_prepareTimer.setSingleShot(true);
+	connect(&_prepareTimer, SIGNAL(timeout()), this, SLOT(onPreparePhotos()));
 
 	generateTransparentBrush();
 
@@ -616,6 +650,7 @@ void MediaView::clearData() {
 	_fullScreenVideo = false;
 	_saveMsgText.clear();
 	_caption.clear();
+	clearPreloadedPhotos();
 }
 
 MediaView::~MediaView() {
@@ -1205,6 +1240,7 @@ void MediaView::displayDocument(DocumentData *doc, HistoryItem *item) { // empty
 	}
 
 	_caption = Text();
+	MTP::clearLoaderPriorities();
 	if (_doc) {
 		if (_doc->sticker()) {
 			_doc->checkSticker();
@@ -1373,7 +1409,7 @@ void MediaView::createClipReader() {
 		_current = _doc->thumb->pixNoCache(_doc->thumb->width(), _doc->thumb->height(), ImagePixSmooth | ImagePixBlurred, st::mvDocIconSize, st::mvDocIconSize);
 	}
 	auto mode = _doc->isVideo() ? Media::Clip::Reader::Mode::Video : Media::Clip::Reader::Mode::Gif;
-	_gif = std_::make_unique<Media::Clip::Reader>(_doc->location(), _doc->data(), [this](Media::Clip::Notification notification) {
+	_gif = std_::make_unique<Media::Clip::Reader>(_doc, [this](Media::Clip::Notification notification) {
 		clipCallback(notification);
 	}, mode);
 
@@ -1446,7 +1482,7 @@ void MediaView::restartVideoAtSeekPosition(int64 positionMs) {
 	if (_current.isNull()) {
 		_current = _gif->current(_gif->width(), _gif->height(), _gif->width(), _gif->height(), getms());
 	}
-	_gif = std_::make_unique<Media::Clip::Reader>(_doc->location(), _doc->data(), [this](Media::Clip::Notification notification) {
+	_gif = std_::make_unique<Media::Clip::Reader>(_doc, [this](Media::Clip::Notification notification) {
 		clipCallback(notification);
 	}, Media::Clip::Reader::Mode::Video, positionMs);
 
@@ -1566,7 +1602,12 @@ void MediaView::paintEvent(QPaintEvent *e) {
 		int32 w = _width * cIntRetinaFactor();
 		if (_full <= 0 && _photo->loaded()) {
 			int32 h = int((_photo->full->height() * (qreal(w) / qreal(_photo->full->width()))) + 0.9999);
-			_current = _photo->full->pixNoCache(w, h, ImagePixSmooth);
+			auto prepared = _preparedPhotos.constFind(_photo);
+			if (prepared != _preparedPhotos.cend() && prepared->width() == w && prepared->height() == h) {
+				_current = prepared.value();
+			} else {
+				_current = _photo->full->pixNoCache(w, h, ImagePixSmooth);
+			}
 			if (cRetina()) _current.setDevicePixelRatio(cRetinaFactor());
 			_full = 1;
 		} else if (_full < 0 && _photo->medium->loaded()) {
@@ -2064,22 +2105,25 @@ void MediaView::preloadData(int32 delta) {
 	}
 	if (!_user && _overview == OverviewCount) return;
 
-	int32 from = indexInOverview + (delta ? delta : -1), to = indexInOverview + (delta ? delta * MediaOverviewPreloadCount : 1);
-	if (from > to) qSwap(from, to);
+	updatePreloadSpeed(delta);
+
+	// The nearest media first, so that the memory limit cuts off the farthest ones.
+	QVector<int32> indices;
+	if (delta) {
+		for (int32 i = 1, count = preloadCount(); i <= count; ++i) {
+			indices.push_back(indexInOverview + delta * i);
+		}
+	} else {
+		indices.push_back(indexInOverview - 1);
+		indices.push_back(indexInOverview + 1);
+	}
+
+	auto wasPreloaded = base::take(_preloadedPhotos);
+	auto budget = int64(MediaViewPreloadMemoryLimit);
 	if (_history && _overview != OverviewCount) {
 		int32 forgetIndex = indexInOverview - delta * 2;
-		History *forgetHistory = indexOfMigratedItem ? _migrated : _history;
-		if (_migrated) {
-			if (indexOfMigratedItem && forgetIndex >= _migrated->overview[_overview].size()) {
-				forgetHistory = _history;
-				forgetIndex -= _migrated->overview[_overview].size() + (_history->overviewCount(_overview) - _history->overview[_overview].size());
-			} else if (!indexOfMigratedItem && forgetIndex < 0) {
-				forgetHistory = _migrated;
-				forgetIndex += _migrated->overview[_overview].size();
-			}
-		}
-		if (forgetIndex >= 0 && forgetIndex < forgetHistory->overview[_overview].size() && (forgetHistory != (indexOfMigratedItem ? _migrated : _history) || forgetIndex != indexInOverview)) {
-			if (HistoryItem *item = App::histItemById(forgetHistory->channelId(), forgetHistory->overview[_overview][forgetIndex])) {
+		if (forgetIndex != indexInOverview) {
+			if (auto item = overviewItemAt(forgetIndex, indexOfMigratedItem)) {
 				if (HistoryMedia *media = item->getMedia()) {
 					switch (media->type()) {
 					case MediaTypePhoto: static_cast<HistoryPhoto*>(media)->photo()->forget(); break;
@@ -2092,45 +2136,36 @@ void MediaView::preloadData(int32 delta) {
 			}
 		}
 
-		for (int32 i = from; i <= to; ++i) {
-			History *previewHistory = indexOfMigratedItem ? _migrated : _history;
-			int32 previewIndex = i;
-			if (_migrated) {
-				if (indexOfMigratedItem && previewIndex >= _migrated->overview[_overview].size()) {
-					previewHistory = _history;
-					previewIndex -= _migrated->overview[_overview].size() + (_history->overviewCount(_overview) - _history->overview[_overview].size());
-				} else if (!indexOfMigratedItem && previewIndex < 0) {
-					previewHistory = _migrated;
-					previewIndex += _migrated->overview[_overview].size();
-				}
-			}
-			if (previewIndex >= 0 && previewIndex < previewHistory->overview[_overview].size() && (previewHistory != (indexOfMigratedItem ? _migrated : _history) || previewIndex != indexInOverview)) {
-				if (HistoryItem *item = App::histItemById(previewHistory->channelId(), previewHistory->overview[_overview][previewIndex])) {
-					if (HistoryMedia *media = item->getMedia()) {
-						switch (media->type()) {
-						case MediaTypePhoto: static_cast<HistoryPhoto*>(media)->photo()->download(); break;
-						case MediaTypeFile:
-						case MediaTypeVideo:
-						case MediaTypeGif: {
-							DocumentData *doc = media->getDocument();
-							doc->thumb->load();
-							doc->automaticLoad(item);
-						} break;
-						case MediaTypeSticker: media->getDocument()->sticker()->img->load(); break;
-						}
-					}
-				}
+		auto budgetExceeded = false;
+		for_const (auto index, indices) {
+			auto item = overviewItemAt(index, indexOfMigratedItem);
+			auto media = item ? item->getMedia() : nullptr;
+			if (!media) continue;
+
+			switch (media->type()) {
+			case MediaTypePhoto: {
+				budgetExceeded = !preloadPhoto(static_cast<HistoryPhoto*>(media)->photo(), budget);
+			} break;
+			case MediaTypeFile:
+			case MediaTypeVideo:
+			case MediaTypeGif: {
+				DocumentData *doc = media->getDocument();
+				doc->thumb->load();
+				doc->automaticLoad(item);
+			} break;
+			case MediaTypeSticker: media->getDocument()->sticker()->img->load(); break;
 			}
+			if (budgetExceeded) break;
 		}
 	} else if (_user) {
-		for (int32 i = from; i <= to; ++i) {
-			if (i >= 0 && i < _user->photos.size() && i != indexInOverview) {
-				_user->photos[i]->thumb->load();
+		for_const (auto index, indices) {
+			if (index >= 0 && index < _user->photos.size()) {
+				_user->photos[index]->thumb->load();
 			}
 		}
-		for (int32 i = from; i <= to; ++i) {
-			if (i >= 0 && i < _user->photos.size() && i != indexInOverview) {
-				_user->photos[i]->download();
+		for_const (auto index, indices) {
+			if (index >= 0 && index < _user->photos.size() && !preloadPhoto(_user->photos[index], budget)) {
+				break;
 			}
 		}
 		int32 forgetIndex = indexInOverview - delta * 2;
@@ -2138,6 +2173,153 @@ void MediaView::preloadData(int32 delta) {
 			_user->photos[forgetIndex]->forget();
 		}
 	}
+
+	// Forget the photos preloaded for the previous position that didn't fit the
+	// new window, except the shown one and the one the user came from.
+	PhotoData *previous = nullptr;
+	if (delta) {
+		if (_history && _overview != OverviewCount) {
+			auto item = overviewItemAt(indexInOverview - delta, indexOfMigratedItem);
+			auto media = item ? item->getMedia() : nullptr;
+			if (media && media->type() == MediaTypePhoto) {
+				previous = static_cast<HistoryPhoto*>(media)->photo();
+			}
+		} else if (_user && indexInOverview - delta >= 0 && indexInOverview - delta < _user->photos.size()) {
+			previous = _user->photos[indexInOverview - delta];
+		}
+	}
+	for_const (auto photo, wasPreloaded) {
+		if (photo != _photo && photo != previous && !_preloadedPhotos.contains(photo)) {
+			photo->forget();
+			_preparedPhotos.remove(photo);
+		}
+	}
+	for (auto i = _preparedPhotos.begin(); i != _preparedPhotos.end();) {
+		if (i.key() != _photo && i.key() != previous && !_preloadedPhotos.contains(i.key())) {
+			i = _preparedPhotos.erase(i);
+		} else {
+			++i;
+		}
+	}
+
+	// Prepare in the next event loop iteration, after the shown media is painted.
+	if (!_preloadedPhotos.isEmpty()) {
+		_prepareTimer.start(0);
+	}
+}
+
+HistoryItem *MediaView::overviewItemAt(int32 index, bool indexOfMigratedItem) const {
+	History *history = indexOfMigratedItem ? _migrated : _history;
+	if (_migrated) {
+		if (indexOfMigratedItem && index >= _migrated->overview[_overview].size()) {
+			history = _history;
+			index -= _migrated->overview[_overview].size() + (_history->overviewCount(_overview) - _history->overview[_overview].size());
+		} else if (!indexOfMigratedItem && index < 0) {
+			history = _migrated;
+			index += _migrated->overview[_overview].size();
+		}
+	}
+	if (index < 0 || index >= history->overview[_overview].size()) {
+		return nullptr;
+	}
+	if (history == (_msgmigrated ? _migrated : _history) && index == _index) {
+		return nullptr;
+	}
+	return App::histItemById(history->channelId(), history->overview[_overview][index]);
+}
+
+void MediaView::updatePreloadSpeed(int32 delta) {
+	if (!delta) {
+		return;
+	}
+	auto ms = getms();
+	auto interval = ms - _lastMoveMs;
+	if (_lastMoveMs && _lastMoveDelta == delta && interval < uint64(kPreloadAheadMs)) {
+		_moveInterval = _moveInterval ? ((_moveInterval * 3 + int32(interval)) / 4) : int32(interval);
+	} else {
+		_moveInterval = 0;
+	}
+	_lastMoveMs = ms;
+	_lastMoveDelta = delta;
+}
+
+int32 MediaView::preloadCount() const {
+	if (!_moveInterval) {
+		return MediaOverviewPreloadCount;
+	}
+	return snap(kPreloadAheadMs / qMax(_moveInterval, 1), int(MediaOverviewPreloadCount), int(MediaOverviewPreloadMaxCount));
+}
+
+bool MediaView::preloadPhoto(PhotoData *photo, int64 &budget) {
+	if (photo == _photo || _preloadedPhotos.contains(photo)) {
+		return true;
+	}
+
+	// The full image stays decoded in the PhotoData and the prepared one is kept here.
+	auto prepared = preparedPhotoSize(photo);
+	auto size = int64(photo->full->width()) * photo->full->height() * 4 + int64(prepared.width()) * prepared.height() * 4;
+	if (size > budget && !_preloadedPhotos.isEmpty()) {
+		return false;
+	}
+	budget -= size;
+
+	photo->download();
+	_preloadedPhotos.push_back(photo);
+	return true;
+}
+
+QSize MediaView::preparedPhotoSize(PhotoData *photo) const {
+	// Same as the _width of the photo in displayPhoto() without zoom.
+	int w = convertScale(photo->full->width()), h = convertScale(photo->full->height());
+	if (w > width()) {
+		h = qRound(h * width() / float64(w));
+		w = width();
+	}
+	if (h > height()) {
+		w = qRound(w * height() / float64(h));
+	}
+	w *= cIntRetinaFactor();
+	return QSize(w, int((photo->full->height() * (qreal(w) / qreal(photo->full->width()))) + 0.9999));
+}
+
+void MediaView::onPreparePhotos() {
+	if (isHidden()) return;
+
+	// Restoring a forgotten or just downloaded photo decodes it, so do one per call.
+	for_const (auto photo, _preloadedPhotos) {
+		if (_preparedPhotos.contains(photo) || _preparingPhotos.contains(photo) || !photo->loaded()) {
+			continue;
+		}
+		auto image = photo->full->original();
+		if (image.isNull()) continue;
+
+		if (!_prepareQueue) {
+			_prepareQueue = std_::make_unique<TaskQueue>(nullptr, MediaViewPrepareQueueStopTimeout);
+		}
+		_preparingPhotos.insert(photo);
+		_prepareQueue->addTask(new PreparePhotoTask(this, photo, image, preparedPhotoSize(photo)));
+		_prepareTimer.start(0);
+		return;
+	}
+}
+
+void MediaView::photoPrepared(PhotoData *photo, QImage &&image) {
+	if (!_preparingPhotos.contains(photo)) return;
+	_preparingPhotos.remove(photo);
+	if (photo != _photo && !_preloadedPhotos.contains(photo)) return;
+
+	_preparedPhotos.insert(photo, App::pixmapFromImageInPlace(std_::move(image)));
+	if (photo == _photo && _full <= 0) {
+		update(_x, _y, _w, _h);
+	}
+}
+
+void MediaView::clearPreloadedPhotos() {
+	_preloadedPhotos.clear();
+	_preparedPhotos.clear();
+	_preparingPhotos.clear();
+	_lastMoveMs = 0;
+	_moveInterval = 0;
 }
 
 void MediaView::mousePressEvent(QMouseEvent *e) {
@@ -2523,6 +2705,7 @@ void MediaView::setVisible(bool visible) {
 
 		stopGif();
 		_radial.stop();
+		clearPreloadedPhotos();
 		Notify::clipStopperHidden(ClipStopperMediaview);
 	}
 }
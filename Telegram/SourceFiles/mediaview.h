@@ -30,6 +30,7 @@ class Controller;
 } // namespace Media
 
 class PopupMenu;
+class TaskQueue;
 
 struct AudioPlaybackState;
 
@@ -73,6 +74,9 @@ public:
 	void clipCallback(Media::Clip::Notification notification);
 	PeerData *ui_getPeerForMouseAction();
 
+	// Called with the photo scaled to the screen size by _prepareQueue.
+	void photoPrepared(PhotoData *photo, QImage &&image);
+
 	void clearData();
 
 	~MediaView();
@@ -129,6 +133,8 @@ private slots:
 	void onVideoToggleFullScreen();
 	void onVideoPlayProgress(const AudioMsgId &audioId);
 
+	void onPreparePhotos();
+
 private:
 	void displayPhoto(PhotoData *photo, HistoryItem *item);
 	void displayDocument(DocumentData *doc, HistoryItem *item);
@@ -136,6 +142,13 @@ private:
 	void findCurrent();
 	void loadBack();
 
+	HistoryItem *overviewItemAt(int32 index, bool indexOfMigratedItem) const;
+	void updatePreloadSpeed(int32 delta);
+	int32 preloadCount() const;
+	bool preloadPhoto(PhotoData *photo, int64 &budget);
+	void clearPreloadedPhotos();
+	QSize preparedPhotoSize(PhotoData *photo) const;
+
 	void generateTransparentBrush();
 
 	void updateCursor();
@@ -272,6 +285,19 @@ private:
 
 	mtpRequestId _loadRequest = 0;
 
+	// Photos downloaded ahead, the nearest first, and their pixmaps
+	// already scaled to the screen size in the background.
+	QList<PhotoData*> _preloadedPhotos;
+	QMap<PhotoData*, QPixmap> _preparedPhotos;
+	OrderedSet<PhotoData*> _preparingPhotos;
+	std_::unique_ptr<TaskQueue> _prepareQueue;
+	QTimer _prepareTimer;
+
+	// Average time between switching the media, 0 if the user doesn't flip through them.
+	uint64 _lastMoveMs = 0;
+	int32 _lastMoveDelta = 0;
+	int32 _moveInterval = 0;
+
 	enum OverState {
 		OverNone,
 		OverLeftNav,
@@ -658,7 +658,7 @@ void ConnectionPrivate::resetSession() { // recreate all msg_id and msg_seqno
 
 mtpMsgId ConnectionPrivate::prepareToSend(mtpRequest &request, mtpMsgId currentLastId) {
 	if (request->size() < 9) return 0;
-	mtpMsgId msgId = *(mtpMsgId*)(request->constData() + 4);
+	mtpMsgId msgId = mtpRequestData::msgId(request);
 	if (msgId) { // resending this request
 		QWriteLocker locker(sessionData->toResendMutex());
 		mtpRequestIdsMap &toResend(sessionData->toResendMap());
@@ -676,7 +676,7 @@ mtpMsgId ConnectionPrivate::prepareToSend(mtpRequest &request, mtpMsgId currentL
 mtpMsgId ConnectionPrivate::replaceMsgId(mtpRequest &request, mtpMsgId newId) {
 	if (request->size() < 9) return 0;
 
-	mtpMsgId oldMsgId = *(mtpMsgId*)(request->constData() + 4);
+	mtpMsgId oldMsgId = mtpRequestData::msgId(request);
 	if (oldMsgId != newId) {
 		if (oldMsgId) {
 			QWriteLocker locker(sessionData->toResendMutex());
@@ -902,6 +902,7 @@ void ConnectionPrivate::tryToSend() {
 					QWriteLocker locker2(sessionData->haveSentMutex());
 					mtpRequestMap &haveSent(sessionData->haveSentMap());
 					haveSent.insert(msgId, toSendRequest);
+					TRACE_LOG(MtpRequestSent, dc, toSendRequest->requestId, 0, mtpRequestData::messageSize(toSendRequest) * sizeof(mtpPrime));
 
 					if (needsLayer && !toSendRequest->needsLayer) needsLayer = false;
 					if (toSendRequest->after) {
@@ -1002,6 +1003,7 @@ void ConnectionPrivate::tryToSend() {
 							added = true;
 						}
 						haveSent.insert(msgId, req);
+						TRACE_LOG(MtpRequestSent, dc, req->requestId, 0, mtpRequestData::messageSize(req) * sizeof(mtpPrime));
 
 						needAnyResponse = true;
 					} else {
@@ -1947,6 +1949,8 @@ int32 ConnectionPrivate::handleOneReceived(const mtpPrime *from, const mtpPrime
 
 		mtpRequestId requestId = wasSent(reqMsgId.v);
 		if (requestId && requestId != mtpRequestId(0xFFFFFFFF)) {
+			TRACE_LOG(MtpResponseReceived, dc, requestId, 0, response.size() * sizeof(mtpPrime));
+
 			QWriteLocker locker(sessionData->haveReceivedMutex());
 			sessionData->haveReceivedMap().insert(requestId, response); // save rpc_result for processing in main mtp thread
 		} else {
@@ -2979,6 +2983,7 @@ bool ConnectionPrivate::sendRequest(mtpRequest &request, bool needAnyResponse, Q
 	aesIgeEncrypt(request->constData(), &result[8], fullSize * sizeof(mtpPrime), key, msgKey);
 
 	DEBUG_LOG(("MTP Info: sending request, size: %1, num: %2, time: %3").arg(fullSize + 6).arg((*request)[4]).arg((*request)[5]));
+	TRACE_LOG(MtpPacketSent, dc, mtpRequestData::msgId(request), 0, result.size() * sizeof(mtpPrime));
 
 	_conn->setSentEncrypted();
 	_conn->sendData(result);
@@ -94,6 +94,11 @@ public:
 		return 4 + (request.innerLength() >> 2); // 2: msg_id, 1: seq_no, q: message_length
 	}
 
+	static mtpMsgId msgId(const mtpRequest &request) {
+		if (request->size() < 9) return 0;
+		return *(const mtpMsgId*)(request->constData() + 4); // 2: salt, 2: session_id
+	}
+
 	static bool isSentContainer(const mtpRequest &request); // "request-like" wrap for msgIds vector
 	static bool isStateRequest(const mtpRequest &request);
 	static bool needAck(const mtpRequest &request);
@@ -30,6 +30,13 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 
 namespace {
 	int32 GlobalPriority = 1;
+
+	// a loader that was not displayed for that long after the viewport changed is offscreen
+	constexpr uint64 kOffscreenTimeout = 300;
+
+	bool ShownLoadStatsActive = false;
+	QVector<uint64> ShownLoadTimes;
+
 	struct DataRequested {
 		DataRequested() {
 			memset(v, 0, sizeof(v));
@@ -195,6 +202,7 @@ void FileLoader::localLoaded(const StorageImageSaved &result, const QByteArray &
 	}
 
 	_complete = true;
+	loadedWhileShown();
 	if (_fileIsOpen) {
 		_file.close();
 		_fileIsOpen = false;
@@ -209,6 +217,12 @@ void FileLoader::start(bool loadFirst, bool prior) {
 	if (_paused) {
 		_paused = false;
 	}
+	if (prior) {
+		_shownAt = getms();
+		if (!_firstShownAt && ShownLoadStatsActive) {
+			_firstShownAt = _shownAt;
+		}
+	}
 	if (_complete || tryLoadLocal()) return;
 
 	if (_fromCloud == LoadFromLocalOnly) {
@@ -311,6 +325,35 @@ void FileLoader::start(bool loadFirst, bool prior) {
 	return startLoading(loadFirst, prior);
 }
 
+void FileLoader::promote() {
+	if (_inQueue) {
+		start();
+	}
+}
+
+bool FileLoader::offscreen() const {
+	// files the user asked to download are never suspended
+	if (_locationType != UnknownFileLocation && !_autoLoading) {
+		return false;
+	}
+	return (_priority < GlobalPriority) && (getms() > _shownAt + kOffscreenTimeout);
+}
+
+void FileLoader::suspendOffscreenLoaders() {
+	for (auto i = _queue->end; i && _queue->queries >= _queue->limit; i = i->_prev) {
+		if (i != this && i->offscreen()) {
+			i->suspendRequests();
+		}
+	}
+}
+
+void FileLoader::loadedWhileShown() {
+	if (_firstShownAt && ShownLoadStatsActive) {
+		ShownLoadTimes.push_back(getms() - _firstShownAt);
+	}
+	_firstShownAt = 0;
+}
+
 void FileLoader::cancel() {
 	cancel(false);
 }
@@ -337,7 +380,11 @@ void FileLoader::cancel(bool fail) {
 }
 
 void FileLoader::startLoading(bool loadFirst, bool prior) {
-	if ((_queue->queries >= _queue->limit && (!loadFirst || !prior)) || _complete) return;
+	if (_complete) return;
+	if (prior && _queue->queries >= _queue->limit && !offscreen() && canRequestPart()) {
+		suspendOffscreenLoaders();
+	}
+	if (_queue->queries >= _queue->limit && (!loadFirst || !prior)) return;
 	loadPart();
 }
 
@@ -429,6 +476,7 @@ bool mtpFileLoader::loadPart() {
 	_requests.insert(reqId, dcIndex);
 	_nextRequestOffset += limit;
 
+	TRACE_LOG(FilePartRequested, MTP::dldDcId(_dc, dcIndex), reqId, offset, limit);
 	if (DebugLogging::FileLoader() && _id) DEBUG_LOG(("FileLoader(%1): requested part with offset=%2, _queue->queries=%3, _nextRequestOffset=%4, _requests=%5").arg(_id).arg(offset).arg(_queue->queries).arg(_nextRequestOffset).arg(serializereqs(_requests)));
 
 	return true;
@@ -455,6 +503,7 @@ void mtpFileLoader::partLoaded(int32 offset, const MTPupload_File &result, mtpRe
 	auto &d = result.c_upload_file();
 	auto &bytes = d.vbytes.c_string().v;
 
+	TRACE_LOG(FilePartLoaded, MTP::dldDcId(_dc, dcIndex), req, offset, bytes.size());
 	if (DebugLogging::FileLoader() && _id) DEBUG_LOG(("FileLoader(%1): got part with offset=%2, bytes=%3, _queue->queries=%4, _nextRequestOffset=%5, _requests=%6").arg(_id).arg(offset).arg(bytes.size()).arg(_queue->queries).arg(_nextRequestOffset).arg(serializereqs(_requests)));
 
 	if (bytes.size()) {
@@ -501,6 +550,7 @@ void mtpFileLoader::partLoaded(int32 offset, const MTPupload_File &result, mtpRe
 		}
 		_type = d.vtype.type();
 		_complete = true;
+		loadedWhileShown();
 		if (_fileIsOpen) {
 			_file.close();
 			_fileIsOpen = false;
@@ -564,6 +614,32 @@ void mtpFileLoader::cancelRequests() {
 	}
 }
 
+bool mtpFileLoader::canRequestPart() const {
+	if (_complete || _lastComplete || (!_requests.isEmpty() && !_size)) {
+		return false;
+	}
+	return !_size || _nextRequestOffset < _size;
+}
+
+bool mtpFileLoader::suspendRequests() {
+	if (_requests.isEmpty() || _lastComplete || _skippedBytes) {
+		return false;
+	}
+
+	// parts are requested one after another, so if everything before the parts in flight
+	// is already received we can forget about them and request them once again later
+	int32 limit = (_locationType == UnknownFileLocation) ? DownloadPartSize : DocumentDownloadPartSize;
+	int32 received = currentOffset(true);
+	if (received + _requests.size() * limit != _nextRequestOffset) {
+		return false;
+	}
+	if (DebugLogging::FileLoader() && _id) DEBUG_LOG(("FileLoader(%1): suspended offscreen, _nextRequestOffset=%2, _requests=%3").arg(_id).arg(received).arg(serializereqs(_requests)));
+
+	cancelRequests();
+	_nextRequestOffset = received;
+	return true;
+}
+
 bool mtpFileLoader::tryLoadLocal() {
 	if (_localStatus == LocalNotFound || _localStatus == LocalLoaded || _localStatus == LocalFailed) {
 		return false;
@@ -653,6 +729,7 @@ void webFileLoader::onFinished(const QByteArray &data) {
 	}
 	_type = mtpc_storage_filePartial;
 	_complete = true;
+	loadedWhileShown();
 	if (_fileIsOpen) {
 		_file.close();
 		_fileIsOpen = false;
@@ -1090,4 +1167,22 @@ base::Observable<void> &ImageLoaded() {
 	return ImageLoadedObservable;
 }
 
+void startShownLoadStats() {
+	ShownLoadStatsActive = true;
+	ShownLoadTimes.clear();
+}
+
+QString finishShownLoadStats() {
+	ShownLoadStatsActive = false;
+	auto times = base::take(ShownLoadTimes);
+	if (times.isEmpty()) {
+		return qsl("no files were loaded while shown");
+	}
+	std::sort(times.begin(), times.end());
+	auto percentile = [&times](int percent) {
+		return times[qMin((times.size() * percent) / 100, times.size() - 1)];
+	};
+	return qsl("%1 files loaded while shown, time to visible ms: median %2, p90 %3, max %4").arg(times.size()).arg(percentile(50)).arg(percentile(90)).arg(times.back());
+}
+
 } // namespace FileDownload
@@ -140,6 +140,9 @@ public:
 	void start(bool loadFirst = false, bool prior = true);
 	void cancel();
 
+	// the file is displayed again, move it to the front of the queue if it is loading
+	void promote();
+
 	bool loading() const {
 		return _inQueue;
 	}
@@ -185,6 +188,8 @@ protected:
 	FileLoader *_prev = nullptr;
 	FileLoader *_next = nullptr;
 	int _priority = 0;
+	uint64 _shownAt = 0; // last time the loader was started with priority
+	uint64 _firstShownAt = 0;
 	FileLoaderQueue *_queue;
 
 	bool _paused = false;
@@ -203,6 +208,18 @@ protected:
 	void loadNext();
 	virtual bool loadPart() = 0;
 
+	// loaders of images and auto loaded media that left the viewport
+	// give their parts in flight to the loaders that are displayed now
+	bool offscreen() const;
+	void suspendOffscreenLoaders();
+	virtual bool canRequestPart() const {
+		return false;
+	}
+	virtual bool suspendRequests() { // cancel parts in flight so that they are requested later
+		return false;
+	}
+	void loadedWhileShown();
+
 	QFile _file;
 	QString _fname;
 	bool _fileIsOpen = false;
@@ -252,6 +269,8 @@ public:
 protected:
 	virtual bool tryLoadLocal();
 	virtual void cancelRequests();
+	virtual bool canRequestPart() const;
+	virtual bool suspendRequests();
 
 	typedef QMap<mtpRequestId, int32> Requests;
 	Requests _requests;
@@ -403,4 +422,9 @@ namespace FileDownload {
 
 base::Observable<void> &ImageLoaded();
 
+// Collects the time from the first display of an image or an auto loaded
+// media to the end of its loading, used by the scroll benchmark.
+void startShownLoadStats();
+QString finishShownLoadStats();
+
 } // namespace FileDownload
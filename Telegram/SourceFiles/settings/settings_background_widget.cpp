@@ -144,12 +144,14 @@ void BackgroundRow::updateImage() {
 	back.setDevicePixelRatio(cRetinaFactor());
 	{
 		QPainter p(&back);
-		auto &pix = Window::chatBackground()->image();
-		int sx = (pix.width() > pix.height()) ? ((pix.width() - pix.height()) / 2) : 0;
-		int sy = (pix.height() > pix.width()) ? ((pix.height() - pix.width()) / 2) : 0;
-		int s = (pix.width() > pix.height()) ? pix.height() : pix.width();
+		auto &bg = Window::chatBackground()->image();
+		int sx = (bg.width() > bg.height()) ? ((bg.width() - bg.height()) / 2) : 0;
+		int sy = (bg.height() > bg.width()) ? ((bg.height() - bg.width()) / 2) : 0;
+		int s = (bg.width() > bg.height()) ? bg.height() : bg.width();
+		QRect from(sx, sy, s, s);
+		auto &pix = Window::chatBackground()->imageForSize(from, QSize(size, size));
 		p.setRenderHint(QPainter::SmoothPixmapTransform);
-		p.drawPixmap(0, 0, st::settingsBackgroundSize, st::settingsBackgroundSize, pix, sx, sy, s, s);
+		p.drawPixmap(QRect(0, 0, st::settingsBackgroundSize, st::settingsBackgroundSize), pix, from);
 	}
 	imageRound(back, ImageRoundRadius::Small);
 	_background = App::pixmapFromImageInPlace(std_::move(back));
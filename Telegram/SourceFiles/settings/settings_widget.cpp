@@ -31,6 +31,8 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 #include "localstorage.h"
 #include "boxes/confirmbox.h"
 #include "application.h"
+#include "media/media_audio.h"
+#include "core/memory_pool.h"
 
 namespace Settings {
 namespace {
@@ -38,6 +40,55 @@ namespace {
 QString SecretText;
 QMap<QString, base::lambda_wrap<void()>> Codes;
 
+constexpr int kAudioStressDurationMs = 10000;
+constexpr int kAudioStressBusyMs = 50;
+
+// Keeps the main thread busy with short breaks, checking that the playback doesn't stutter.
+void audioStressStep(uint64 till, int underrunsWas) {
+	auto ms = getms();
+	if (ms >= till) {
+		auto underruns = internal::audioUnderrunsCount() - underrunsWas;
+		LOG(("Audio Info: stress test finished with %1 underruns.").arg(underruns));
+		Ui::showLayer(new InformBox(qsl("Audio stress test finished.\n\nPlayback underruns: %1").arg(underruns)));
+		return;
+	}
+	QImage image(512, 512, QImage::Format_ARGB32_Premultiplied);
+	while (getms() < ms + kAudioStressBusyMs) {
+		image.fill(Qt::transparent);
+		Painter p(&image);
+		p.setRenderHint(QPainter::Antialiasing);
+		p.setBrush(QColor(rand_value<uint32>()));
+		p.drawEllipse(0, 0, image.width(), image.height());
+	}
+	QTimer::singleShot(0, [till, underrunsWas] {
+		audioStressStep(till, underrunsWas);
+	});
+}
+
+constexpr int kScrollBenchmarkFrames = 600;
+constexpr int kScrollBenchmarkFrameMs = 16;
+constexpr int kScrollBenchmarkDelta = -40; // scroll up to the older messages
+constexpr int kScrollBenchmarkSettleMs = 5000;
+
+// Scrolls the current chat by the same script every time, then waits for the
+// loads and reports how long the displayed images waited for them.
+void scrollBenchmarkStep(int framesLeft) {
+	auto finish = [] {
+		auto result = FileDownload::finishShownLoadStats();
+		LOG(("Download Info: scroll benchmark, %1").arg(result));
+		Ui::showLayer(new InformBox(qsl("Scroll benchmark finished.\n\n%1").arg(result)));
+	};
+	if (!App::main() || !App::main()->benchmarkScrollHistory(kScrollBenchmarkDelta)) {
+		finish();
+	} else if (framesLeft > 0) {
+		QTimer::singleShot(kScrollBenchmarkFrameMs, [framesLeft] {
+			scrollBenchmarkStep(framesLeft - 1);
+		});
+	} else {
+		QTimer::singleShot(kScrollBenchmarkSettleMs, finish);
+	}
+}
+
 void fillCodes() {
 	Codes.insert(qsl("debugmode"), []() {
 		QString text = cDebug() ? qsl("Do you want to disable DEBUG logs?") : qsl("Do you want to enable DEBUG logs?\n\nAll network events will be logged.");
@@ -63,6 +114,24 @@ void fillCodes() {
 		}
 		Ui::showLayer(new InformBox(DebugLogging::FileLoader() ? qsl("Enabled file download logging") : qsl("Disabled file download logging")));
 	});
+	Codes.insert(qsl("debugtrace"), []() {
+		if (DebugLogging::Trace()) {
+			Global::RefDebugLoggingFlags() &= ~DebugLogging::TraceFlag;
+			Logs::closeTrace();
+		} else {
+			Global::RefDebugLoggingFlags() |= DebugLogging::TraceFlag;
+		}
+		Ui::showLayer(new InformBox(DebugLogging::Trace() ? qsl("Enabled network trace to DebugLogs/trace_*.bin") : qsl("Disabled network trace")));
+	});
+	Codes.insert(qsl("historytiles"), []() {
+		Global::SetHistoryTilesEnabled(!Global::HistoryTilesEnabled());
+		Ui::showLayer(new InformBox(Global::HistoryTilesEnabled() ? qsl("Enabled history tiles cache") : qsl("Disabled history tiles cache")));
+	});
+	Codes.insert(qsl("bubblebench"), []() {
+		auto result = App::roundRectsBenchmark();
+		LOG(("Paint Info: %1").arg(result));
+		Ui::showLayer(new InformBox(result));
+	});
 	Codes.insert(qsl("crashplease"), []() {
 		t_assert(!"Crashed in Settings!");
 	});
@@ -82,6 +151,36 @@ void fillCodes() {
 		});
 		Ui::showLayer(box.release());
 	});
+	Codes.insert(qsl("audiostress"), []() {
+		Ui::hideSettingsAndLayer();
+		audioStressStep(getms() + kAudioStressDurationMs, internal::audioUnderrunsCount());
+	});
+	Codes.insert(qsl("scrollbench"), []() {
+		Ui::hideSettingsAndLayer();
+		FileDownload::startShownLoadStats();
+		scrollBenchmarkStep(kScrollBenchmarkFrames);
+	});
+	Codes.insert(qsl("memoryreport"), []() {
+		auto result = MemoryPool::report();
+		LOG(("Memory Info: %1").arg(result));
+		Ui::showLayer(new InformBox(result));
+	});
+	Codes.insert(qsl("peersreport"), []() {
+		auto result = App::peersMemoryReport();
+		LOG(("Memory Info: %1").arg(result));
+		Ui::showLayer(new InformBox(result));
+	});
+	Codes.insert(qsl("messageslimit"), []() {
+		// Cycle the memory limit for the loaded message objects and texts: 32, 64, 128, 256 MB and no limit.
+		auto megabytes = Global::MessagesMemoryLimit() / (1024 * 1024);
+		megabytes = (megabytes <= 0) ? 32 : (megabytes >= 256) ? 0 : (megabytes * 2);
+		Global::SetMessagesMemoryLimit(megabytes * 1024 * 1024);
+		Local::writeUserSettings();
+		if (auto main = App::main()) {
+			main->checkHistoryMemory();
+		}
+		Ui::showLayer(new InformBox(megabytes ? qsl("Loaded message objects and texts memory limit: %1 MB").arg(megabytes) : qsl("Disabled loaded messages memory limit")));
+	});
 	Codes.insert(qsl("getdifference"), []() {
 		if (auto main = App::main()) {
 			main->getDifference();
@@ -774,6 +774,261 @@ void InlineCacheEntry::clearResults() {
 	results.clear();
 }
 
+int InlineCacheEntry::applyPage(const MTPmessages_BotResults &page) {
+	if (page.type() != mtpc_messages_botResults) {
+		nextOffset = QString();
+		return 0;
+	}
+	pages.push_back(page);
+
+	const auto &d(page.c_messages_botResults());
+	const auto &v(d.vresults.c_vector().v);
+	uint64 queryId(d.vquery_id.v);
+
+	nextOffset = qs(d.vnext_offset);
+	if (d.has_switch_pm() && d.vswitch_pm.type() == mtpc_inlineBotSwitchPM) {
+		const auto &switchPm = d.vswitch_pm.c_inlineBotSwitchPM();
+		switchPmText = qs(switchPm.vtext);
+		switchPmStartToken = qs(switchPm.vstart_param);
+	}
+
+	if (int count = v.size()) {
+		results.reserve(results.size() + count);
+	}
+	int added = 0;
+	for_const (const auto &res, v) {
+		if (auto result = InlineBots::Result::create(queryId, res)) {
+			++added;
+			results.push_back(result.release());
+		}
+	}
+
+	if (!added) {
+		nextOffset = QString();
+	}
+	return added;
+}
+
+int InlineCache::indexOf(PeerId bot, PeerId peer, const QString &query) const {
+	for (int i = 0, count = _items.size(); i != count; ++i) {
+		auto &item = _items.at(i);
+		if (item.bot == bot && item.peer == peer && item.query == query) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+InlineCacheEntry *InlineCache::find(UserData *bot, PeerData *peer, const QString &query) {
+	if (!bot || !peer) return nullptr;
+
+	auto index = indexOf(bot->id, peer->id, query);
+	if (index < 0) return nullptr;
+
+	auto &item = _items[index];
+	item.used = ++_usedCounter;
+	return item.entry;
+}
+
+InlineCacheEntry *InlineCache::findFresh(UserData *bot, PeerData *peer, const QString &query) {
+	if (!bot || !peer) return nullptr;
+
+	auto index = indexOf(bot->id, peer->id, query);
+	if (index < 0 || _items.at(index).expires <= unixtime()) return nullptr;
+
+	auto &item = _items[index];
+	item.used = ++_usedCounter;
+	return item.entry;
+}
+
+InlineCacheEntry *InlineCache::add(UserData *bot, PeerData *peer, const QString &query) {
+	t_assert(bot != nullptr && peer != nullptr);
+
+	auto entry = new InlineCacheEntry();
+	auto expires = unixtime() + InlineBotResultsCacheTimeout;
+	auto index = indexOf(bot->id, peer->id, query);
+	if (index >= 0) {
+		auto &item = _items[index];
+		_replaced.push_back(item.entry);
+		item.entry = entry;
+		item.expires = expires;
+		item.used = ++_usedCounter;
+	} else {
+		_items.push_back({ bot->id, peer->id, query, expires, ++_usedCounter, entry });
+	}
+	return entry;
+}
+
+std_::unique_ptr<InlineCacheEntry> InlineCache::preview(UserData *bot, PeerData *peer, const QString &query) {
+	if (!bot || !peer) return std_::unique_ptr<InlineCacheEntry>();
+
+	auto now = unixtime();
+	Item *prefix = nullptr;
+	for (auto &item : _items) {
+		if (item.bot != bot->id || item.peer != peer->id || item.expires <= now) continue;
+		if (item.query.size() >= query.size() || !query.startsWith(item.query)) continue;
+		if (item.entry->results.isEmpty()) continue;
+		if (!prefix || prefix->query.size() < item.query.size()) {
+			prefix = &item;
+		}
+	}
+	if (!prefix) return std_::unique_ptr<InlineCacheEntry>();
+	prefix->used = ++_usedCounter;
+
+	auto words = textSearchKey(query).split(cWordSplit(), QString::SkipEmptyParts);
+	auto result = std_::make_unique<InlineCacheEntry>();
+	result->borrowed = true;
+	for_const (auto inlineResult, prefix->entry->results) {
+		auto text = textSearchKey(inlineResult->getLayoutTitle() + ' ' + inlineResult->getLayoutDescription());
+		auto matches = true;
+		if (!text.isEmpty()) { // media results without any text are always shown
+			for_const (auto &word, words) {
+				if (!text.contains(word)) {
+					matches = false;
+					break;
+				}
+			}
+		}
+		if (matches) {
+			result->results.push_back(inlineResult);
+		}
+	}
+	if (result->results.isEmpty()) {
+		return std_::unique_ptr<InlineCacheEntry>();
+	}
+	return result;
+}
+
+bool InlineCache::shrink(const InlineCacheEntry *shown) {
+	auto result = false;
+	for (auto i = _replaced.begin(); i != _replaced.end();) {
+		if (*i == shown) {
+			++i;
+		} else {
+			delete *i;
+			i = _replaced.erase(i);
+			result = true;
+		}
+	}
+
+	auto now = unixtime();
+	for (auto i = _items.begin(); i != _items.end();) {
+		if (i->expires <= now && i->entry != shown) {
+			delete i->entry;
+			i = _items.erase(i);
+			result = true;
+		} else {
+			++i;
+		}
+	}
+	while (_items.size() > InlineBotResultsCacheLimit) {
+		auto oldest = -1;
+		for (int i = 0, count = _items.size(); i != count; ++i) {
+			if (_items.at(i).entry == shown) continue;
+			if (oldest < 0 || _items.at(i).used < _items.at(oldest).used) {
+				oldest = i;
+			}
+		}
+		if (oldest < 0) break;
+
+		delete _items.at(oldest).entry;
+		_items.removeAt(oldest);
+		result = true;
+	}
+	return result;
+}
+
+QByteArray InlineCache::serialize() const {
+	auto now = unixtime();
+	auto sorted = QList<const Item*>();
+	for_const (auto &item, _items) {
+		if (item.expires > now && !item.entry->pages.isEmpty()) {
+			sorted.push_back(&item);
+		}
+	}
+	if (sorted.isEmpty()) {
+		return QByteArray();
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const Item *a, const Item *b) {
+		return a->used < b->used;
+	});
+
+	QByteArray result;
+	QDataStream stream(&result, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_1);
+	stream << qint32(MTP::internal::CurrentLayer) << quint32(sorted.size());
+	for_const (auto item, sorted) {
+		stream << quint64(item->bot) << quint64(item->peer) << item->query << qint32(item->expires);
+		stream << quint32(item->entry->pages.size());
+		for_const (auto &page, item->entry->pages) {
+			mtpBuffer buffer;
+			page.write(buffer);
+			stream << QByteArray(reinterpret_cast<const char*>(buffer.constData()), buffer.size() * sizeof(mtpPrime));
+		}
+	}
+	return result;
+}
+
+void InlineCache::deserialize(const QByteArray &serialized) {
+	if (serialized.isEmpty()) return;
+
+	QDataStream stream(serialized);
+	stream.setVersion(QDataStream::Qt_5_1);
+
+	qint32 layer = 0;
+	quint32 count = 0;
+	stream >> layer >> count;
+	if (stream.status() != QDataStream::Ok || layer != MTP::internal::CurrentLayer) {
+		return;
+	}
+
+	auto now = unixtime();
+	for (quint32 i = 0; i != count; ++i) {
+		quint64 bot = 0, peer = 0;
+		QString query;
+		qint32 expires = 0;
+		quint32 pagesCount = 0;
+		stream >> bot >> peer >> query >> expires >> pagesCount;
+		if (stream.status() != QDataStream::Ok) {
+			return;
+		}
+
+		auto skip = (expires <= now) || (indexOf(bot, peer, query) >= 0);
+		auto entry = skip ? std_::unique_ptr<InlineCacheEntry>() : std_::make_unique<InlineCacheEntry>();
+		for (quint32 j = 0; j != pagesCount; ++j) {
+			QByteArray bytes;
+			stream >> bytes;
+			if (stream.status() != QDataStream::Ok) {
+				return;
+			} else if (!entry) {
+				continue;
+			}
+
+			auto from = reinterpret_cast<const mtpPrime*>(bytes.constData());
+			auto end = from + (bytes.size() / sizeof(mtpPrime));
+			try {
+				MTPmessages_BotResults page;
+				page.read(from, end);
+				entry->applyPage(page);
+			} catch (Exception &) {
+				entry = nullptr;
+			}
+		}
+		if (entry && !entry->pages.isEmpty()) {
+			_items.push_back({ bot, peer, query, expires, ++_usedCounter, entry.release() });
+		}
+	}
+}
+
+InlineCache::~InlineCache() {
+	for_const (auto &item, _items) {
+		delete item.entry;
+	}
+	for_const (auto entry, _replaced) {
+		delete entry;
+	}
+}
+
 void EmojiPanInner::showEmojiPack(DBIEmojiTab packIndex) {
 	clearSelection(true);
 
@@ -1723,6 +1978,10 @@ void StickerPanInner::clearInlineRowsPanel() {
 	clearInlineRows(false);
 }
 
+void StickerPanInner::inlineResultsForgotten() {
+	deleteUnusedInlineLayouts();
+}
+
 void StickerPanInner::refreshSwitchPmButton(const InlineCacheEntry *entry) {
 	if (!entry || entry->switchPmText.isEmpty()) {
 		_switchPmButton.reset();
@@ -2650,6 +2909,10 @@ EmojiPan::EmojiPan(QWidget *parent) : TWidget(parent)
 //	setAttribute(Qt::WA_AcceptTouchEvents);
 }
 
+EmojiPan::~EmojiPan() {
+	Local::setInlineBotResultsSerializer(base::lambda_unique<QByteArray()>());
+}
+
 void EmojiPan::setMaxHeight(int32 h) {
 	_maxHeight = h;
 	updateContentHeight();
@@ -3647,10 +3910,7 @@ void EmojiPan::inlineBotChanged() {
 	_inlineRequestId = 0;
 	_inlineQuery = _inlineNextQuery = _inlineNextOffset = QString();
 	_inlineBot = nullptr;
-	for (InlineCache::const_iterator i = _inlineCache.cbegin(), e = _inlineCache.cend(); i != e; ++i) {
-		delete i.value();
-	}
-	_inlineCache.clear();
+	_inlinePreview = nullptr;
 	s_inner.inlineBotChanged();
 	s_inner.hideInlineRowsPanel();
 
@@ -3661,45 +3921,30 @@ void EmojiPan::inlineResultsDone(const MTPmessages_BotResults &result) {
 	_inlineRequestId = 0;
 	Notify::inlineBotRequesting(false);
 
-	auto it = _inlineCache.find(_inlineQuery);
-
-	bool adding = (it != _inlineCache.cend());
+	auto entry = _inlineCache.findFresh(_inlineBot, _inlineQueryPeer, _inlineQuery);
+	bool adding = (entry != nullptr);
+	if (!adding && !_inlineNextOffset.isEmpty()) { // first results expired while loading more
+		_inlineNextOffset = QString();
+		onInlineRequest();
+		return;
+	}
 	if (result.type() == mtpc_messages_botResults) {
-		const auto &d(result.c_messages_botResults());
-		const auto &v(d.vresults.c_vector().v);
-		uint64 queryId(d.vquery_id.v);
-
 		if (!adding) {
-			it = _inlineCache.insert(_inlineQuery, new internal::InlineCacheEntry());
-		}
-		it.value()->nextOffset = qs(d.vnext_offset);
-		if (d.has_switch_pm() && d.vswitch_pm.type() == mtpc_inlineBotSwitchPM) {
-			const auto &switchPm = d.vswitch_pm.c_inlineBotSwitchPM();
-			it.value()->switchPmText = qs(switchPm.vtext);
-			it.value()->switchPmStartToken = qs(switchPm.vstart_param);
-		}
-
-		if (int count = v.size()) {
-			it.value()->results.reserve(it.value()->results.size() + count);
-		}
-		int added = 0;
-		for_const (const auto &res, v) {
-			if (auto result = InlineBots::Result::create(queryId, res)) {
-				++added;
-				it.value()->results.push_back(result.release());
-			}
-		}
-
-		if (!added) {
-			it.value()->nextOffset = QString();
+			entry = _inlineCache.add(_inlineBot, _inlineQueryPeer, _inlineQuery);
 		}
+		entry->applyPage(result);
 	} else if (adding) {
-		it.value()->nextOffset = QString();
+		entry->nextOffset = QString();
 	}
+	_inlinePreview = nullptr;
 
-	if (!showInlineRows(!adding)) {
-		it.value()->nextOffset = QString();
+	if (!showInlineRows(!adding) && entry) {
+		entry->nextOffset = QString();
+	}
+	if (_inlineCache.shrink(entry)) {
+		s_inner.inlineResultsForgotten();
 	}
+	inlineCacheChanged();
 	onScrollStickers();
 }
 
@@ -3711,6 +3956,11 @@ bool EmojiPan::inlineResultsFail(const RPCError &error) {
 }
 
 void EmojiPan::queryInlineBot(UserData *bot, PeerData *peer, QString query) {
+	if (!_inlineCacheRead) {
+		_inlineCacheRead = true;
+		_inlineCache.deserialize(Local::readInlineBotResults());
+	}
+
 	bool force = false;
 	_inlineQueryPeer = peer;
 	if (bot != _inlineBot) {
@@ -3731,27 +3981,36 @@ void EmojiPan::queryInlineBot(UserData *bot, PeerData *peer, QString query) {
 			_inlineRequestId = 0;
 			Notify::inlineBotRequesting(false);
 		}
-		if (_inlineCache.contains(query)) {
+		if (_inlineCache.findFresh(_inlineBot, _inlineQueryPeer, query)) {
 			_inlineRequestTimer.stop();
 			_inlineQuery = _inlineNextQuery = query;
+			_inlinePreview = nullptr;
 			showInlineRows(true);
 		} else {
 			_inlineNextQuery = query;
 			_inlineRequestTimer.start(InlineBotRequestDelay);
+			showInlinePreview(query);
 		}
 	}
 }
 
+void EmojiPan::showInlinePreview(const QString &query) {
+	if (auto preview = _inlineCache.preview(_inlineBot, _inlineQueryPeer, query)) {
+		_inlinePreview = std_::move(preview);
+		showInlineRows(true);
+	}
+}
+
 void EmojiPan::onInlineRequest() {
 	if (_inlineRequestId || !_inlineBot || !_inlineQueryPeer) return;
 	_inlineQuery = _inlineNextQuery;
 
 	QString nextOffset;
-	InlineCache::const_iterator i = _inlineCache.constFind(_inlineQuery);
-	if (i != _inlineCache.cend()) {
-		nextOffset = i.value()->nextOffset;
+	if (auto entry = _inlineCache.findFresh(_inlineBot, _inlineQueryPeer, _inlineQuery)) {
+		nextOffset = entry->nextOffset;
 		if (nextOffset.isEmpty()) return;
 	}
+	_inlineNextOffset = nextOffset;
 	Notify::inlineBotRequesting(true);
 	MTPmessages_GetInlineBotResults::Flags flags = 0;
 	_inlineRequestId = MTP::send(MTPmessages_GetInlineBotResults(MTP_flags(flags), _inlineBot->inputUser, _inlineQueryPeer->input, MTPInputGeoPoint(), MTP_string(_inlineQuery), MTP_string(nextOffset)), rpcDone(&EmojiPan::inlineResultsDone), rpcFail(&EmojiPan::inlineResultsFail));
@@ -3769,20 +4028,33 @@ void EmojiPan::onEmptyInlineRows() {
 }
 
 bool EmojiPan::refreshInlineRows(int32 *added) {
-	auto i = _inlineCache.constFind(_inlineQuery);
 	const internal::InlineCacheEntry *entry = nullptr;
-	if (i != _inlineCache.cend()) {
-		if (!i.value()->results.isEmpty() || !i.value()->switchPmText.isEmpty()) {
-			entry = i.value();
+	if (_inlinePreview) {
+		entry = _inlinePreview.get();
+	} else if (auto cached = _inlineCache.find(_inlineBot, _inlineQueryPeer, _inlineQuery)) {
+		if (!cached->results.isEmpty() || !cached->switchPmText.isEmpty()) {
+			entry = cached;
 		}
-		_inlineNextOffset = i.value()->nextOffset;
 	}
 	if (!entry) prepareShowHideCache();
 	int32 result = s_inner.refreshInlineRows(_inlineBot, entry, false);
 	if (added) *added = result;
+
+	// The preview borrows the results of some other entry, don't destroy anything then.
+	if (!_inlinePreview && _inlineCache.shrink(entry)) {
+		s_inner.inlineResultsForgotten();
+		inlineCacheChanged();
+	}
 	return (entry != nullptr);
 }
 
+void EmojiPan::inlineCacheChanged() {
+	Local::setInlineBotResultsSerializer([this] {
+		return _inlineCache.serialize();
+	});
+	Local::inlineBotResultsChanged();
+}
+
 int32 EmojiPan::showInlineRows(bool newResults) {
 	int32 added = 0;
 	bool clear = !refreshInlineRows(&added);
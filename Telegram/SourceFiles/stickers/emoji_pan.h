@@ -41,14 +41,58 @@ using InlineItem = InlineBots::Layout::ItemBase;
 
 struct InlineCacheEntry {
 	~InlineCacheEntry() {
-		clearResults();
+		if (!borrowed) clearResults();
 	}
 	QString nextOffset;
 	QString switchPmText, switchPmStartToken;
-	InlineResults results; // owns this results list
+	InlineResults results; // owns this results list, unless borrowed
+	bool borrowed = false; // results are owned by some other entry
+	QList<MTPmessages_BotResults> pages; // everything received, for the local storage
+	int applyPage(const MTPmessages_BotResults &page);
 	void clearResults();
 };
 
+// Results of recent inline bot queries, keyed by bot, peer and query text.
+// Expired entries are not returned and least recently used ones are forgotten.
+class InlineCache {
+public:
+	InlineCache() = default;
+	InlineCache(const InlineCache &other) = delete;
+	InlineCache &operator=(const InlineCache &other) = delete;
+
+	InlineCacheEntry *find(UserData *bot, PeerData *peer, const QString &query);
+	InlineCacheEntry *findFresh(UserData *bot, PeerData *peer, const QString &query);
+	InlineCacheEntry *add(UserData *bot, PeerData *peer, const QString &query);
+
+	// Results of the longest cached query that is a prefix of this one,
+	// filtered by the query words, not owning the results.
+	std_::unique_ptr<InlineCacheEntry> preview(UserData *bot, PeerData *peer, const QString &query);
+
+	// Returns true if some entries were destroyed, the shown one is kept.
+	bool shrink(const InlineCacheEntry *shown);
+
+	QByteArray serialize() const;
+	void deserialize(const QByteArray &serialized);
+
+	~InlineCache();
+
+private:
+	struct Item {
+		PeerId bot;
+		PeerId peer;
+		QString query;
+		int32 expires;
+		uint64 used;
+		InlineCacheEntry *entry;
+	};
+	int indexOf(PeerId bot, PeerId peer, const QString &query) const;
+
+	QList<Item> _items;
+	QList<InlineCacheEntry*> _replaced; // could still be shown until shrink()
+	uint64 _usedCounter = 0;
+
+};
+
 class EmojiColorPicker : public TWidget {
 	Q_OBJECT
 
@@ -232,6 +276,7 @@ public:
 	int refreshInlineRows(UserData *bot, const InlineCacheEntry *results, bool resultsDeleted);
 	void refreshRecent();
 	void inlineBotChanged();
+	void inlineResultsForgotten();
 	void hideInlineRowsPanel();
 	void clearInlineRowsPanel();
 
@@ -482,6 +527,7 @@ class EmojiPan : public TWidget, public RPCSender {
 
 public:
 	EmojiPan(QWidget *parent);
+	~EmojiPan();
 
 	void setMaxHeight(int32 h);
 	void paintEvent(QPaintEvent *e);
@@ -659,8 +705,9 @@ private:
 	QTimer _saveConfigTimer;
 
 	// inline bots
-	typedef QMap<QString, internal::InlineCacheEntry*> InlineCache;
-	InlineCache _inlineCache;
+	internal::InlineCache _inlineCache;
+	bool _inlineCacheRead = false;
+	std_::unique_ptr<internal::InlineCacheEntry> _inlinePreview;
 	QTimer _inlineRequestTimer;
 
 	void inlineBotChanged();
@@ -668,6 +715,8 @@ private:
 	bool hideOnNoInlineResults();
 	void recountContentMaxHeight();
 	bool refreshInlineRows(int32 *added = 0);
+	void showInlinePreview(const QString &query);
+	void inlineCacheChanged(); // the cache will be written to the local storage
 	UserData *_inlineBot = nullptr;
 	PeerData *_inlineQueryPeer = nullptr;
 	QString _inlineQuery, _inlineNextQuery, _inlineNextOffset;
@@ -33,6 +33,7 @@ namespace {
 
 constexpr int kReadFeaturedSetsTimeoutMs = 1000;
 internal::FeaturedReader *FeaturedReaderInstance = nullptr;
+internal::EmojiIndex EmojiIndexInstance;
 
 } // namespace
 
@@ -158,8 +159,127 @@ void markFeaturedAsRead(uint64 setId) {
 	FeaturedReaderInstance->scheduleRead(setId);
 }
 
+void refreshEmojiIndex() {
+	EmojiIndexInstance.refresh();
+}
+
+StickerPack getStickersByEmoji(EmojiPtr emoji) {
+	return EmojiIndexInstance.stickers(emoji);
+}
+
 namespace internal {
 
+void EmojiIndex::refresh() {
+	auto &sets = Global::StickerSets();
+	auto &order = Global::StickerSetsOrder();
+	if (_order != order) {
+		_order = order;
+		_positions.clear();
+		for (int i = 0, l = _order.size(); i != l; ++i) {
+			_positions.insert(_order.at(i), i);
+		}
+		_merged.clear();
+	}
+
+	for (auto i = _sets.begin(); i != _sets.end();) {
+		if (!_positions.contains(i.key()) || !sets.contains(i.key())) {
+			removeSet(i.key(), i.value());
+			i = _sets.erase(i);
+		} else {
+			++i;
+		}
+	}
+	_notLoaded.clear();
+	for_const (auto setId, _order) {
+		auto it = sets.constFind(setId);
+		if (it == sets.cend()) continue;
+
+		if (it->emoji.isEmpty()) {
+			_notLoaded.insert(it->id, it->access);
+		}
+		auto archived = (it->flags & MTPDstickerSet::Flag::f_archived) ? true : false;
+		auto &indexed = _sets[setId];
+		if (indexed.hash == it->hash && indexed.count == it->stickers.size() && indexed.emojiCount == it->emoji.size() && indexed.archived == archived) {
+			continue;
+		}
+		removeSet(setId, indexed);
+		addSet(it.value(), indexed);
+	}
+}
+
+void EmojiIndex::removeSet(uint64 setId, const IndexedSet &indexed) {
+	for_const (auto emoji, indexed.emoji) {
+		auto i = _bySet.find(emoji);
+		if (i != _bySet.cend()) {
+			i->remove(setId);
+			if (i->isEmpty()) {
+				_bySet.erase(i);
+			}
+		}
+		_merged.remove(emoji);
+	}
+}
+
+void EmojiIndex::addSet(const Set &set, IndexedSet &indexed) {
+	indexed.hash = set.hash;
+	indexed.count = set.stickers.size();
+	indexed.emojiCount = set.emoji.size();
+	indexed.archived = (set.flags & MTPDstickerSet::Flag::f_archived) ? true : false;
+	indexed.emoji.clear();
+	if (indexed.archived) return;
+
+	for (auto i = set.emoji.cbegin(), e = set.emoji.cend(); i != e; ++i) {
+		_bySet[i.key()].insert(set.id, i.value());
+		_merged.remove(i.key());
+		indexed.emoji.push_back(i.key());
+	}
+}
+
+StickerPack EmojiIndex::stickers(EmojiPtr emoji) {
+	if (_order != Global::StickerSetsOrder()) {
+		refresh();
+	}
+	requestNotLoaded();
+
+	emoji = emojiGetNoColor(emoji);
+	auto merged = _merged.constFind(emoji);
+	if (merged != _merged.cend()) {
+		return merged.value();
+	}
+
+	StickerPack result;
+	auto bySet = _bySet.constFind(emoji);
+	if (bySet != _bySet.cend()) {
+		QMap<int, const StickerPack*> ordered;
+		for (auto i = bySet->cbegin(), e = bySet->cend(); i != e; ++i) {
+			ordered.insert(_positions.value(i.key()), &i.value());
+		}
+		for_const (auto pack, ordered) {
+			result += *pack;
+		}
+	}
+	_merged.insert(emoji, result);
+	return result;
+}
+
+void EmojiIndex::requestNotLoaded() {
+	if (_notLoaded.isEmpty()) return;
+
+	auto &sets = Global::RefStickerSets();
+	for (auto i = _notLoaded.cbegin(), e = _notLoaded.cend(); i != e; ++i) {
+		auto it = sets.find(i.key());
+		if (it != sets.cend()) {
+			it->flags |= MTPDstickerSet_ClientFlag::f_not_loaded;
+		}
+	}
+	if (App::api()) {
+		for (auto i = _notLoaded.cbegin(), e = _notLoaded.cend(); i != e; ++i) {
+			App::api()->scheduleStickerSetRequest(i.key(), i.value());
+		}
+		App::api()->requestStickerSets();
+	}
+}
+
 void readFeaturedDone() {
 	Local::writeFeaturedStickers();
 	if (App::main()) {
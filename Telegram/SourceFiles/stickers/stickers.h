@@ -27,8 +27,39 @@ void installLocally(uint64 setId);
 void undoInstallLocally(uint64 setId);
 void markFeaturedAsRead(uint64 setId);
 
+// Emoji -> stickers index over the installed sets in Global::StickerSetsOrder().
+// Only the sets that changed since the last refresh are reindexed.
+void refreshEmojiIndex();
+StickerPack getStickersByEmoji(EmojiPtr emoji);
+
 namespace internal {
 
+class EmojiIndex {
+public:
+	void refresh();
+	StickerPack stickers(EmojiPtr emoji);
+
+private:
+	struct IndexedSet {
+		int32 hash = 0;
+		int count = 0;
+		int emojiCount = 0;
+		bool archived = false;
+		QList<EmojiPtr> emoji;
+	};
+	void removeSet(uint64 setId, const IndexedSet &indexed);
+	void addSet(const Set &set, IndexedSet &indexed);
+	void requestNotLoaded();
+
+	QMap<uint64, IndexedSet> _sets;
+	QMap<uint64, int> _positions;
+	Order _order;
+	QMap<EmojiPtr, QMap<uint64, StickerPack>> _bySet;
+	QMap<EmojiPtr, StickerPack> _merged;
+	QMap<uint64, uint64> _notLoaded;
+
+};
+
 class FeaturedReader : public QObject {
 	Q_OBJECT
 
@@ -118,11 +118,67 @@ using UpdateFlag = Notify::PeerUpdate::Flag;
 NotifySettings globalNotifyAll, globalNotifyUsers, globalNotifyChats;
 NotifySettingsPtr globalNotifyAllPtr = UnknownNotifySettings, globalNotifyUsersPtr = UnknownNotifySettings, globalNotifyChatsPtr = UnknownNotifySettings;
 
+namespace {
+
+constexpr int kPeerStringsPruneMin = 1024;
+
+QSet<QString> PeerStrings;
+int PeerStringsPruneAt = kPeerStringsPruneMin;
+
+// Drops the strings that are not used by any peer anymore,
+// the table holding the only reference to them.
+void prunePeerStrings() {
+	for (auto i = PeerStrings.begin(); i != PeerStrings.end();) {
+		if (i->isDetached()) {
+			i = PeerStrings.erase(i);
+		} else {
+			++i;
+		}
+	}
+	PeerStringsPruneAt = qMax(PeerStrings.size() * 2, int(kPeerStringsPruneMin));
+}
+
+} // namespace
+
+QString internPeerString(const QString &value) {
+	if (value.isEmpty()) {
+		return QString();
+	}
+	auto i = PeerStrings.constFind(value);
+	if (i == PeerStrings.cend()) {
+		if (PeerStrings.size() >= PeerStringsPruneAt) {
+			prunePeerStrings();
+		}
+		i = PeerStrings.insert(value);
+	}
+	return *i;
+}
+
+void clearPeerStrings() {
+	PeerStrings.clear();
+	PeerStringsPruneAt = kPeerStringsPruneMin;
+}
+
+int64 peerStringsSize() {
+	prunePeerStrings();
+
+	// Each entry is a hash node with the string and a bucket pointer,
+	// the string buffers are shared with the peers.
+	auto nodeSize = int64(sizeof(void*) * 2 + sizeof(uint) + sizeof(QString));
+	return PeerStrings.size() * nodeSize;
+}
+
 PeerData::PeerData(const PeerId &id) : id(id)
 , colorIndex(peerColorIndex(id))
 , color(peerColor(colorIndex))
 , _userpic(isUser() ? userDefPhoto(colorIndex) : ((isChat() || isMegagroup()) ? chatDefPhoto(colorIndex) : channelDefPhoto(colorIndex))) {
-	nameText.setText(st::msgNameFont, QString(), _textNameOptions);
+}
+
+const Text &PeerData::nameText() const {
+	if (_nameText.isNull()) {
+		_nameText.setText(st::msgNameFont, name, _textNameOptions);
+	}
+	return _nameText;
 }
 
 void PeerData::updateNameDelayed(const QString &newName, const QString &newNameOrPhone, const QString &newUsername) {
@@ -142,7 +198,7 @@ void PeerData::updateNameDelayed(const QString &newName, const QString &newNameO
 
 	++nameVersion;
 	name = newName;
-	nameText.setText(st::msgNameFont, name, _textNameOptions);
+	_nameText = Text();
 
 	Notify::PeerUpdate update(this);
 	update.flags |= UpdateFlag::NameChanged;
@@ -272,10 +328,13 @@ void PeerData::fillNames() {
 	toIndex += ' ' + rusKeyboardLayoutSwitch(toIndex);
 
 	QStringList namesList = toIndex.toLower().split(cWordSplit(), QString::SkipEmptyParts);
+	names.reserve(namesList.size());
 	for (QStringList::const_iterator i = namesList.cbegin(), e = namesList.cend(); i != e; ++i) {
-		names.insert(*i);
+		names.insert(internPeerString(*i));
 		chars.insert(i->at(0));
 	}
+	names.squeeze();
+	chars.squeeze();
 }
 
 bool UserData::setAbout(const QString &newAbout) {
@@ -292,12 +351,12 @@ void UserData::setName(const QString &newFirstName, const QString &newLastName,
 
 	QString newFullName;
 	if (changeName && newFirstName.trimmed().isEmpty()) {
-		firstName = newLastName;
+		firstName = internPeerString(newLastName);
 		lastName = QString();
 		newFullName = firstName;
 	} else {
 		if (changeName) {
-			firstName = newFirstName;
+			firstName = internPeerString(newFirstName);
 			lastName = newLastName;
 		}
 		newFullName = lastName.isEmpty() ? firstName : lng_full_name(lt_first_name, firstName, lt_last_name, lastName);
@@ -385,10 +444,17 @@ void UserData::setBotInfo(const MTPBotInfo &info) {
 void UserData::setNameOrPhone(const QString &newNameOrPhone) {
 	if (nameOrPhone != newNameOrPhone) {
 		nameOrPhone = newNameOrPhone;
-		phoneText.setText(st::msgNameFont, nameOrPhone, _textNameOptions);
+		_phoneText = Text();
 	}
 }
 
+const Text &UserData::phoneText() const {
+	if (_phoneText.isNull()) {
+		_phoneText.setText(st::msgNameFont, nameOrPhone, _textNameOptions);
+	}
+	return _phoneText;
+}
+
 void UserData::madeAction(TimeId when) {
 	if (botInfo || isServiceUser(id) || when <= 0) return;
 
@@ -1240,6 +1306,9 @@ void DocumentData::forget() {
 void DocumentData::automaticLoad(const HistoryItem *item) {
 	if (loaded() || status != FileReady) return;
 
+	if (loading()) {
+		_loader->promote();
+	}
 	if (saveToCache() && _loader != CancelledMtpFileLoader) {
 		if (type == StickerDocument) {
 			save(QString(), _actionOnLoad, _actionOnLoadMsgId);
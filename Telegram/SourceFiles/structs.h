@@ -239,6 +239,14 @@ class UserData;
 class ChatData;
 class ChannelData;
 
+// Equal first names and name parts of the peers share one buffer, there
+// are a lot of the same ones among the users of large groups.
+QString internPeerString(const QString &value);
+void clearPeerStrings();
+
+// Size of the intern table itself, without the shared string buffers.
+int64 peerStringsSize();
+
 class PeerData {
 protected:
 	PeerData(const PeerId &id);
@@ -289,10 +297,13 @@ public:
 	}
 
 	QString name;
-	Text nameText;
-	using Names = OrderedSet<QString>;
+	const Text &nameText() const; // built when it is painted for the first time
+	bool hasNameText() const {
+		return !_nameText.isNull();
+	}
+	using Names = FlatSet<QString>;
 	Names names; // for filtering
-	using NameFirstChars = OrderedSet<QChar>;
+	using NameFirstChars = FlatSet<QChar>;
 	NameFirstChars chars;
 
 	enum LoadedStatus {
@@ -350,6 +361,7 @@ protected:
 private:
 	void fillNames();
 
+	mutable Text _nameText;
 	ClickHandlerPtr _openLink;
 
 };
@@ -448,7 +460,10 @@ public:
 		return _phone;
 	}
 	QString nameOrPhone;
-	Text phoneText;
+	const Text &phoneText() const; // built when it is painted for the first time
+	bool hasPhoneText() const {
+		return !_phoneText.isNull();
+	}
 	TimeId onlineTill = 0;
 	int32 contact = -1; // -1 - not contact, cant add (self, empty, deleted, foreign), 0 - not contact, can add (request), 1 - contact
 
@@ -487,6 +502,7 @@ private:
 	QString _restrictionReason;
 	QString _about;
 	QString _phone;
+	mutable Text _phoneText;
 	BlockStatus _blockStatus = BlockStatus::Unknown;
 
 };
@@ -904,7 +920,7 @@ inline ChannelData *PeerData::migrateTo() const {
 	return (isChat() && asChat()->migrateToPtr && asChat()->migrateToPtr->amIn()) ? asChat()->migrateToPtr : nullptr;
 }
 inline const Text &PeerData::dialogName() const {
-	return migrateTo() ? migrateTo()->dialogName() : ((isUser() && !asUser()->phoneText.isEmpty()) ? asUser()->phoneText : nameText);
+	return migrateTo() ? migrateTo()->dialogName() : ((isUser() && !asUser()->nameOrPhone.isEmpty()) ? asUser()->phoneText() : nameText());
 }
 inline const QString &PeerData::shortName() const {
 	return isUser() ? asUser()->firstName : name;
@@ -128,67 +128,143 @@ void Animation::stop() {
 	_manager->stop(this);
 }
 
-AnimationManager::AnimationManager() : _timer(this), _iterating(false) {
-	_timer.setSingleShot(false);
+AnimationManager::AnimationManager() : _timer(this) {
+	_timer.setSingleShot(true);
+	_timer.setTimerType(Qt::PreciseTimer);
 	connect(&_timer, SIGNAL(timeout()), this, SLOT(timeout()));
+
+	// Step animations once per display frame, not more often.
+	if (auto screen = QGuiApplication::primaryScreen()) {
+		auto rate = screen->refreshRate();
+		if (rate > 1.) {
+			_frameDelta = qMax(int(AnimationTimerDelta), int(floor(1000. / rate)));
+		}
+	}
 }
 
 void AnimationManager::start(Animation *obj) {
-	if (_iterating) {
-		_starting.insert(obj);
-		if (!_stopping.isEmpty()) {
-			_stopping.remove(obj);
-		}
-	} else {
-		if (_objects.isEmpty()) {
-			_timer.start(AnimationTimerDelta);
-		}
-		_objects.insert(obj);
+	obj->_nextFrame = 0; // step it in the next frame
+	_objects.insert(obj);
+	if (!_iterating && (!_timer.isActive() || _timer.remainingTime() > _frameDelta)) {
+		_timer.start(_frameDelta);
 	}
 }
 
 void AnimationManager::stop(Animation *obj) {
-	if (_iterating) {
-		_stopping.insert(obj);
-		if (!_starting.isEmpty()) {
-			_starting.remove(obj);
-		}
-	} else {
-		auto i = _objects.find(obj);
-		if (i != _objects.cend()) {
-			_objects.erase(i);
-			if (_objects.empty()) {
-				_timer.stop();
-			}
+	auto i = _objects.find(obj);
+	if (i != _objects.cend()) {
+		_objects.erase(i);
+		if (_objects.empty() && !_iterating) {
+			_timer.stop();
+			watchWindows(false);
 		}
 	}
 }
 
 void AnimationManager::timeout() {
+	if (_iterating) return;
+
 	_iterating = true;
-	uint64 ms = getms();
+	auto ms = getms();
+
+	// Animations started or stopped by a step are handled by the next frame.
+	_stepping.reserve(_objects.size());
 	for_const (auto object, _objects) {
-		if (!_stopping.contains(object)) {
-			object->step(ms, true);
+		_stepping.push_back(object);
+	}
+
+	// All animations of a window are stepped in the same frame,
+	// so that their repaints are merged in a single window update.
+	QMap<QWidget*, bool> suspended;
+	auto isSuspended = [this, &suspended](Animation *object) {
+		if (auto widget = object->widget()) {
+			auto window = widget->window();
+			auto i = suspended.constFind(window);
+			if (i == suspended.cend()) {
+				i = suspended.insert(window, windowSuspended(window));
+			}
+			return i.value();
+		}
+		return false;
+	};
+
+	// An animation is stepped in the frame that is the closest to its deadline.
+	auto dueTill = ms + _frameDelta / 2;
+	for_const (auto object, _stepping) {
+		if (!_objects.contains(object) || object->_nextFrame > dueTill || isSuspended(object)) {
+			continue;
+		}
+		object->step(ms, true);
+
+		// The step could stop or even destroy the animation.
+		if (_objects.contains(object)) {
+			object->_nextFrame = ms + qMax(object->_frameInterval, _frameDelta);
 		}
 	}
+	_stepping.clear();
 	_iterating = false;
 
-	if (!_starting.isEmpty()) {
-		for_const (auto object, _starting) {
-			_objects.insert(object);
+	// Sleep till the earliest deadline, animations started by the steps are due now.
+	auto active = false;
+	auto nextFrame = uint64(0);
+	for_const (auto object, _objects) {
+		if (isSuspended(object)) {
+			continue;
 		}
-		_starting.clear();
-	}
-	if (!_stopping.isEmpty()) {
-		for_const (auto object, _stopping) {
-			_objects.remove(object);
+		if (!active || object->_nextFrame < nextFrame) {
+			nextFrame = object->_nextFrame;
 		}
-		_stopping.clear();
+		active = true;
 	}
+
 	if (_objects.empty()) {
-		_timer.stop();
+		watchWindows(false);
+	} else if (active) {
+		watchWindows(false);
+		scheduleFrame(ms, nextFrame);
+	} else {
+		// Everything left belongs to hidden windows, sleep until one is shown.
+		watchWindows(true);
+	}
+}
+
+void AnimationManager::scheduleFrame(uint64 frameStart, uint64 nextFrame) {
+	auto next = qMax(frameStart + _frameDelta, nextFrame), now = getms();
+	_timer.start((next > now) ? int(next - now) : 0);
+}
+
+void AnimationManager::watchWindows(bool watch) {
+	if (_watchingWindows != watch) {
+		_watchingWindows = watch;
+		if (watch) {
+			QCoreApplication::instance()->installEventFilter(this);
+		} else {
+			QCoreApplication::instance()->removeEventFilter(this);
+		}
+	}
+}
+
+bool AnimationManager::windowSuspended(QWidget *window) const {
+	if (!window->isVisible() || window->isMinimized()) {
+		return true;
+	}
+	auto handle = window->windowHandle();
+	return handle && !handle->isExposed();
+}
+
+bool AnimationManager::eventFilter(QObject *o, QEvent *e) {
+	switch (e->type()) {
+	case QEvent::Expose:
+	case QEvent::Show:
+	case QEvent::WindowStateChange:
+	case QEvent::ParentChange: {
+		if (!_iterating && !_timer.isActive()) {
+			_timer.start(0);
+		}
+	} break;
+	default: break;
 	}
+	return QObject::eventFilter(o, e);
 }
 
 void AnimationManager::clipCallback(Media::Clip::Reader *reader, qint32 threadIndex, qint32 notification) {
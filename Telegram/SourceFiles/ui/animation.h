@@ -320,8 +320,14 @@ class AnimationImplementation {
 public:
 	virtual void start() {}
 	virtual void step(Animation *a, uint64 ms, bool timer) = 0;
+	virtual QWidget *widget() const { return nullptr; }
 	virtual ~AnimationImplementation() {}
 
+protected:
+	// Animations of widgets are not stepped while their window is hidden.
+	static QWidget *ownerWidget(QWidget *obj) { return obj; }
+	static QWidget *ownerWidget(const void *obj) { return nullptr; }
+
 };
 
 class AnimationCallbacks {
@@ -339,6 +345,7 @@ public:
 
 	void start() { _implementation->start();  }
 	void step(Animation *a, uint64 ms, bool timer) { _implementation->step(a, ms, timer); }
+	QWidget *widget() const { return _implementation->widget(); }
 	~AnimationCallbacks() { delete base::take(_implementation); }
 
 private:
@@ -368,13 +375,27 @@ public:
 		return _animating;
 	}
 
+	QWidget *widget() const {
+		return _callbacks.widget();
+	}
+
+	// Animations that change only a few times per second can ask
+	// to be stepped not more often than once in that many ms.
+	void setFrameInterval(int interval) {
+		_frameInterval = interval;
+	}
+
 	~Animation() {
 		if (_animating) stop();
 	}
 
 private:
+	friend class AnimationManager;
+
 	AnimationCallbacks _callbacks;
 	bool _animating;
+	int _frameInterval = 0; // 0 - step in each display frame
+	uint64 _nextFrame = 0; // when the manager should step it next time
 
 };
 
@@ -394,6 +415,10 @@ public:
 		(_obj->*_method)(ms - _started, timer);
 	}
 
+	QWidget *widget() const {
+		return ownerWidget(_obj);
+	}
+
 private:
 	float64 _started;
 	Type *_obj;
@@ -417,6 +442,10 @@ public:
 		(_obj->*_method)(ms, timer);
 	}
 
+	QWidget *widget() const {
+		return ownerWidget(_obj);
+	}
+
 private:
 	Type *_obj;
 	Method _method;
@@ -443,6 +472,10 @@ public:
 		(_obj->*_method)(_param, ms - _started, timer);
 	}
 
+	QWidget *widget() const {
+		return ownerWidget(_obj);
+	}
+
 private:
 	float64 _started;
 	Param _param;
@@ -467,6 +500,10 @@ public:
 		(_obj->*_method)(_param, ms, timer);
 	}
 
+	QWidget *widget() const {
+		return ownerWidget(_obj);
+	}
+
 private:
 	Param _param;
 	Type *_obj;
@@ -584,15 +621,24 @@ public:
 	void start(Animation *obj);
 	void stop(Animation *obj);
 
+	bool eventFilter(QObject *o, QEvent *e) override;
+
 public slots:
 	void timeout();
 
 	void clipCallback(Media::Clip::Reader *reader, qint32 threadIndex, qint32 notification);
 
 private:
+	void scheduleFrame(uint64 frameStart, uint64 nextFrame);
+	void watchWindows(bool watch);
+	bool windowSuspended(QWidget *window) const;
+
 	using AnimatingObjects = OrderedSet<Animation*>;
-	AnimatingObjects _objects, _starting, _stopping;
+	AnimatingObjects _objects;
+	QVector<Animation*> _stepping;
 	QTimer _timer;
-	bool _iterating;
+	int _frameDelta = AnimationTimerDelta;
+	bool _iterating = false;
+	bool _watchingWindows = false;
 
 };
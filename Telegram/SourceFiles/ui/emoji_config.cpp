@@ -3205,441 +3205,143 @@ QString emojiGetSequence(int index) {
 	return (index >= 0 && index < sequences.size()) ? sequences.at(index) : QString();
 }
 
+namespace {
+
+struct EmojiReplaceNode {
+	ushort ch;
+	ushort childrenFrom, childrenTill;
+	uint32 code;
+};
+
+// Trie of the emoji text replaces, children of each node go one after another sorted by ch.
+const EmojiReplaceNode emojiReplaceNodes[] = {
+	{ 0x0000, 1, 11, 0x0U },
+	{ 0x0033, 11, 13, 0x0U },
+	{ 0x0038, 13, 16, 0x0U },
+	{ 0x003A, 16, 31, 0x0U },
+	{ 0x003B, 31, 33, 0x0U },
+	{ 0x003C, 33, 34, 0x0U },
+	{ 0x003E, 34, 35, 0x0U },
+	{ 0x0042, 35, 36, 0x0U },
+	{ 0x004F, 36, 37, 0x0U },
+	{ 0x0078, 37, 38, 0x0U },
+	{ 0x007D, 38, 39, 0x0U },
+	{ 0x0028, 0, 0, 0xD83DDE14U },
+	{ 0x002D, 39, 40, 0x0U },
+	{ 0x002D, 40, 41, 0x0U },
+	{ 0x006F, 0, 0, 0xD83DDE32U },
+	{ 0x007C, 0, 0, 0xD83DDE33U },
+	{ 0x0027, 41, 42, 0x0U },
+	{ 0x0028, 42, 43, 0x0U },
+	{ 0x002D, 43, 48, 0x0U },
+	{ 0x0058, 0, 0, 0xD83DDE37U },
+	{ 0x005D, 0, 0, 0xD83DDE0FU },
+	{ 0x005F, 48, 49, 0x0U },
+	{ 0x0064, 49, 50, 0x0U },
+	{ 0x0067, 50, 51, 0x0U },
+	{ 0x006A, 51, 52, 0x0U },
+	{ 0x006B, 52, 53, 0x0U },
+	{ 0x006C, 53, 54, 0x0U },
+	{ 0x006F, 54, 55, 0xD83DDE28U },
+	{ 0x0075, 55, 56, 0x0U },
+	{ 0x0076, 56, 57, 0x0U },
+	{ 0x007C, 0, 0, 0xD83DDE10U },
+	{ 0x002D, 57, 59, 0x0U },
+	{ 0x006F, 0, 0, 0xD83DDE30U },
+	{ 0x0033, 0, 0, 0x2764U },
+	{ 0x0028, 59, 60, 0xD83DDE20U },
+	{ 0x002D, 60, 61, 0x0U },
+	{ 0x003A, 61, 62, 0x0U },
+	{ 0x0044, 0, 0, 0xD83DDE06U },
+	{ 0x003A, 62, 63, 0x0U },
+	{ 0x0029, 0, 0, 0xD83DDE0CU },
+	{ 0x0029, 0, 0, 0xD83DDE0DU },
+	{ 0x0028, 0, 0, 0xD83DDE22U },
+	{ 0x0028, 0, 0, 0xD83DDE29U },
+	{ 0x0028, 0, 0, 0xD83DDE1EU },
+	{ 0x0029, 0, 0, 0xD83DDE0AU },
+	{ 0x002A, 0, 0, 0xD83DDE1AU },
+	{ 0x0044, 0, 0, 0xD83DDE03U },
+	{ 0x0070, 0, 0, 0xD83DDE0BU },
+	{ 0x0028, 0, 0, 0xD83DDE2DU },
+	{ 0x0069, 63, 64, 0x0U },
+	{ 0x0072, 64, 65, 0x0U },
+	{ 0x006F, 65, 66, 0x0U },
+	{ 0x0069, 66, 67, 0x0U },
+	{ 0x0069, 67, 68, 0x0U },
+	{ 0x006B, 68, 69, 0x0U },
+	{ 0x0070, 69, 70, 0x0U },
+	{ 0x003A, 0, 0, 0x270CU },
+	{ 0x0029, 0, 0, 0xD83DDE09U },
+	{ 0x0050, 0, 0, 0xD83DDE1CU },
+	{ 0x0028, 0, 0, 0xD83DDE21U },
+	{ 0x0029, 0, 0, 0xD83DDE0EU },
+	{ 0x0029, 0, 0, 0xD83DDE07U },
+	{ 0x0029, 0, 0, 0xD83DDE08U },
+	{ 0x0073, 70, 71, 0x0U },
+	{ 0x0069, 71, 72, 0x0U },
+	{ 0x0079, 72, 73, 0x0U },
+	{ 0x0073, 73, 74, 0x0U },
+	{ 0x006B, 74, 75, 0x0U },
+	{ 0x003A, 0, 0, 0xD83DDC4CU },
+	{ 0x003A, 0, 0, 0x261DU },
+	{ 0x006C, 75, 76, 0x0U },
+	{ 0x006E, 76, 77, 0x0U },
+	{ 0x003A, 0, 0, 0xD83DDE02U },
+	{ 0x0073, 77, 78, 0x0U },
+	{ 0x0065, 78, 79, 0x0U },
+	{ 0x0069, 79, 80, 0x0U },
+	{ 0x003A, 0, 0, 0xD83DDE01U },
+	{ 0x003A, 0, 0, 0xD83DDC8BU },
+	{ 0x003A, 0, 0, 0xD83DDC4DU },
+	{ 0x006B, 80, 81, 0x0U },
+	{ 0x0065, 81, 82, 0x0U },
+	{ 0x003A, 0, 0, 0xD83DDC4EU },
+};
+
+// Bit mask of the characters below 0x80 that can start an emoji text replace.
+const uint32 emojiReplaceLeads[4] = { 0x0U, 0x5D080000U, 0x8004U, 0x21000000U };
+
+inline bool emojiReplaceLead(ushort ch) {
+	return (ch < 0x80) && (emojiReplaceLeads[ch >> 5] & (1U << (ch & 0x1F)));
+}
+
+} // namespace
+
+const QChar *emojiFindReplaceStart(const QChar *ch, const QChar *e) {
+	while (e - ch >= 4) {
+		if (emojiReplaceLead(ch[0].unicode())) return ch;
+		if (emojiReplaceLead(ch[1].unicode())) return ch + 1;
+		if (emojiReplaceLead(ch[2].unicode())) return ch + 2;
+		if (emojiReplaceLead(ch[3].unicode())) return ch + 3;
+		ch += 4;
+	}
+	for (; ch != e; ++ch) {
+		if (emojiReplaceLead(ch->unicode())) return ch;
+	}
+	return e;
+}
+
 void emojiFind(const QChar *ch, const QChar *e, const QChar *&newEmojiEnd, uint32 &emojiCode) {
-	switch (ch->unicode()) {
-	case '}':
-		if (ch + 1 != e) switch ((ch + 1)->unicode()) {
-		case ':':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case ')':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE08U;
-					return;
-				}
-			break;
-			}
-		break;
-		}
-	break;
-	case 'x':
-		if (ch + 1 != e) switch ((ch + 1)->unicode()) {
-		case 'D':
-			newEmojiEnd = ch + 2;
-			if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-				emojiCode = 0xD83DDE06U;
-				return;
-			}
-		break;
-		}
-	break;
-	case 'O':
-		if (ch + 1 != e) switch ((ch + 1)->unicode()) {
-		case ':':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case ')':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE07U;
-					return;
-				}
-			break;
-			}
-		break;
-		}
-	break;
-	case 'B':
-		if (ch + 1 != e) switch ((ch + 1)->unicode()) {
-		case '-':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case ')':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE0EU;
-					return;
-				}
-			break;
-			}
-		break;
-		}
-	break;
-	case '>':
-		if (ch + 1 != e) switch ((ch + 1)->unicode()) {
-		case '(':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case '(':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE21U;
-					return;
-				}
-			break;
-			}
-			newEmojiEnd = ch + 2;
-			if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-				emojiCode = 0xD83DDE20U;
-				return;
-			}
-		break;
-		}
-	break;
-	case '<':
-		if (ch + 1 != e) switch ((ch + 1)->unicode()) {
-		case '3':
-			newEmojiEnd = ch + 2;
-			if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-				emojiCode = 0x2764U;
-				return;
-			}
-		break;
-		}
-	break;
-	case ';':
-		if (ch + 1 != e) switch ((ch + 1)->unicode()) {
-		case 'o':
-			newEmojiEnd = ch + 2;
-			if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-				emojiCode = 0xD83DDE30U;
-				return;
-			}
-		break;
-		case '-':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case 'P':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE1CU;
-					return;
-				}
-			break;
-			case ')':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE09U;
-					return;
-				}
-			break;
-			}
-		break;
-		}
-	break;
-	case ':':
-		if (ch + 1 != e) switch ((ch + 1)->unicode()) {
-		case '|':
-			newEmojiEnd = ch + 2;
-			if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-				emojiCode = 0xD83DDE10U;
-				return;
-			}
-		break;
-		case 'v':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case ':':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0x270CU;
-					return;
-				}
-			break;
-			}
-		break;
-		case 'u':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case 'p':
-				if (ch + 3 != e) switch ((ch + 3)->unicode()) {
-				case ':':
-					newEmojiEnd = ch + 4;
-					if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-						emojiCode = 0x261DU;
-						return;
-					}
-				break;
-				}
-			break;
-			}
-		break;
-		case 'o':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case 'k':
-				if (ch + 3 != e) switch ((ch + 3)->unicode()) {
-				case ':':
-					newEmojiEnd = ch + 4;
-					if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-						emojiCode = 0xD83DDC4CU;
-						return;
-					}
-				break;
-				}
-			break;
-			}
-			newEmojiEnd = ch + 2;
-			if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-				emojiCode = 0xD83DDE28U;
-				return;
-			}
-		break;
-		case 'l':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case 'i':
-				if (ch + 3 != e) switch ((ch + 3)->unicode()) {
-				case 'k':
-					if (ch + 4 != e) switch ((ch + 4)->unicode()) {
-					case 'e':
-						if (ch + 5 != e) switch ((ch + 5)->unicode()) {
-						case ':':
-							newEmojiEnd = ch + 6;
-							if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-								emojiCode = 0xD83DDC4DU;
-								return;
-							}
-						break;
-						}
-					break;
-					}
-				break;
-				}
-			break;
-			}
-		break;
-		case 'k':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case 'i':
-				if (ch + 3 != e) switch ((ch + 3)->unicode()) {
-				case 's':
-					if (ch + 4 != e) switch ((ch + 4)->unicode()) {
-					case 's':
-						if (ch + 5 != e) switch ((ch + 5)->unicode()) {
-						case ':':
-							newEmojiEnd = ch + 6;
-							if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-								emojiCode = 0xD83DDC8BU;
-								return;
-							}
-						break;
-						}
-					break;
-					}
-				break;
-				}
-			break;
-			}
-		break;
-		case 'j':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case 'o':
-				if (ch + 3 != e) switch ((ch + 3)->unicode()) {
-				case 'y':
-					if (ch + 4 != e) switch ((ch + 4)->unicode()) {
-					case ':':
-						newEmojiEnd = ch + 5;
-						if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-							emojiCode = 0xD83DDE02U;
-							return;
-						}
-					break;
-					}
-				break;
-				}
-			break;
-			}
-		break;
-		case 'g':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case 'r':
-				if (ch + 3 != e) switch ((ch + 3)->unicode()) {
-				case 'i':
-					if (ch + 4 != e) switch ((ch + 4)->unicode()) {
-					case 'n':
-						if (ch + 5 != e) switch ((ch + 5)->unicode()) {
-						case ':':
-							newEmojiEnd = ch + 6;
-							if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-								emojiCode = 0xD83DDE01U;
-								return;
-							}
-						break;
-						}
-					break;
-					}
-				break;
-				}
-			break;
-			}
-		break;
-		case 'd':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case 'i':
-				if (ch + 3 != e) switch ((ch + 3)->unicode()) {
-				case 's':
-					if (ch + 4 != e) switch ((ch + 4)->unicode()) {
-					case 'l':
-						if (ch + 5 != e) switch ((ch + 5)->unicode()) {
-						case 'i':
-							if (ch + 6 != e) switch ((ch + 6)->unicode()) {
-							case 'k':
-								if (ch + 7 != e) switch ((ch + 7)->unicode()) {
-								case 'e':
-									if (ch + 8 != e) switch ((ch + 8)->unicode()) {
-									case ':':
-										newEmojiEnd = ch + 9;
-										if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-											emojiCode = 0xD83DDC4EU;
-											return;
-										}
-									break;
-									}
-								break;
-								}
-							break;
-							}
-						break;
-						}
-					break;
-					}
-				break;
-				}
-			break;
-			}
-		break;
-		case '_':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case '(':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE2DU;
-					return;
-				}
-			break;
-			}
-		break;
-		case ']':
-			newEmojiEnd = ch + 2;
-			if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-				emojiCode = 0xD83DDE0FU;
-				return;
-			}
-		break;
-		case 'X':
-			newEmojiEnd = ch + 2;
-			if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-				emojiCode = 0xD83DDE37U;
-				return;
-			}
-		break;
-		case '-':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case 'p':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE0BU;
-					return;
-				}
-			break;
-			case 'D':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE03U;
-					return;
-				}
-			break;
-			case '*':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE1AU;
-					return;
-				}
-			break;
-			case ')':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE0AU;
-					return;
-				}
-			break;
-			case '(':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE1EU;
-					return;
-				}
-			break;
-			}
-		break;
-		case '(':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case '(':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE29U;
-					return;
-				}
-			break;
-			}
-		break;
-		case '\'':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case '(':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE22U;
-					return;
-				}
-			break;
-			}
-		break;
+	if (!emojiReplaceLead(ch->unicode())) return;
+
+	auto node = emojiReplaceNodes;
+	for (auto i = ch; i != e; ++i) {
+		auto child = emojiReplaceNodes + node->childrenFrom, till = emojiReplaceNodes + node->childrenTill;
+		while (child != till && child->ch < i->unicode()) {
+			++child;
 		}
-	break;
-	case '8':
-		if (ch + 1 != e) switch ((ch + 1)->unicode()) {
-		case '|':
-			newEmojiEnd = ch + 2;
-			if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-				emojiCode = 0xD83DDE33U;
-				return;
-			}
-		break;
-		case 'o':
-			newEmojiEnd = ch + 2;
-			if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-				emojiCode = 0xD83DDE32U;
-				return;
-			}
-		break;
-		case '-':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case ')':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE0DU;
-					return;
-				}
+		if (child == till || child->ch != i->unicode()) {
 			break;
-			}
-		break;
 		}
-	break;
-	case '3':
-		if (ch + 1 != e) switch ((ch + 1)->unicode()) {
-		case '-':
-			if (ch + 2 != e) switch ((ch + 2)->unicode()) {
-			case ')':
-				newEmojiEnd = ch + 3;
-				if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-					emojiCode = 0xD83DDE0CU;
-					return;
-				}
-			break;
-			}
-		break;
-		case '(':
-			newEmojiEnd = ch + 2;
-			if (newEmojiEnd == e || emojiEdge(newEmojiEnd) || newEmojiEnd->unicode() == ' ') {
-				emojiCode = 0xD83DDE14U;
-				return;
+		node = child;
+		if (node->code) {
+			auto end = i + 1;
+			if (end == e || emojiEdge(end) || end->unicode() == ' ') {
+				newEmojiEnd = end;
+				emojiCode = node->code;
 			}
-		break;
 		}
-	break;
 	}
 }
 
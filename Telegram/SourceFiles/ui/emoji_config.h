@@ -150,6 +150,7 @@ extern int EmojiSizes[5], EIndex, ESize;
 extern const char *EmojiNames[5], *EName;
 
 void emojiFind(const QChar *ch, const QChar *e, const QChar *&newEmojiEnd, uint32 &emojiCode);
+const QChar *emojiFindReplaceStart(const QChar *ch, const QChar *e); // first char that can start an emoji replace
 
 inline bool emojiEdge(const QChar *ch) {
 	return true;
@@ -222,12 +223,10 @@ inline QString replaceEmojis(const QString &text, EntitiesInText *inOutEntities)
 			ch = emojiEnd = newEmojiEnd;
 			canFindEmoji = true;
 		} else {
-			if (emojiEdge(ch)) {
-				canFindEmoji = true;
-			} else {
-				canFindEmoji = false;
-			}
-			++ch;
+			// Skip all the chars that can't start an emoji replace at once.
+			auto next = emojiFindReplaceStart(ch + 1, e);
+			canFindEmoji = emojiEdge(next - 1);
+			ch = next;
 		}
 	}
 	if (result.isEmpty()) return text;
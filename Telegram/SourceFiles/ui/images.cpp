@@ -627,6 +627,12 @@ QPixmap Image::pixBlurredColoredNoCache(const style::color &add, int32 w, int32
 	return App::pixmapFromImageInPlace(imageColored(add, img));
 }
 
+QImage Image::original() const {
+	checkload();
+	restore();
+	return _data.toImage();
+}
+
 void Image::forget() const {
 	if (_forgot) return;
 
@@ -777,6 +783,7 @@ void RemoteImage::automaticLoad(const HistoryItem *item) {
 
 		if (_loader) {
 			if (loadFromCloud) _loader->permitLoadFromCloud();
+			_loader->promote();
 		} else {
 			_loader = createLoader(loadFromCloud ? LoadFromCloudOrLocal : LoadFromLocalOnly, true);
 			if (_loader) _loader->start();
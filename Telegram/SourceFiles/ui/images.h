@@ -170,6 +170,9 @@ public:
 	QPixmap pixColoredNoCache(const style::color &add, int32 w = 0, int32 h = 0, bool smooth = false) const;
 	QPixmap pixBlurredColoredNoCache(const style::color &add, int32 w, int32 h = 0) const;
 
+	// Decoded image in its original size, restores it if it was forgotten.
+	QImage original() const;
+
 	int32 width() const {
 		return qMax(countWidth(), 1);
 	}
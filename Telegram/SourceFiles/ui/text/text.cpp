@@ -2895,6 +2895,24 @@ bool Text::isEmpty() const {
 	return _blocks.empty() || _blocks[0]->type() == TextBlockTSkip;
 }
 
+int64 Text::memorySize() const {
+	int64 result = 0;
+	if (_text.capacity()) {
+		result += sizeof(QArrayData) + (_text.capacity() + 1) * sizeof(QChar);
+	}
+	result += _blocks.capacity() * sizeof(ITextBlock*);
+	for_const (auto block, _blocks) {
+		switch (block->type()) {
+		case TextBlockTNewline: result += sizeof(NewlineBlock); break;
+		case TextBlockTText: result += sizeof(TextBlock) + static_cast<const TextBlock*>(block)->_words.capacity() * sizeof(TextWord); break;
+		case TextBlockTEmoji: result += sizeof(EmojiBlock); break;
+		case TextBlockTSkip: result += sizeof(SkipBlock); break;
+		}
+	}
+	result += _links.capacity() * sizeof(ClickHandlerPtr);
+	return result;
+}
+
 template <typename AppendPartCallback, typename ClickHandlerStartCallback, typename ClickHandlerFinishCallback, typename FlagsChangeCallback>
 void Text::enumerateText(TextSelection selection, AppendPartCallback appendPartCallback, ClickHandlerStartCallback clickHandlerStartCallback, ClickHandlerFinishCallback clickHandlerFinishCallback, FlagsChangeCallback flagsChangeCallback) const {
 	if (isEmpty() || selection.empty()) {
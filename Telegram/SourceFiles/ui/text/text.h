@@ -181,6 +181,9 @@ public:
 		return _text.size();
 	}
 
+	// Estimated heap bytes held by the text, not counting the Text itself.
+	int64 memorySize() const;
+
 	TextWithEntities originalTextWithEntities(TextSelection selection = AllTextSelection, ExpandLinksMode mode = ExpandLinksShortened) const;
 	QString originalText(TextSelection selection = AllTextSelection, ExpandLinksMode mode = ExpandLinksShortened) const;
 
@@ -24,14 +24,10 @@ Copyright (c) 2014-2016 John Preston, https://desktop.telegram.org
 namespace {
 
 const QRegularExpression _reDomain(QString::fromUtf8("(?<![\\w\\$\\-\\_%=\\.])(?:([a-zA-Z]+)://)?((?:[A-Za-z" "\xd0\x90-\xd0\xaf" "\xd0\xb0-\xd1\x8f" "\xd1\x91\xd0\x81" "0-9\\-\\_]+\\.){1,10}([A-Za-z" "\xd1\x80\xd1\x84" "\\-\\d]{2,22})(\\:\\d+)?)"), QRegularExpression::UseUnicodePropertiesOption);
-const QRegularExpression _reExplicitDomain(QString::fromUtf8("(?<![\\w\\$\\-\\_%=\\.])(?:([a-zA-Z]+)://)((?:[A-Za-z" "\xd0\x90-\xd0\xaf\xd0\x81" "\xd0\xb0-\xd1\x8f\xd1\x91" "0-9\\-\\_]+\\.){0,5}([A-Za-z" "\xd1\x80\xd1\x84" "\\-\\d]{2,22})(\\:\\d+)?)"), QRegularExpression::UseUnicodePropertiesOption);
 const QRegularExpression _reMailName(qsl("[a-zA-Z\\-_\\.0-9]{1,256}$"));
 const QRegularExpression _reMailStart(qsl("^[a-zA-Z\\-_\\.0-9]{1,256}\\@"));
 const QRegularExpression _reHashtag(qsl("(^|[\\s\\.,:;<>|'\"\\[\\]\\{\\}`\\~\\!\\%\\^\\*\\(\\)\\-\\+=\\x10])#[\\w]{2,64}([\\W]|$)"), QRegularExpression::UseUnicodePropertiesOption);
-const QRegularExpression _reMention(qsl("(^|[\\s\\.,:;<>|'\"\\[\\]\\{\\}`\\~\\!\\%\\^\\*\\(\\)\\-\\+=\\x10])@[A-Za-z_0-9]{1,32}([\\W]|$)"), QRegularExpression::UseUnicodePropertiesOption);
 const QRegularExpression _reBotCommand(qsl("(^|[\\s\\.,:;<>|'\"\\[\\]\\{\\}`\\~\\!\\%\\^\\*\\(\\)\\-\\+=\\x10])/[A-Za-z_0-9]{1,64}(@[A-Za-z_0-9]{5,32})?([\\W]|$)"));
-const QRegularExpression _rePre(qsl("(^|[\\s\\.,:;<>|'\"\\[\\]\\{\\}`\\~\\!\\?\\%\\^\\*\\(\\)\\-\\+=\\x10])(````?)[\\s\\S]+?(````?)([\\s\\.,:;<>|'\"\\[\\]\\{\\}`\\~\\!\\?\\%\\^\\*\\(\\)\\-\\+=\\x10]|$)"), QRegularExpression::UseUnicodePropertiesOption);
-const QRegularExpression _reCode(qsl("(^|[\\s\\.,:;<>|'\"\\[\\]\\{\\}`\\~\\!\\?\\%\\^\\*\\(\\)\\-\\+=\\x10])(`)[^\\n]+?(`)([\\s\\.,:;<>|'\"\\[\\]\\{\\}`\\~\\!\\?\\%\\^\\*\\(\\)\\-\\+=\\x10]|$)"), QRegularExpression::UseUnicodePropertiesOption);
 QSet<int32> _validProtocols, _validTopDomains;
 
 } // namespace
@@ -1442,6 +1438,471 @@ MTPVector<MTPMessageEntity> linksToMTP(const EntitiesInText &links, bool sending
 	return result;
 }
 
+namespace {
+
+// Hand-written matchers for the entity expressions textParseEntities() used to run
+// through QRegularExpression. Each finder returns the leftmost match the expression
+// would find from the given offset, and the last result is remembered, so the
+// text is walked once while the parse offset moves forward.
+
+enum class SeparatorSet {
+	Mono, // before and after pre and code blocks
+	Tags, // before hashtags and mentions
+	BotCommands, // before bot commands, only ascii spaces
+};
+
+inline bool chIsAsciiLetter(uint ch) {
+	return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+}
+
+inline bool chIsAsciiSpace(uint ch) {
+	return (ch == ' ') || (ch >= '\t' && ch <= '\r');
+}
+
+inline bool chIsUnicodeSpace(uint ch) { // \s with unicode properties does not match NEL
+	return (ch != 0x85) && QChar::isSpace(ch);
+}
+
+inline bool chIsUnicodeWord(uint ch) {
+	return (ch == '_') || QChar::isLetterOrNumber(ch);
+}
+
+inline bool chIsUsernameChar(uint ch) {
+	return chIsAsciiLetter(ch) || (ch >= '0' && ch <= '9') || (ch == '_');
+}
+
+inline bool chIsMailNameChar(uint ch) {
+	return chIsUsernameChar(ch) || (ch == '-') || (ch == '.');
+}
+
+inline bool chIsDomainLabelChar(uint ch) {
+	return chIsUsernameChar(ch) || (ch == '-') || (ch >= 0x410 && ch <= 0x44F) || (ch == 0x401) || (ch == 0x451);
+}
+
+inline bool chIsTopDomainChar(uint ch) {
+	return chIsAsciiLetter(ch) || (ch == 0x440) || (ch == 0x444) || (ch == '-') || QChar::isDigit(ch);
+}
+
+inline bool chBlocksDomainStart(uint ch) {
+	switch (ch) {
+	case '$':
+	case '-':
+	case '%':
+	case '=':
+	case '.':
+		return true;
+	}
+	return chIsUnicodeWord(ch);
+}
+
+inline bool chIsTagSeparator(uint ch, SeparatorSet set) {
+	switch (ch) {
+	case '.': case ',': case ':': case ';': case '<': case '>': case '|':
+	case '\'': case '"': case '[': case ']': case '{': case '}': case '`':
+	case '~': case '!': case '%': case '^': case '*': case '(': case ')':
+	case '-': case '+': case '=': case 0x10: // TextCommand
+		return true;
+	case '?':
+		return (set == SeparatorSet::Mono);
+	}
+	return (set == SeparatorSet::BotCommands) ? chIsAsciiSpace(ch) : chIsUnicodeSpace(ch);
+}
+
+struct EntityMatch {
+	bool valid() const {
+		return (matchStart >= 0);
+	}
+
+	int matchStart = -1; // including the separator before the entity
+	int start = 0;
+	int end = 0;
+
+	int openLength = 0; // backticks around pre and code blocks
+	int closeLength = 0;
+
+	int protocolLength = 0; // letters before "://" in links
+	int topDomainStart = 0;
+	int topDomainEnd = 0;
+};
+
+class EntitiesScanner {
+public:
+	EntitiesScanner(const QString &text) : _start(text.constData()), _length(text.size()) {
+	}
+
+	EntityMatch findPre(int from) {
+		return cached(_pre, from, &EntitiesScanner::searchPre);
+	}
+	EntityMatch findCode(int from) {
+		return cached(_code, from, &EntitiesScanner::searchCode);
+	}
+	EntityMatch findHashtag(int from) {
+		return cached(_hashtag, from, &EntitiesScanner::searchHashtag);
+	}
+	EntityMatch findMention(int from) {
+		return cached(_mention, from, &EntitiesScanner::searchMention);
+	}
+	EntityMatch findBotCommand(int from) {
+		return cached(_botCommand, from, &EntitiesScanner::searchBotCommand);
+	}
+	EntityMatch findDomain(int from) {
+		return cached(_domain, from, &EntitiesScanner::searchDomain);
+	}
+	EntityMatch findExplicitDomain(int from) {
+		return cached(_explicitDomain, from, &EntitiesScanner::searchExplicitDomain);
+	}
+
+	// Start of the e-mail name ending right before the '@' at "till", or -1.
+	int findMailNameStart(int from, int till) const {
+		auto result = till;
+		while (result > from && till - result < 256 && chIsMailNameChar(at(result - 1))) {
+			--result;
+		}
+		return (result < till) ? result : -1;
+	}
+
+private:
+	struct CachedMatch {
+		int from = -1;
+		EntityMatch match;
+	};
+	struct CachedClose {
+		int from = -1;
+		int position = -1;
+		int length = 0;
+	};
+	using Search = EntityMatch (EntitiesScanner::*)(int from);
+	using CloseTest = int (EntitiesScanner::*)(int position) const;
+
+	EntityMatch cached(CachedMatch &cache, int from, Search search) {
+		if (cache.from < 0 || from < cache.from || (cache.match.valid() && from > cache.match.matchStart)) {
+			cache.from = from;
+			cache.match = (this->*search)(from);
+		}
+		return cache.match;
+	}
+
+	ushort at(int position) const {
+		return (position < _length) ? _start[position].unicode() : 0;
+	}
+
+	// Code points are counted like in PCRE, surrogate pairs are joined.
+	uint codeAt(int position, int *size) const {
+		auto ch = _start[position];
+		if (ch.isHighSurrogate() && position + 1 < _length && _start[position + 1].isLowSurrogate()) {
+			*size = 2;
+			return QChar::surrogateToUcs4(ch, _start[position + 1]);
+		}
+		*size = 1;
+		return ch.unicode();
+	}
+	uint codeBefore(int position) const {
+		auto ch = _start[position - 1];
+		if (ch.isLowSurrogate() && position > 1 && _start[position - 2].isHighSurrogate()) {
+			return QChar::surrogateToUcs4(_start[position - 2], ch);
+		}
+		return ch.unicode();
+	}
+
+	template <typename Attempt>
+	EntityMatch searchAfterSeparator(int from, SeparatorSet set, Attempt attempt) {
+		for (auto position = from; position < _length; ++position) {
+			if (!position) {
+				auto result = attempt(position, position);
+				if (result.valid()) return result;
+			}
+			if (chIsTagSeparator(at(position), set)) {
+				auto result = attempt(position, position + 1);
+				if (result.valid()) return result;
+			}
+		}
+		return EntityMatch();
+	}
+
+	bool monoTagEnds(int position) const {
+		return (position >= _length) || chIsTagSeparator(at(position), SeparatorSet::Mono);
+	}
+	int preCloseLength(int position) const {
+		if (at(position) != '`' || at(position + 1) != '`' || at(position + 2) != '`') {
+			return 0;
+		} else if (at(position + 3) == '`' && monoTagEnds(position + 4)) {
+			return 4;
+		}
+		return monoTagEnds(position + 3) ? 3 : 0;
+	}
+	int codeCloseLength(int position) const {
+		return (at(position) == '`' && monoTagEnds(position + 1)) ? 1 : 0;
+	}
+	int findClose(CachedClose &cache, int from, CloseTest test) {
+		if (cache.from < 0 || from < cache.from || (cache.position >= 0 && from > cache.position)) {
+			cache.from = from;
+			cache.position = -1;
+			for (auto position = from; position < _length; ++position) {
+				if (auto length = (this->*test)(position)) {
+					cache.position = position;
+					cache.length = length;
+					break;
+				}
+			}
+		}
+		return cache.position;
+	}
+	int findNewline(int from) {
+		if (_newline.from < 0 || from < _newline.from || (_newline.position >= 0 && from > _newline.position)) {
+			_newline.from = from;
+			_newline.position = -1;
+			for (auto position = from; position < _length; ++position) {
+				if (at(position) == '\n') {
+					_newline.position = position;
+					break;
+				}
+			}
+		}
+		return _newline.position;
+	}
+
+	EntityMatch searchPre(int from);
+	EntityMatch searchCode(int from);
+	EntityMatch searchHashtag(int from);
+	EntityMatch searchMention(int from);
+	EntityMatch searchBotCommand(int from);
+	EntityMatch searchDomain(int from);
+	EntityMatch searchExplicitDomain(int from);
+
+	EntityMatch tryPreBody(int matchStart, int open, int openLength);
+	EntityMatch tryMention(int matchStart, int prefix) const;
+	EntityMatch tryDomain(int matchStart, bool explicitProtocol) const;
+	EntityMatch tryDomainName(int matchStart, int name, int minLabels, int maxLabels) const;
+	int skipUsername(int position) const {
+		while (position < _length && chIsUsernameChar(at(position))) {
+			++position;
+		}
+		return position;
+	}
+
+	const QChar *_start;
+	int _length;
+
+	CachedMatch _pre, _code, _hashtag, _mention, _botCommand, _domain, _explicitDomain;
+	CachedClose _preClose, _codeClose, _newline;
+
+};
+
+// (^|[separators])(````?)[\s\S]+?(````?)([separators]|$)
+EntityMatch EntitiesScanner::searchPre(int from) {
+	return searchAfterSeparator(from, SeparatorSet::Mono, [this](int matchStart, int open) {
+		if (at(open) != '`' || at(open + 1) != '`' || at(open + 2) != '`') {
+			return EntityMatch();
+		} else if (at(open + 3) == '`') {
+			auto result = tryPreBody(matchStart, open, 4);
+			if (result.valid()) return result;
+		}
+		return tryPreBody(matchStart, open, 3);
+	});
+}
+
+EntityMatch EntitiesScanner::tryPreBody(int matchStart, int open, int openLength) {
+	auto close = findClose(_preClose, open + openLength + 1, &EntitiesScanner::preCloseLength);
+	if (close < 0) {
+		return EntityMatch();
+	}
+	auto result = EntityMatch();
+	result.matchStart = matchStart;
+	result.start = open;
+	result.end = close + _preClose.length;
+	result.openLength = openLength;
+	result.closeLength = _preClose.length;
+	return result;
+}
+
+// (^|[separators])(`)[^\n]+?(`)([separators]|$)
+EntityMatch EntitiesScanner::searchCode(int from) {
+	return searchAfterSeparator(from, SeparatorSet::Mono, [this](int matchStart, int open) {
+		if (at(open) != '`') {
+			return EntityMatch();
+		}
+		auto close = findClose(_codeClose, open + 2, &EntitiesScanner::codeCloseLength);
+		auto newline = findNewline(open + 1);
+		if (close < 0 || (newline >= 0 && newline < close)) {
+			return EntityMatch();
+		}
+		auto result = EntityMatch();
+		result.matchStart = matchStart;
+		result.start = open;
+		result.end = close + 1;
+		result.openLength = result.closeLength = 1;
+		return result;
+	});
+}
+
+// (^|[separators])#[\w]{2,64}([\W]|$)
+EntityMatch EntitiesScanner::searchHashtag(int from) {
+	return searchAfterSeparator(from, SeparatorSet::Tags, [this](int matchStart, int hash) {
+		if (at(hash) != '#') {
+			return EntityMatch();
+		}
+		auto end = hash + 1, count = 0;
+		while (end < _length) {
+			auto size = 1;
+			if (!chIsUnicodeWord(codeAt(end, &size))) break;
+			if (++count > 64) return EntityMatch();
+			end += size;
+		}
+		if (count < 2) {
+			return EntityMatch();
+		}
+		auto result = EntityMatch();
+		result.matchStart = matchStart;
+		result.start = hash;
+		result.end = end;
+		return result;
+	});
+}
+
+// (^|[separators])@[A-Za-z_0-9]{1,32}([\W]|$), starting with a letter and not ending with '_'
+EntityMatch EntitiesScanner::searchMention(int from) {
+	while (true) {
+		auto result = searchAfterSeparator(from, SeparatorSet::Tags, [this](int matchStart, int prefix) {
+			return tryMention(matchStart, prefix);
+		});
+		if (!result.valid() || (chIsAsciiLetter(at(result.start + 1)) && at(result.end - 1) != '_')) {
+			return result;
+		}
+		from = result.end;
+	}
+}
+
+EntityMatch EntitiesScanner::tryMention(int matchStart, int prefix) const {
+	if (at(prefix) != '@') {
+		return EntityMatch();
+	}
+	auto end = skipUsername(prefix + 1);
+	auto length = end - prefix - 1;
+	if (length < 1 || length > 32) {
+		return EntityMatch();
+	} else if (end < _length) {
+		auto size = 1;
+		if (chIsUnicodeWord(codeAt(end, &size))) {
+			return EntityMatch();
+		}
+	}
+	auto result = EntityMatch();
+	result.matchStart = matchStart;
+	result.start = prefix;
+	result.end = end;
+	return result;
+}
+
+// (^|[separators])/[A-Za-z_0-9]{1,64}(@[A-Za-z_0-9]{5,32})?([\W]|$) without unicode properties
+EntityMatch EntitiesScanner::searchBotCommand(int from) {
+	return searchAfterSeparator(from, SeparatorSet::BotCommands, [this](int matchStart, int slash) {
+		if (at(slash) != '/') {
+			return EntityMatch();
+		}
+		auto end = skipUsername(slash + 1);
+		auto length = end - slash - 1;
+		if (length < 1 || length > 64) {
+			return EntityMatch();
+		} else if (at(end) == '@') {
+			auto botEnd = skipUsername(end + 1);
+			auto botLength = botEnd - end - 1;
+			if (botLength >= 5 && botLength <= 32) {
+				end = botEnd;
+			}
+		}
+		auto result = EntityMatch();
+		result.matchStart = matchStart;
+		result.start = slash;
+		result.end = end;
+		return result;
+	});
+}
+
+EntityMatch EntitiesScanner::searchDomain(int from) {
+	for (auto position = from; position < _length; ++position) {
+		if (position > 0 && chBlocksDomainStart(codeBefore(position))) continue;
+
+		auto result = tryDomain(position, false);
+		if (result.valid()) return result;
+	}
+	return EntityMatch();
+}
+
+EntityMatch EntitiesScanner::searchExplicitDomain(int from) {
+	for (auto position = from; position < _length; ++position) {
+		if (position > 0 && chBlocksDomainStart(codeBefore(position))) continue;
+
+		auto result = tryDomain(position, true);
+		if (result.valid()) return result;
+	}
+	return EntityMatch();
+}
+
+// (?:([a-zA-Z]+)://)? followed by the domain name, the protocol is required in explicit domains
+EntityMatch EntitiesScanner::tryDomain(int matchStart, bool explicitProtocol) const {
+	auto protocolEnd = matchStart;
+	while (protocolEnd < _length && chIsAsciiLetter(at(protocolEnd))) {
+		++protocolEnd;
+	}
+	if (protocolEnd > matchStart && at(protocolEnd) == ':' && at(protocolEnd + 1) == '/' && at(protocolEnd + 2) == '/') {
+		auto result = explicitProtocol ? tryDomainName(matchStart, protocolEnd + 3, 0, 5) : tryDomainName(matchStart, protocolEnd + 3, 1, 10);
+		if (result.valid()) {
+			result.protocolLength = protocolEnd - matchStart;
+			return result;
+		}
+	}
+	return explicitProtocol ? EntityMatch() : tryDomainName(matchStart, matchStart, 1, 10);
+}
+
+// (?:[label]+\.){minLabels,maxLabels}([A-Za-z\-\d]{2,22})(\:\d+)?
+EntityMatch EntitiesScanner::tryDomainName(int matchStart, int name, int minLabels, int maxLabels) const {
+	int labelEnds[10];
+	auto labels = 0;
+	for (auto position = name; labels < maxLabels;) {
+		auto end = position;
+		while (end < _length && chIsDomainLabelChar(at(end))) {
+			++end;
+		}
+		if (end == position || at(end) != '.') break;
+
+		position = labelEnds[labels++] = end + 1;
+	}
+	for (; labels >= minLabels; --labels) {
+		auto topDomainStart = labels ? labelEnds[labels - 1] : name;
+		auto topDomainEnd = topDomainStart, count = 0;
+		while (topDomainEnd < _length && count < 22) {
+			auto size = 1;
+			if (!chIsTopDomainChar(codeAt(topDomainEnd, &size))) break;
+			topDomainEnd += size;
+			++count;
+		}
+		if (count < 2) continue;
+
+		auto end = topDomainEnd;
+		if (at(end) == ':') {
+			auto portEnd = end + 1;
+			while (portEnd < _length) {
+				auto size = 1;
+				if (!QChar::isDigit(codeAt(portEnd, &size))) break;
+				portEnd += size;
+			}
+			if (portEnd > end + 1) {
+				end = portEnd;
+			}
+		}
+
+		auto result = EntityMatch();
+		result.matchStart = result.start = matchStart;
+		result.end = end;
+		result.topDomainStart = topDomainStart;
+		result.topDomainEnd = topDomainEnd;
+		return result;
+	}
+	return EntityMatch();
+}
+
+} // namespace
+
 // Some code is duplicated in flattextarea.cpp!
 void textParseEntities(QString &text, int32 flags, EntitiesInText *inOutEntities, bool rich) {
 	EntitiesInText result;
@@ -1460,6 +1921,7 @@ void textParseEntities(QString &text, int32 flags, EntitiesInText *inOutEntities
 		int32 offset = 0, matchOffset = offset, len = text.size(), commandOffset = rich ? 0 : len;
 		bool inLink = false, commandIsLink = false;
 		const QChar *start = text.constData();
+		EntitiesScanner scanner(text);
 		for (; matchOffset < len;) {
 			if (commandOffset <= matchOffset) {
 				for (commandOffset = matchOffset; commandOffset < len; ++commandOffset) {
@@ -1474,34 +1936,18 @@ void textParseEntities(QString &text, int32 flags, EntitiesInText *inOutEntities
 					commandIsLink = false;
 				}
 			}
-			auto mPre = _rePre.match(text, matchOffset);
-			auto mCode = _reCode.match(text, matchOffset);
-			if (!mPre.hasMatch() && !mCode.hasMatch()) break;
-
-			int preStart = mPre.hasMatch() ? mPre.capturedStart() : INT_MAX,
-				preEnd = mPre.hasMatch() ? mPre.capturedEnd() : INT_MAX,
-				codeStart = mCode.hasMatch() ? mCode.capturedStart() : INT_MAX,
-				codeEnd = mCode.hasMatch() ? mCode.capturedEnd() : INT_MAX,
+			auto mPre = scanner.findPre(matchOffset);
+			auto mCode = scanner.findCode(matchOffset);
+			if (!mPre.valid() && !mCode.valid()) break;
+
+			int preStart = mPre.valid() ? mPre.start : INT_MAX,
+				preEnd = mPre.valid() ? mPre.end : INT_MAX,
+				codeStart = mCode.valid() ? mCode.start : INT_MAX,
+				codeEnd = mCode.valid() ? mCode.end : INT_MAX,
 				tagStart, tagEnd;
-			if (mPre.hasMatch()) {
-				if (!mPre.capturedRef(1).isEmpty()) {
-					++preStart;
-				}
-				if (!mPre.capturedRef(4).isEmpty()) {
-					--preEnd;
-				}
-			}
-			if (mCode.hasMatch()) {
-				if (!mCode.capturedRef(1).isEmpty()) {
-					++codeStart;
-				}
-				if (!mCode.capturedRef(4).isEmpty()) {
-					--codeEnd;
-				}
-			}
 
 			bool pre = (preStart <= codeStart);
-			auto mTag = pre ? mPre : mCode;
+			auto &mTag = pre ? mPre : mCode;
 			if (pre) {
 				tagStart = preStart;
 				tagEnd = preEnd;
@@ -1518,7 +1964,7 @@ void textParseEntities(QString &text, int32 flags, EntitiesInText *inOutEntities
 
 			bool addNewlineBefore = false, addNewlineAfter = false;
 			int32 outerStart = tagStart, outerEnd = tagEnd;
-			int32 innerStart = tagStart + mTag.capturedLength(2), innerEnd = tagEnd - mTag.capturedLength(3);
+			int32 innerStart = tagStart + mTag.openLength, innerEnd = tagEnd - mTag.closeLength;
 
 			// Check if start or end sequences intersect any existing entity.
 			int intersectedEntityEnd = 0;
@@ -1610,7 +2056,8 @@ void textParseEntities(QString &text, int32 flags, EntitiesInText *inOutEntities
 	int32 len = text.size(), commandOffset = rich ? 0 : len;
 	bool inLink = false, commandIsLink = false;
 	const QChar *start = text.constData(), *end = start + text.size();
-	for (int32 offset = 0, matchOffset = offset, mentionSkip = 0; offset < len;) {
+	EntitiesScanner scanner(text);
+	for (int32 offset = 0, matchOffset = offset; offset < len;) {
 		if (commandOffset <= offset) {
 			for (commandOffset = offset; commandOffset < len; ++commandOffset) {
 				if (*(start + commandOffset) == TextCommand) {
@@ -1620,64 +2067,27 @@ void textParseEntities(QString &text, int32 flags, EntitiesInText *inOutEntities
 				}
 			}
 		}
-		auto mDomain = _reDomain.match(text, matchOffset);
-		auto mExplicitDomain = _reExplicitDomain.match(text, matchOffset);
-		auto mHashtag = withHashtags ? _reHashtag.match(text, matchOffset) : QRegularExpressionMatch();
-		auto mMention = withMentions ? _reMention.match(text, qMax(mentionSkip, matchOffset)) : QRegularExpressionMatch();
-		auto mBotCommand = withBotCommands ? _reBotCommand.match(text, matchOffset) : QRegularExpressionMatch();
+		auto mDomain = scanner.findDomain(matchOffset);
+		auto mExplicitDomain = scanner.findExplicitDomain(matchOffset);
+		auto mHashtag = withHashtags ? scanner.findHashtag(matchOffset) : EntityMatch();
+		auto mMention = withMentions ? scanner.findMention(matchOffset) : EntityMatch();
+		auto mBotCommand = withBotCommands ? scanner.findBotCommand(matchOffset) : EntityMatch();
+		if (!mDomain.valid() && !mExplicitDomain.valid() && !mHashtag.valid() && !mMention.valid() && !mBotCommand.valid()) {
+			break;
+		}
 
 		EntityInTextType lnkType = EntityInTextUrl;
 		int32 lnkStart = 0, lnkLength = 0;
-		int32 domainStart = mDomain.hasMatch() ? mDomain.capturedStart() : INT_MAX,
-			domainEnd = mDomain.hasMatch() ? mDomain.capturedEnd() : INT_MAX,
-			explicitDomainStart = mExplicitDomain.hasMatch() ? mExplicitDomain.capturedStart() : INT_MAX,
-			explicitDomainEnd = mExplicitDomain.hasMatch() ? mExplicitDomain.capturedEnd() : INT_MAX,
-			hashtagStart = mHashtag.hasMatch() ? mHashtag.capturedStart() : INT_MAX,
-			hashtagEnd = mHashtag.hasMatch() ? mHashtag.capturedEnd() : INT_MAX,
-			mentionStart = mMention.hasMatch() ? mMention.capturedStart() : INT_MAX,
-			mentionEnd = mMention.hasMatch() ? mMention.capturedEnd() : INT_MAX,
-			botCommandStart = mBotCommand.hasMatch() ? mBotCommand.capturedStart() : INT_MAX,
-			botCommandEnd = mBotCommand.hasMatch() ? mBotCommand.capturedEnd() : INT_MAX;
-		if (mHashtag.hasMatch()) {
-			if (!mHashtag.capturedRef(1).isEmpty()) {
-				++hashtagStart;
-			}
-			if (!mHashtag.capturedRef(2).isEmpty()) {
-				--hashtagEnd;
-			}
-		}
-		while (mMention.hasMatch()) {
-			if (!mMention.capturedRef(1).isEmpty()) {
-				++mentionStart;
-			}
-			if (!mMention.capturedRef(2).isEmpty()) {
-				--mentionEnd;
-			}
-			if (!(start + mentionStart + 1)->isLetter() || !(start + mentionEnd - 1)->isLetterOrNumber()) {
-				mentionSkip = mentionEnd;
-				mMention = _reMention.match(text, qMax(mentionSkip, matchOffset));
-				if (mMention.hasMatch()) {
-					mentionStart = mMention.capturedStart();
-					mentionEnd = mMention.capturedEnd();
-				} else {
-					mentionStart = INT_MAX;
-					mentionEnd = INT_MAX;
-				}
-			} else {
-				break;
-			}
-		}
-		if (mBotCommand.hasMatch()) {
-			if (!mBotCommand.capturedRef(1).isEmpty()) {
-				++botCommandStart;
-			}
-			if (!mBotCommand.capturedRef(3).isEmpty()) {
-				--botCommandEnd;
-			}
-		}
-		if (!mDomain.hasMatch() && !mExplicitDomain.hasMatch() && !mHashtag.hasMatch() && !mMention.hasMatch() && !mBotCommand.hasMatch()) {
-			break;
-		}
+		int32 domainStart = mDomain.valid() ? mDomain.start : INT_MAX,
+			domainEnd = mDomain.valid() ? mDomain.end : INT_MAX,
+			explicitDomainStart = mExplicitDomain.valid() ? mExplicitDomain.start : INT_MAX,
+			explicitDomainEnd = mExplicitDomain.valid() ? mExplicitDomain.end : INT_MAX,
+			hashtagStart = mHashtag.valid() ? mHashtag.start : INT_MAX,
+			hashtagEnd = mHashtag.valid() ? mHashtag.end : INT_MAX,
+			mentionStart = mMention.valid() ? mMention.start : INT_MAX,
+			mentionEnd = mMention.valid() ? mMention.end : INT_MAX,
+			botCommandStart = mBotCommand.valid() ? mBotCommand.start : INT_MAX,
+			botCommandEnd = mBotCommand.valid() ? mBotCommand.end : INT_MAX;
 
 		if (explicitDomainStart < domainStart) {
 			domainStart = explicitDomainStart;
@@ -1721,20 +2131,15 @@ void textParseEntities(QString &text, int32 flags, EntitiesInText *inOutEntities
 				continue;
 			}
 
-			QString protocol = mDomain.captured(1).toLower();
-			QString topDomain = mDomain.captured(3).toLower();
+			QString protocol = text.mid(mDomain.start, mDomain.protocolLength).toLower();
+			QString topDomain = text.mid(mDomain.topDomainStart, mDomain.topDomainEnd - mDomain.topDomainStart).toLower();
 
 			bool isProtocolValid = protocol.isEmpty() || _validProtocols.contains(hashCrc32(protocol.constData(), protocol.size() * sizeof(QChar)));
 			bool isTopDomainValid = !protocol.isEmpty() || _validTopDomains.contains(hashCrc32(topDomain.constData(), topDomain.size() * sizeof(QChar)));
 
 			if (protocol.isEmpty() && domainStart > offset + 1 && *(start + domainStart - 1) == QChar('@')) {
-				QString forMailName = text.mid(offset, domainStart - offset - 1);
-				QRegularExpressionMatch mMailName = _reMailName.match(forMailName);
-				if (mMailName.hasMatch()) {
-					int32 mailStart = offset + mMailName.capturedStart();
-					if (mailStart < offset) {
-						mailStart = offset;
-					}
+				int32 mailStart = scanner.findMailNameStart(offset, domainStart - 1);
+				if (mailStart >= 0) {
 					lnkType = EntityInTextEmail;
 					lnkStart = mailStart;
 					lnkLength = domainEnd - mailStart;
@@ -1748,7 +2153,7 @@ void textParseEntities(QString &text, int32 flags, EntitiesInText *inOutEntities
 				lnkStart = domainStart;
 
 				QStack<const QChar*> parenth;
-				const QChar *domainEnd = start + mDomain.capturedEnd(), *p = domainEnd;
+				const QChar *domainEnd = start + mDomain.end, *p = domainEnd;
 				for (; p < end; ++p) {
 					QChar ch(*p);
 					if (chIsLinkEnd(ch)) break; // link finished
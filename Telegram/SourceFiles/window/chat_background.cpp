@@ -29,6 +29,26 @@ namespace {
 
 NeverFreedPointer<ChatBackground> instance;
 
+// Don't prepare mips with a side less than that.
+constexpr int kMinMipSide = 64;
+
+QSize nextMipSize(const QSize &size) {
+	return QSize(size.width() / 2, size.height() / 2);
+}
+
+bool hasNextMip(const QSize &size) {
+	auto next = nextMipSize(size);
+	return (qMin(next.width(), next.height()) >= kMinMipSide);
+}
+
+QRect mapToLevel(const QRect &from, const QSize &original, const QSize &level) {
+	auto fx = level.width() / float64(original.width());
+	auto fy = level.height() / float64(original.height());
+	auto left = qFloor(from.x() * fx), top = qFloor(from.y() * fy);
+	auto right = qCeil((from.x() + from.width()) * fx), bottom = qCeil((from.y() + from.height()) * fy);
+	return QRect(left, top, right - left, bottom - top).intersected(QRect(QPoint(0, 0), level));
+}
+
 } // namespace
 
 bool ChatBackground::empty() const {
@@ -41,9 +61,10 @@ void ChatBackground::initIfEmpty() {
 	}
 }
 
-void ChatBackground::init(int32 id, QPixmap &&image) {
+void ChatBackground::init(int32 id, QPixmap &&image, QVector<QPixmap> &&mips) {
 	_id = id;
 	_image = std_::move(image);
+	_mips = std_::move(mips);
 
 	notify(ChatBackgroundUpdate(ChatBackgroundUpdate::Type::New, _tile));
 }
@@ -51,6 +72,7 @@ void ChatBackground::init(int32 id, QPixmap &&image) {
 void ChatBackground::reset() {
 	_id = 0;
 	_image = QPixmap();
+	_mips.clear();
 	_tile = false;
 
 	notify(ChatBackgroundUpdate(ChatBackgroundUpdate::Type::New, _tile));
@@ -60,10 +82,50 @@ int32 ChatBackground::id() const {
 	return _id;
 }
 
+QVector<QImage> ChatBackground::prepareMips(const QImage &image) {
+	QVector<QImage> result;
+	auto previous = image;
+	while (hasNextMip(previous.size())) {
+		previous = previous.scaled(nextMipSize(previous.size()), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+		previous.setDevicePixelRatio(image.devicePixelRatio());
+		result.push_back(previous);
+	}
+	return result;
+}
+
+bool ChatBackground::checkMips(const QImage &image, const QVector<QImage> &mips) {
+	auto size = image.size();
+	for_const (auto &mip, mips) {
+		if (!hasNextMip(size)) {
+			return false;
+		}
+		size = nextMipSize(size);
+		if (mip.size() != size) {
+			return false;
+		}
+	}
+	return !hasNextMip(size);
+}
+
 const QPixmap &ChatBackground::image() const {
 	return _image;
 }
 
+const QPixmap &ChatBackground::imageForSize(QRect &from, const QSize &size) const {
+	auto result = &_image;
+	auto resultFrom = from;
+	for_const (auto &mip, _mips) {
+		auto levelFrom = mapToLevel(from, _image.size(), mip.size());
+		if (levelFrom.width() < size.width() || levelFrom.height() < size.height()) {
+			break;
+		}
+		result = &mip;
+		resultFrom = levelFrom;
+	}
+	from = resultFrom;
+	return *result;
+}
+
 bool ChatBackground::tile() const {
 	return _tile;
 }
@@ -39,17 +39,28 @@ class ChatBackground : public base::Observable<ChatBackgroundUpdate> {
 public:
 	bool empty() const;
 	void initIfEmpty();
-	void init(int32 id, QPixmap &&image);
+	void init(int32 id, QPixmap &&image, QVector<QPixmap> &&mips);
 	void reset();
 
+	// Each mip level is the previous one (starting from the image) halved.
+	static QVector<QImage> prepareMips(const QImage &image);
+	static bool checkMips(const QImage &image, const QVector<QImage> &mips);
+
 	int32 id() const;
 	const QPixmap &image() const;
+
+	// Returns the smallest of the image and its mips that can still be
+	// drawn from the "from" rect to a rect of "size" device pixels without
+	// upscaling, "from" is mapped to the coordinates of the returned level.
+	const QPixmap &imageForSize(QRect &from, const QSize &size) const;
+
 	bool tile() const;
 	void setTile(bool tile);
 
 private:
 	int32 _id = 0;
 	QPixmap _image;
+	QVector<QPixmap> _mips;
 	bool _tile = false;
 
 };
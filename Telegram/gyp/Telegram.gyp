@@ -210,7 +210,10 @@
       '<(src_loc)/core/click_handler.h',
       '<(src_loc)/core/click_handler_types.cpp',
       '<(src_loc)/core/click_handler_types.h',
+      '<(src_loc)/core/flat_set.h',
       '<(src_loc)/core/lambda_wrap.h',
+      '<(src_loc)/core/memory_pool.cpp',
+      '<(src_loc)/core/memory_pool.h',
       '<(src_loc)/core/observer.cpp',
       '<(src_loc)/core/observer.h',
       '<(src_loc)/core/ordered_set.h',
@@ -220,6 +223,9 @@
       '<(src_loc)/core/runtime_composer.h',
       '<(src_loc)/core/single_timer.cpp',
       '<(src_loc)/core/single_timer.h',
+      '<(src_loc)/core/spsc_queue.h',
+      '<(src_loc)/core/startup_profiler.cpp',
+      '<(src_loc)/core/startup_profiler.h',
       '<(src_loc)/core/stl_subset.h',
       '<(src_loc)/core/type_traits.h',
       '<(src_loc)/core/utils.cpp',
@@ -231,6 +237,8 @@
       '<(src_loc)/data/data_abstract_structure.h',
       '<(src_loc)/data/data_drafts.cpp',
       '<(src_loc)/data/data_drafts.h',
+      '<(src_loc)/data/data_mention_index.cpp',
+      '<(src_loc)/data/data_mention_index.h',
       '<(src_loc)/dialogs/dialogs_indexed_list.cpp',
       '<(src_loc)/dialogs/dialogs_indexed_list.h',
       '<(src_loc)/dialogs/dialogs_layout.cpp',
@@ -312,6 +320,8 @@
       '<(src_loc)/media/media_clip_qtgif.h',
       '<(src_loc)/media/media_clip_reader.cpp',
       '<(src_loc)/media/media_clip_reader.h',
+      '<(src_loc)/media/media_clip_shared_frames.cpp',
+      '<(src_loc)/media/media_clip_shared_frames.h',
       '<(src_loc)/mtproto/facade.cpp',
       '<(src_loc)/mtproto/facade.h',
       '<(src_loc)/mtproto/auth_key.cpp',
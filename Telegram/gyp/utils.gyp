@@ -63,6 +63,22 @@
         ],
       }],
     ],
+  }, {
+    'target_name': 'TraceStat',
+    'variables': {
+      'src_loc': '../SourceFiles',
+    },
+    'includes': [
+      'common_executable.gypi',
+    ],
+
+    'include_dirs': [
+      '<(src_loc)',
+    ],
+    'sources': [
+      '<(src_loc)/_other/tracestat.cpp',
+      '<(src_loc)/_other/tracestat.h',
+    ],
   }, {
     'target_name': 'Packer',
     'variables': {